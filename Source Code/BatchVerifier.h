@@ -0,0 +1,201 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "FlatMerkleTree.h"
+#include "ProofCodec.h"
+
+using namespace std;
+
+// ========================
+// batch proof verifier
+// ========================
+// verifies many (leaf data, proof, root) items at once. proofs are decoded
+// into raw digests when added, roots are stored once and referenced by id,
+// and verifyAll splits the items across threads. every thread hashes its
+// leaves in one multi-lane batch and then advances all of its proofs one
+// level per round, so each round is one batch of equally sized combine
+// inputs for the SIMD kernels. all proofs must use the verifier's hash mode.
+class BatchVerifier
+{
+private:
+    struct Item
+    {
+        size_t dataOffset;
+        size_t dataLength;
+        size_t siblingOffset;
+        size_t depth;
+        size_t rootId;
+        bool wellFormed;
+    };
+
+    HashMode hashMode;
+    unsigned threadCount;
+    vector<char> dataArena;
+    vector<Digest> siblings;
+    vector<Digest> roots;
+    vector<Item> items;
+
+    size_t addItem(const string& reviewData, size_t siblingOffset, size_t rootId, bool wellFormed)
+    {
+        Item item;
+        item.dataOffset = dataArena.size();
+        item.dataLength = reviewData.size();
+        item.siblingOffset = siblingOffset;
+        item.depth = siblings.size() - siblingOffset;
+        item.rootId = rootId;
+        item.wellFormed = wellFormed && rootId < roots.size() && item.depth > 0;
+        dataArena.insert(dataArena.end(), reviewData.begin(), reviewData.end());
+        items.push_back(item);
+        return items.size() - 1;
+    }
+
+    //items per round batch, keeps the scratch buffers small
+    static const size_t BLOCK_SIZE = 4096;
+
+    //verify items [begin, end) into results, at most BLOCK_SIZE items
+    void verifyBlock(size_t begin, size_t end, vector<uint8_t>& results) const
+    {
+        size_t count = end - begin;
+        vector<const uint8_t*> messages(count);
+        vector<size_t> lengths(count);
+        vector<Digest> current(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const Item& item = items[begin + i];
+            messages[i] = reinterpret_cast<const uint8_t*>(dataArena.data()) + item.dataOffset;
+            lengths[i] = item.dataLength;
+        }
+        SHA256Batch::hashMessages(messages.data(), lengths.data(), current.data(), count);
+
+        size_t maxDepth = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            if (items[i].wellFormed) maxDepth = max(maxDepth, items[i].depth);
+        }
+
+        size_t messageSize = (hashMode == HashMode::RAW_DIGEST) ? 64 : 128;
+        vector<uint8_t> buffers(count * 128);
+        vector<size_t> owners;
+        vector<Digest> parents(count);
+        owners.reserve(count);
+
+        for (size_t depth = 0; depth < maxDepth; depth++)
+        {
+            owners.clear();
+            for (size_t i = 0; i < count; i++)
+            {
+                const Item& item = items[begin + i];
+                if (!item.wellFormed || depth >= item.depth) continue;
+
+                uint8_t* buffer = &buffers[owners.size() * 128];
+                SHA256Batch::writePair(current[i], siblings[item.siblingOffset + depth], hashMode, buffer);
+                messages[owners.size()] = buffer;
+                owners.push_back(i);
+            }
+
+            lengths.assign(owners.size(), messageSize);
+            SHA256Batch::hashMessages(messages.data(), lengths.data(), parents.data(), owners.size());
+            for (size_t j = 0; j < owners.size(); j++) current[owners[j]] = parents[j];
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const Item& item = items[begin + i];
+            results[begin + i] = item.wellFormed && current[i] == roots[item.rootId];
+        }
+    }
+
+public:
+    BatchVerifier(HashMode mode = HashMode::HEX_COMPAT, unsigned threads = 0)
+        : hashMode(mode), threadCount(threads) {
+    }
+
+    //register a trusted root, items refer to it by the returned id
+    size_t addRoot(const Digest& root)
+    {
+        for (size_t id = 0; id < roots.size(); id++)
+        {
+            if (roots[id] == root) return id;
+        }
+        roots.push_back(root);
+        return roots.size() - 1;
+    }
+
+    //same for a hex root, returns npos if it is malformed
+    size_t addRoot(const string& rootHash)
+    {
+        Digest root;
+        if (!digestFromHex(rootHash, root)) return string::npos;
+        return addRoot(root);
+    }
+
+    //queue a MerkleTree / FlatMerkleTree string proof, returns the item index.
+    //malformed proofs are kept and reported as failed
+    size_t add(const string& reviewData, const vector<string>& proof, size_t rootId)
+    {
+        size_t siblingOffset = siblings.size();
+        bool wellFormed = proof.size() % 2 == 0;
+        for (size_t i = 0; wellFormed && i < proof.size(); i += 2)
+        {
+            Digest sibling;
+            wellFormed = digestFromHex(proof[i], sibling);
+            if (wellFormed) siblings.push_back(sibling);
+        }
+        if (!wellFormed) siblings.resize(siblingOffset);
+        return addItem(reviewData, siblingOffset, rootId, wellFormed);
+    }
+
+    //queue a raw digest proof
+    size_t add(const string& reviewData, const vector<ProofStep>& proof, size_t rootId)
+    {
+        size_t siblingOffset = siblings.size();
+        for (const ProofStep& step : proof) siblings.push_back(step.sibling);
+        return addItem(reviewData, siblingOffset, rootId, true);
+    }
+
+    //queue a binary proof read in place, it must use the verifier's hash mode
+    size_t add(const string& reviewData, const ProofCodec::ProofView& proof, size_t rootId)
+    {
+        size_t siblingOffset = siblings.size();
+        siblings.resize(siblingOffset + proof.depth);
+        for (size_t step = 0; step < proof.depth; step++) proof.sibling(step, siblings[siblingOffset + step]);
+        return addItem(reviewData, siblingOffset, rootId, proof.mode == hashMode);
+    }
+
+    size_t size() const { return items.size(); }
+
+    void clear()
+    {
+        dataArena.clear();
+        siblings.clear();
+        roots.clear();
+        items.clear();
+    }
+
+    // verify every queued item, results[i] is 1 if item i verified
+    vector<uint8_t> verifyAll() const
+    {
+        vector<uint8_t> results(items.size(), 0);
+        parallelFor(items.size(), threadCount, [&](size_t begin, size_t end)
+            {
+                for (size_t block = begin; block < end; block += BLOCK_SIZE)
+                {
+                    verifyBlock(block, min(end, block + BLOCK_SIZE), results);
+                }
+            }, 256);
+        return results;
+    }
+
+    // number of items that verified
+    static size_t countPassed(const vector<uint8_t>& results)
+    {
+        return static_cast<size_t>(count(results.begin(), results.end(), 1));
+    }
+};
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <sstream>
 #include <map>
 #include <memory>
 #include <fstream>
@@ -10,10 +11,18 @@
 #include <functional>
 #include "DataPreprocessor.h"
 #include "MerkleTree.h"
+#include "FlatMerkleTree.h"
 #include "IntegrityVerifier.h"
 #include "ExistenceProver.h"
 #include "TamperingDetector.h"
 #include "PerformanceMeasurer.h"
+#include "StreamingTreeBuilder.h"
+#include "MerkleMountainRange.h"
+#include "ProductOrderedTree.h"
+#include "SortedMerkleTree.h"
+#include "ProofCodec.h"
+#include "MerkleForest.h"
+#include "ExternalTreeBuilder.h"
 
 using namespace std;
 
@@ -28,6 +37,14 @@ class CLI
 private:
     DataPreprocessor dataProcessor;
     MerkleTree merkleTree;
+    FlatMerkleTree streamedTree;
+    FlatMerkleTree snapshotTree;
+    MerkleMountainRange reviewLog;
+    ProductOrderedTree productTree;
+    bool productTreeBuilt = false;
+    SortedMerkleTree sortedTree;
+    bool sortedTreeBuilt = false;
+    MerkleForest forest;
     IntegrityVerifier integrityVerifier;
     unique_ptr<ExistenceProof> existenceProver;
     unique_ptr<TamperDetector> tamperDetector;
@@ -90,6 +107,12 @@ private:
         cout << "10. Add Single Review (Partial Rebuild)" << endl;
         cout << "11. Print Merkle Tree Structure" << endl;
         cout << "12. Export Metrics" << endl;
+        cout << "13. Streaming Build (Low Memory)" << endl;
+        cout << "14. Save Tree Snapshot" << endl;
+        cout << "15. Load Tree Snapshot" << endl;
+        cout << "16. Append Reviews to Log (Append-Only)" << endl;
+        cout << "17. Build Sharded Forest" << endl;
+        cout << "18. Out-of-Core Build to Snapshot" << endl;
         cout << "0. Exit" << endl;
         cout << "Enter your choice: ";
     }
@@ -118,6 +141,12 @@ private:
         case 10: addSingleReview(); break;
         case 11: printMerkleTree(); break;
         case 12:  exportMetrics(); break;
+        case 13: streamingBuild(); break;
+        case 14: saveTreeSnapshot(); break;
+        case 15: loadTreeSnapshot(); break;
+        case 16: appendToReviewLog(); break;
+        case 17: buildShardedForest(); break;
+        case 18: externalBuild(); break;
         default: cout << "Invalid choice. Please try again." << endl;
         }
     }
@@ -159,7 +188,7 @@ private:
         cout << "Loading dataset: " << filename << endl;
         auto loadStart = chrono::high_resolution_clock::now();
 
-        if (dataProcessor.loadFromJSON(filename, maxRecords))
+        if (dataProcessor.loadFromJSONParallel(filename, maxRecords, 0))
         {
             auto loadEnd = chrono::high_resolution_clock::now();
             auto loadDuration = chrono::duration_cast<chrono::milliseconds>(loadEnd - loadStart);
@@ -167,6 +196,9 @@ private:
             currentReviews = dataProcessor.getReviews();
             currentDataset = filename;
             prepareDataForTree();
+            productTreeBuilt = false;
+            sortedTreeBuilt = false;
+            if (existenceProver) existenceProver->attachSortedTree(nullptr);
 
             //record
             recordMetric("Dataset Load Time", to_string(loadDuration.count()), "ms");
@@ -225,6 +257,8 @@ private:
     {
         reviewData.clear();
         reviewIds.clear();
+        reviewData.reserve(currentReviews.size());
+        reviewIds.reserve(currentReviews.size());
 
         for (const auto& review : currentReviews)
         {
@@ -263,6 +297,8 @@ private:
         cout << "Leaf Count: " << merkleTree.getLeafCount() << endl;
 
         treeBuilt = true;
+        productTreeBuilt = false;
+        sortedTreeBuilt = false;
 
         // initialize supporting modules
         existenceProver = make_unique<ExistenceProof>(&merkleTree);
@@ -337,6 +373,9 @@ private:
         cout << "2. Generate Proofs for Product" << endl;
         cout << "3. Batch Proof Generation" << endl;
         cout << "4. Benchmark Proof System" << endl;
+        cout << "5. Compact Product Proof (Multiproof)" << endl;
+        cout << "6. Complete Product Range Proof (Product-Ordered Tree)" << endl;
+        cout << "7. Prove Review Absent (Sorted Tree)" << endl;
         cout << "Enter choice: ";
 
         int choice;
@@ -376,7 +415,17 @@ private:
             {
                 testIds.push_back(reviewIds[i]);
             }
-            existenceProver->batchGenerateProofs(testIds);
+            vector<ProofResult> proofs = existenceProver->batchGenerateProofs(testIds);
+
+            auto start = chrono::high_resolution_clock::now();
+            vector<uint8_t> verified = ExistenceProof::verifyProofsBatch(proofs, merkleTree.getRootHash());
+            auto end = chrono::high_resolution_clock::now();
+            auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+
+            cout << "Batch verification: " << BatchVerifier::countPassed(verified) << "/" << proofs.size()
+                << " verified in " << duration.count() << " microseconds" << endl;
+            recordMetric("Batch Verify Time", to_string(duration.count()), "us");
+            recordMetric("Batch Verify Count", to_string(proofs.size()));
             break;
         }
         case 4:
@@ -388,6 +437,74 @@ private:
             existenceProver->benchmarkProofSystem(sampleSize);
             break;
         }
+        case 5:
+        {
+            cout << "Enter Product ID: ";
+            string productId;
+            getline(cin, productId);
+            MultiProofResult result = existenceProver->generateProductMultiproof(productId);
+            result.print();
+            if (result.status == "PROOF_GENERATED")
+            {
+                recordMetric("Multiproof Reviews", to_string(result.reviewIds.size()));
+                recordMetric("Multiproof Payload", to_string(result.proof.payloadBytes()), "bytes");
+                recordMetric("Multiproof Verify Time", to_string(result.verificationTimeMicros), "us");
+            }
+            break;
+        }
+        case 6:
+        {
+            cout << "Enter Product ID: ";
+            string productId;
+            getline(cin, productId);
+
+            //leaves sorted by product, built once per dataset
+            if (!productTreeBuilt)
+            {
+                productTree.buildFromReviews(currentReviews);
+                productTreeBuilt = true;
+                cout << "Product-Ordered Root: " << productTree.getRootHash() << endl;
+            }
+
+            ProductRangeProof proof;
+            auto start = chrono::high_resolution_clock::now();
+            bool generated = productTree.generateProductProof(productId, proof);
+            auto mid = chrono::high_resolution_clock::now();
+            bool verified = generated && ProductOrderedTree::verifyProductProof(proof, productTree.getRootDigest());
+            auto end = chrono::high_resolution_clock::now();
+
+            if (!generated)
+            {
+                cout << "Proof generation failed." << endl;
+                break;
+            }
+            cout << "Product " << productId << ": " << proof.reviewCount() << " reviews at leaves ["
+                << proof.begin << ", " << proof.end << ")" << endl;
+            cout << "Siblings: " << proof.proof.siblings.size() << ", payload " << proof.proof.payloadBytes() << " bytes" << endl;
+            cout << "Complete and verified: " << (verified ? "YES" : "NO") << endl;
+            cout << "Generation Time: " << chrono::duration_cast<chrono::microseconds>(mid - start).count() << " microseconds" << endl;
+            cout << "Verification Time: " << chrono::duration_cast<chrono::microseconds>(end - mid).count() << " microseconds" << endl;
+            break;
+        }
+        case 7:
+        {
+            cout << "Enter Review ID: ";
+            string reviewId;
+            getline(cin, reviewId);
+
+            //leaves sorted by review id, built once per dataset
+            if (!sortedTreeBuilt)
+            {
+                sortedTree.buildFromReviews(currentReviews);
+                sortedTreeBuilt = true;
+                existenceProver->attachSortedTree(&sortedTree);
+                cout << "Sorted Tree Root: " << sortedTree.getRootHash() << endl;
+            }
+
+            ProofResult result = existenceProver->generateReviewProof(reviewId);
+            result.print();
+            break;
+        }
         default:
             cout << "Invalid choice." << endl;
         }
@@ -423,6 +540,11 @@ private:
         currentReviews.push_back(newReview);
         reviewData.push_back(newReview.convertToString());
         reviewIds.push_back(newReview.getUniqueID());
+        //options 6 and 7 rebuild their trees with the new review, absence
+        //proofs must not come from the old root meanwhile
+        productTreeBuilt = false;
+        sortedTreeBuilt = false;
+        existenceProver->attachSortedTree(nullptr);
 
         try {
             string oldRoot = merkleTree.getRootHash();
@@ -433,7 +555,7 @@ private:
             cout << "Old root: " << oldRoot.substr(0, 32) << "..." << endl;
             cout << "New root: " << newRoot.substr(0, 32) << "..." << endl;
 
-            existenceProver->indexReviews(currentReviews);
+            existenceProver->indexReview(newReview);
             tamperDetector->setDatasetName(currentDataset);
             integrityVerifier.storeRootHash(currentDataset, newRoot);
 
@@ -527,6 +649,14 @@ private:
             testTree.buildTreeFromReviews(testData, testIds);
             TamperResult result = tamperDetector->detectByRootComparison(testTree.getRootHash());
             result.print();
+
+            if (result.tamperingDetected)
+            {
+                for (const auto& change : tamperDetector->localizeTampering(testTree))
+                {
+                    change.print();
+                }
+            }
         }
     }
 
@@ -603,6 +733,11 @@ private:
             cout << "Estimated tree memory: " << (treeMemory / 1024) << " KB" << endl;
             cout << "Total estimated memory: " << (totalMemory / 1024) << " KB" << endl;
 
+            //flat engine keeps ~2n digests and no per-node pointers
+            size_t flatTreeMemory = currentReviews.size() * 2 * sizeof(Digest);
+            cout << "Flat tree digest estimate: " << (flatTreeMemory / 1024) << " KB" << endl;
+            recordMetric("Memory Usage - Flat Tree Digests", to_string(flatTreeMemory / 1024), "KB");
+
             recordMetric("Memory Usage - Review Objects", to_string(reviewMemory / 1024), "KB");
             recordMetric("Memory Usage - Tree Structure", to_string(treeMemory / 1024), "KB");
             recordMetric("Memory Usage - Total Estimated", to_string(totalMemory / 1024), "KB");
@@ -636,6 +771,332 @@ private:
         merkleTree.printTree(levels);
     }
 
+    //build a flat tree straight from a file, only leaf digests and ids stay in memory
+    void streamingBuild()
+    {
+        cout << "Enter dataset path" << (currentDataset.empty() ? "" : " (empty for " + currentDataset + ")") << ": ";
+        string filename;
+        getline(cin, filename);
+        if (filename.empty()) filename = currentDataset;
+        if (filename.empty())
+        {
+            cout << "No dataset given." << endl;
+            return;
+        }
+
+        cout << "Enter number of records to stream (0 for all): ";
+        int maxRecords;
+        cin >> maxRecords;
+        cin.ignore();
+
+        StreamingTreeBuilder builder;
+        auto start = chrono::high_resolution_clock::now();
+        if (!builder.build(filename, maxRecords, streamedTree)) return;
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        cout << "Streamed Root: " << streamedTree.getRootHash() << endl;
+        cout << "Leaf Count: " << streamedTree.getLeafCount() << endl;
+        cout << "Tree memory: " << (streamedTree.getMemoryUsage() / 1024) << " KB" << endl;
+
+        recordMetric("Streaming Build Time", to_string(duration.count()), "ms");
+        recordMetric("Streaming Leaf Count", to_string(streamedTree.getLeafCount()));
+        recordMetric("Streaming Tree Memory", to_string(streamedTree.getMemoryUsage() / 1024), "KB");
+        recordMetric("Streaming Merkle Root", streamedTree.getRootHash().substr(0, 32) + "...");
+    }
+
+    //write the current dataset's tree to a snapshot file
+    void saveTreeSnapshot()
+    {
+        if (!treeBuilt)
+        {
+            cout << "Please build the Merkle tree first." << endl;
+            return;
+        }
+
+        cout << "Enter snapshot file path: ";
+        string filename;
+        getline(cin, filename);
+
+        //flat tree over the same data has the same root and proofs
+        snapshotTree.buildTreeFromReviews(reviewData, reviewIds);
+        if (snapshotTree.saveSnapshot(filename))
+        {
+            recordMetric("Snapshot File", filename);
+            recordMetric("Snapshot Root", snapshotTree.getRootHash().substr(0, 32) + "...");
+        }
+    }
+
+    //reopen a snapshot without loading or hashing the dataset
+    void loadTreeSnapshot()
+    {
+        cout << "Enter snapshot file path: ";
+        string filename;
+        getline(cin, filename);
+
+        auto start = chrono::high_resolution_clock::now();
+        if (!snapshotTree.loadSnapshot(filename)) return;
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        cout << "Snapshot Root: " << snapshotTree.getRootHash() << endl;
+        cout << "Leaf Count: " << snapshotTree.getLeafCount() << endl;
+        recordMetric("Snapshot Load Time", to_string(duration.count()), "ms");
+        recordMetric("Snapshot Leaf Count", to_string(snapshotTree.getLeafCount()));
+
+        cout << "Enter a review ID to prove (empty to skip): ";
+        string reviewId;
+        getline(cin, reviewId);
+        if (reviewId.empty()) return;
+
+        vector<string> proof = snapshotTree.generateProof(reviewId);
+        if (proof.empty())
+        {
+            cout << "Review ID not found in snapshot." << endl;
+            return;
+        }
+        cout << "Proof has " << proof.size() / 2 << " steps:" << endl;
+        for (size_t i = 0; i + 1 < proof.size(); i += 2)
+        {
+            cout << "  " << proof[i + 1] << " " << proof[i] << endl;
+        }
+
+        vector<uint8_t> encoded;
+        if (ProofCodec::encode(snapshotTree, reviewId, encoded))
+        {
+            cout << "Binary proof: " << encoded.size() << " bytes" << endl;
+        }
+    }
+
+    //append the loaded reviews to the append-only log, one root per batch
+    void appendToReviewLog()
+    {
+        if (currentReviews.empty())
+        {
+            cout << "Please load a dataset first." << endl;
+            return;
+        }
+        prepareDataForTree();
+
+        cout << "Enter batch size: ";
+        int batchSize;
+        cin >> batchSize;
+        cin.ignore();
+        if (batchSize <= 0) batchSize = 10000;
+
+        size_t before = reviewLog.size();
+        const string logName = "review log"; //one log across datasets, tree roots are stored per dataset
+        int skippedTotal = 0;
+        auto start = chrono::high_resolution_clock::now();
+
+        for (size_t begin = 0; begin < reviewData.size(); begin += batchSize)
+        {
+            size_t end = min(reviewData.size(), begin + static_cast<size_t>(batchSize));
+            int skipped = 0;
+            MerkleMountainRange::Checkpoint checkpoint = reviewLog.appendBatch(
+                vector<string>(reviewData.begin() + begin, reviewData.begin() + end),
+                vector<string>(reviewIds.begin() + begin, reviewIds.begin() + end), &skipped);
+            skippedTotal += skipped;
+            cout << "Batch root at size " << checkpoint.treeSize << ": " << digestToHex(checkpoint.root) << endl;
+        }
+
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        cout << "Appended " << (reviewLog.size() - before) << " reviews in " << duration.count() << " ms";
+        if (skippedTotal > 0) cout << " (" << skippedTotal << " already in the log)";
+        cout << endl;
+        cout << "Log Size: " << reviewLog.size() << endl;
+        cout << "Log Root: " << reviewLog.getRootHash() << endl;
+
+        //audit the new root against the one published after the previous
+        //append, as an outside verifier holding only that root and size would
+        size_t publishedSize = integrityVerifier.getStoredSize(logName);
+        if (publishedSize > 0 && publishedSize <= reviewLog.size())
+        {
+            vector<Digest> proof = reviewLog.generateConsistencyProof(publishedSize);
+            string status = integrityVerifier.detectAppendOnlyUpdate(logName, reviewLog.size(),
+                reviewLog.getRootHash(), proof);
+            cout << "Consistency proof from size " << publishedSize << " (" << proof.size() << " hashes): "
+                << status << endl;
+        }
+        else if (publishedSize > reviewLog.size())
+        {
+            cout << "NOT_APPEND_ONLY: log is smaller than the published size " << publishedSize << endl;
+        }
+        if (reviewLog.size() > 0) integrityVerifier.storeLogRoot(logName, reviewLog.getRootHash(), reviewLog.size());
+
+        recordMetric("Append-Only Log Time", to_string(duration.count()), "ms");
+        recordMetric("Append-Only Log Size", to_string(reviewLog.size()));
+        recordMetric("Append-Only Log Root", reviewLog.getRootHash().substr(0, 32) + "...");
+    }
+
+    //build one shard per category file, or split the loaded dataset by ASIN
+    //hash, and combine the shard roots into one forest root
+    void buildShardedForest()
+    {
+        cout << "\nBuild Sharded Forest" << endl;
+        cout << "1. One shard per category file" << endl;
+        cout << "2. Split loaded dataset by ASIN hash" << endl;
+        cout << "Enter choice: ";
+
+        int forestChoice;
+        cin >> forestChoice;
+        cin.ignore();
+
+        vector<string> names;
+        vector<vector<string>> shardData, shardIds;
+
+        if (forestChoice == 1)
+        {
+            cout << "Enter category files separated by commas (empty for the three default datasets): ";
+            string line;
+            getline(cin, line);
+            if (line.empty()) line = "data/Electronics_5.json,data/Automotive_5.json,data/Toys_and_Games_5.json";
+
+            cout << "Enter number of records per category (0 for all): ";
+            int maxRecords;
+            cin >> maxRecords;
+            cin.ignore();
+
+            stringstream files(line);
+            string filename;
+            while (getline(files, filename, ','))
+            {
+                if (find(names.begin(), names.end(), filename) != names.end())
+                {
+                    cout << "Skipping repeated " << filename << endl;
+                    continue;
+                }
+
+                DataPreprocessor loader;
+                if (!loader.loadFromJSONParallel(filename, maxRecords, 0))
+                {
+                    cout << "Skipping " << filename << endl;
+                    continue;
+                }
+                names.push_back(filename);
+                shardData.emplace_back();
+                shardIds.emplace_back();
+                for (const auto& review : loader.getReviews())
+                {
+                    shardData.back().push_back(review.convertToString());
+                    shardIds.back().push_back(review.getUniqueID());
+                }
+            }
+        }
+        else if (forestChoice == 2)
+        {
+            if (currentReviews.empty())
+            {
+                cout << "Please load a dataset first." << endl;
+                return;
+            }
+            cout << "Enter number of shards: ";
+            int shardCount;
+            cin >> shardCount;
+            cin.ignore();
+            if (shardCount <= 0) shardCount = static_cast<int>(resolveThreadCount(0));
+
+            prepareDataForTree();
+            names.resize(shardCount);
+            shardData.resize(shardCount);
+            shardIds.resize(shardCount);
+            for (int i = 0; i < shardCount; i++) names[i] = "asin-" + to_string(i);
+            for (size_t i = 0; i < currentReviews.size(); i++)
+            {
+                size_t shard = MerkleForest::shardForAsin(currentReviews[i].asin, shardCount);
+                shardData[shard].push_back(reviewData[i]);
+                shardIds[shard].push_back(reviewIds[i]);
+            }
+        }
+        else
+        {
+            cout << "Invalid choice." << endl;
+            return;
+        }
+
+        if (names.empty())
+        {
+            cout << "No shards to build." << endl;
+            return;
+        }
+
+        forest = MerkleForest();
+        auto start = chrono::high_resolution_clock::now();
+        forest.buildShards(names, shardData, shardIds);
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        for (size_t i = 0; i < forest.getShardCount(); i++)
+        {
+            const FlatMerkleTree* shard = forest.getShard(forest.getShardName(i));
+            cout << forest.getShardName(i) << ": " << shard->getLeafCount() << " reviews, root "
+                << shard->getRootHash().substr(0, 16) << "..." << endl;
+        }
+        cout << "Forest Root: " << forest.getRootHash() << endl;
+        cout << "Total Reviews: " << forest.getLeafCount() << endl;
+
+        //spot check one two stage proof
+        for (size_t shard = 0; shard < names.size(); shard++)
+        {
+            MerkleForest::ForestProof proof;
+            if (shardIds[shard].empty() || !forest.generateProof(names[shard], shardIds[shard][0], proof)) continue;
+
+            bool valid = MerkleForest::verifyProof(shardData[shard][0], proof, forest.getRootDigest());
+            cout << "Proof for " << shardIds[shard][0] << " (" << proof.reviewSteps.size() << " + "
+                << proof.shardSteps.size() << " steps): " << (valid ? "VALID" : "INVALID") << endl;
+            break;
+        }
+
+        recordMetric("Forest Build Time", to_string(duration.count()), "ms");
+        recordMetric("Forest Shards", to_string(forest.getShardCount()));
+        recordMetric("Forest Root", forest.getRootHash().substr(0, 32) + "...");
+    }
+
+    //hash files bigger than RAM into a snapshot through spill files, then open it
+    void externalBuild()
+    {
+        cout << "Enter dataset files separated by commas (empty for the three default datasets): ";
+        string line;
+        getline(cin, line);
+        if (line.empty()) line = "data/Electronics_5.json,data/Automotive_5.json,data/Toys_and_Games_5.json";
+
+        vector<string> files;
+        stringstream fileList(line);
+        string filename;
+        while (getline(fileList, filename, ',')) files.push_back(filename);
+
+        cout << "Enter snapshot file path: ";
+        string output;
+        getline(cin, output);
+        if (output.empty())
+        {
+            cout << "No snapshot path given." << endl;
+            return;
+        }
+
+        cout << "Enter memory budget in MB (0 for 1024): ";
+        size_t budgetMB;
+        cin >> budgetMB;
+        cin.ignore();
+
+        ExternalTreeBuilder builder;
+        if (budgetMB > 0) builder.setMemoryBudget(budgetMB << 20);
+        auto start = chrono::high_resolution_clock::now();
+        if (!builder.build(files, output)) return;
+        auto end = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        recordMetric("External Build Time", to_string(duration.count()), "ms");
+        recordMetric("External Leaf Count", to_string(builder.getLeafCount()));
+        recordMetric("External Spill", to_string(builder.getSpillBytes() >> 20), "MB");
+
+        if (!snapshotTree.loadSnapshot(output)) return;
+        cout << "Snapshot Root: " << snapshotTree.getRootHash() << endl;
+        recordMetric("External Merkle Root", snapshotTree.getRootHash().substr(0, 32) + "...");
+    }
+
     void runAllTestCases()
     {
         cout << "\nRunning All Test Cases" << endl;
@@ -779,7 +1240,7 @@ private:
     void runMillionRecordTest()
     {
         cout << "Loading 1,000,000 records from Electronics.json..." << endl;
-        if (dataProcessor.loadFromJSON("data/Electronics_5.json", 1000000)) {
+        if (dataProcessor.loadFromJSONParallel("data/Electronics_5.json", 1000000, 0)) {
             currentReviews = dataProcessor.getReviews();
             buildMerkleTree();
             cout << "1M record test completed" << endl;
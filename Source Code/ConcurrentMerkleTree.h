@@ -0,0 +1,711 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "LeafIndex.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// version id index
+// ========================
+// review id -> leaf mapping of a TreeVersion that versions can share. a
+// LeafIndex built at the last compaction is the immutable base; the ids
+// inserted, moved or removed since then sit in overlay layers, one per batch,
+// newest checked first. a new version copies only the layer pointers and adds
+// its own layer, so an insert batch costs about its own size instead of a
+// copy of every id. layers are merged binary counter style (a layer absorbs
+// the next one while no more than twice its size) so there are O(log n) of
+// them, and everything is folded into a new base once the overlay reaches an
+// eighth of the base. a layer is never written once its version is published.
+class VersionIdIndex
+{
+private:
+    static const size_t REMOVED = SIZE_MAX;
+
+    struct Layer
+    {
+        unordered_map<string, size_t> leafOfId;   //new leaf of an id, or REMOVED
+        unordered_map<size_t, string> idOfLeaf;   //leaves whose id changed
+    };
+
+    shared_ptr<const LeafIndex> base;
+    vector<shared_ptr<Layer>> layers;             //oldest first
+    size_t leafCount = 0;
+    bool layerOpen = false;                       //last layer still being written
+
+    Layer& writableLayer()
+    {
+        if (!layerOpen)
+        {
+            layers.push_back(make_shared<Layer>());
+            layerOpen = true;
+        }
+        return *layers.back();
+    }
+
+    static void mergeInto(Layer& older, const Layer& newer)
+    {
+        for (const auto& entry : newer.leafOfId) older.leafOfId[entry.first] = entry.second;
+        for (const auto& entry : newer.idOfLeaf) older.idOfLeaf[entry.first] = entry.second;
+    }
+
+public:
+    VersionIdIndex() : base(make_shared<LeafIndex>()) {}
+    explicit VersionIdIndex(shared_ptr<const LeafIndex> index) : base(move(index)), leafCount(base->size()) {}
+
+    size_t size() const { return leafCount; }
+
+    bool find(const string& id, size_t& leaf) const
+    {
+        for (size_t i = layers.size(); i-- > 0;)
+        {
+            auto it = layers[i]->leafOfId.find(id);
+            if (it == layers[i]->leafOfId.end()) continue;
+            if (it->second == REMOVED) return false;
+            leaf = it->second;
+            return true;
+        }
+        return base->find(id, leaf);
+    }
+
+    bool contains(const string& id) const
+    {
+        size_t leaf;
+        return find(id, leaf);
+    }
+
+    string_view idAt(size_t leaf) const
+    {
+        for (size_t i = layers.size(); i-- > 0;)
+        {
+            auto it = layers[i]->idOfLeaf.find(leaf);
+            if (it != layers[i]->idOfLeaf.end()) return it->second;
+        }
+        return base->idAt(leaf);
+    }
+
+    //give the next leaf this id, false if it is already taken
+    bool append(const string& id)
+    {
+        if (contains(id)) return false;
+        Layer& layer = writableLayer();
+        layer.leafOfId[id] = leafCount;
+        layer.idOfLeaf[leafCount] = id;
+        leafCount++;
+        return true;
+    }
+
+    //same swap as LeafIndex::eraseLeaf: the last leaf's id moves into leaf
+    void eraseLeaf(size_t leaf)
+    {
+        string id(idAt(leaf));
+        size_t last = leafCount - 1;
+        Layer& layer = writableLayer();
+        if (leaf != last)
+        {
+            string movedId(idAt(last));
+            layer.leafOfId[movedId] = leaf;
+            layer.idOfLeaf[leaf] = movedId;
+        }
+        layer.leafOfId[id] = REMOVED;
+        leafCount--;
+    }
+
+    //close the layer written for this version, merging or compacting layers
+    void seal()
+    {
+        if (!layerOpen) return;
+        layerOpen = false;
+
+        while (layers.size() >= 2 && layers[layers.size() - 2]->leafOfId.size() <= 2 * layers.back()->leafOfId.size())
+        {
+            auto merged = make_shared<Layer>(*layers[layers.size() - 2]);
+            mergeInto(*merged, *layers.back());
+            layers.pop_back();
+            layers.back() = move(merged);
+        }
+
+        size_t overlay = 0;
+        for (const auto& layer : layers) overlay += layer->leafOfId.size();
+        if (overlay > max<size_t>(1024, base->size() / 8))
+        {
+            auto compacted = make_shared<LeafIndex>();
+            compacted->reserve(leafCount);
+            for (size_t leaf = 0; leaf < leafCount; leaf++) compacted->append(idAt(leaf));
+            base = move(compacted);
+            layers.clear();
+        }
+    }
+
+    //bytes not yet in counted, shared parts counted once
+    size_t getMemoryUsage(unordered_set<const void*>& counted) const
+    {
+        size_t bytes = 0;
+        if (counted.insert(base.get()).second) bytes += base->getMemoryUsage();
+        for (const auto& layer : layers)
+        {
+            if (!counted.insert(layer.get()).second) continue;
+            for (const auto& entry : layer->leafOfId) bytes += 2 * (entry.first.capacity() + 48);
+        }
+        return bytes;
+    }
+};
+
+// ========================
+// tree version
+// ========================
+// one immutable version of a ConcurrentMerkleTree. same layout and hashing as
+// FlatMerkleTree (levels[0] = leaves, parent of i is i / 2, odd last node
+// paired with itself) so roots and proofs match it, but every level is cut
+// into blocks of BLOCK_NODES digests held by shared_ptr. the next version
+// copies the block pointers and clones only the blocks on dirty paths, so
+// unchanged blocks are shared between versions. the id index is shared the
+// same way (see VersionIdIndex).
+class TreeVersion
+{
+public:
+    static const size_t BLOCK_NODES = 256;    //8 KB of digests
+    typedef vector<Digest> Block;
+
+private:
+    friend class ConcurrentMerkleTree;
+
+    struct Level
+    {
+        size_t size = 0;
+        vector<shared_ptr<Block>> blocks;     //never written once published
+    };
+
+    vector<Level> levels;
+    VersionIdIndex leafIndex;
+    HashMode hashMode = HashMode::HEX_COMPAT;
+    uint64_t number = 0;
+
+public:
+    //bumped by every published change
+    uint64_t getVersion() const { return number; }
+    HashMode getHashMode() const { return hashMode; }
+
+    size_t getHeight() const { return levels.size(); }
+    size_t getLevelSize(size_t level) const { return level < levels.size() ? levels[level].size : 0; }
+    size_t getLeafCount() const { return getLevelSize(0); }
+
+    const Digest& getNode(size_t level, size_t index) const
+    {
+        return (*levels[level].blocks[index / BLOCK_NODES])[index % BLOCK_NODES];
+    }
+
+    Digest getRootDigest() const { return levels.empty() ? Digest{} : getNode(levels.size() - 1, 0); }
+    string getRootHash() const { return levels.empty() ? "" : digestToHex(getRootDigest()); }
+
+    bool contains(const string& reviewId) const { return leafIndex.contains(reviewId); }
+    bool findLeaf(const string& reviewId, size_t& leaf) const { return leafIndex.find(reviewId, leaf); }
+    string_view getLeafId(size_t leaf) const { return leafIndex.idAt(leaf); }
+
+    //bytes of blocks and id index not yet in counted. versions that share
+    //blocks can be summed without counting a shared block twice
+    size_t getMemoryUsage(unordered_set<const void*>& counted) const
+    {
+        size_t bytes = 0;
+        for (const Level& level : levels)
+        {
+            for (const auto& block : level.blocks)
+            {
+                if (counted.insert(block.get()).second) bytes += block->capacity() * sizeof(Digest);
+            }
+        }
+        return bytes + leafIndex.getMemoryUsage(counted);
+    }
+
+    //membership proof of a leaf position as raw sibling digests, leaf to root
+    void generateLeafProof(size_t index, vector<ProofStep>& proof) const
+    {
+        proof.clear();
+        for (size_t level = 0; level + 1 < levels.size(); level++)
+        {
+            ProofStep step;
+            step.siblingOnRight = (index % 2 == 0);
+            size_t sibling = step.siblingOnRight ? index + 1 : index - 1;
+            step.sibling = getNode(level, sibling < levels[level].size ? sibling : index);
+            proof.push_back(step);
+            index /= 2;
+        }
+    }
+
+    //same proof as FlatMerkleTree::generateDigestProof, empty if unknown
+    vector<ProofStep> generateDigestProof(const string& reviewId) const
+    {
+        vector<ProofStep> proof;
+        size_t leaf;
+        if (findLeaf(reviewId, leaf)) generateLeafProof(leaf, proof);
+        return proof;
+    }
+
+    //same proof as FlatMerkleTree::generateProof, empty if unknown
+    vector<string> generateProof(const string& reviewId) const
+    {
+        vector<string> proof;
+        for (const ProofStep& step : generateDigestProof(reviewId))
+        {
+            proof.push_back(digestToHex(step.sibling));
+            proof.push_back(step.siblingOnRight ? "r" : "l");
+        }
+        return proof;
+    }
+};
+
+// ========================
+// concurrent merkle tree
+// ========================
+// read-mostly tree that serves proofs from many threads while reviews are
+// being ingested. readers never lock or write shared state: each reader
+// thread owns a Reader with its own cache line sized slot, pins the current
+// version (announce the epoch in the slot, load the published pointer) and
+// reads it for as long as the Pin lives. a writer builds the next version
+// copy-on-write (see TreeVersion), publishes it with one atomic store, bumps
+// the epoch and retires the old version tagged with the new epoch. a retired
+// version is freed once no slot is pinned at an older epoch, checked on every
+// publish and by reclaim(). writers are serialized by a mutex readers never
+// touch. Readers must be destroyed before the tree.
+class ConcurrentMerkleTree
+{
+public:
+    static const size_t MAX_READERS = 128;
+
+private:
+    struct alignas(64) ReaderSlot
+    {
+        atomic<uint64_t> pinnedEpoch{ 0 };   //0 = not reading
+        atomic<bool> taken{ false };
+    };
+
+    unique_ptr<ReaderSlot[]> slots;
+    atomic<const TreeVersion*> published;
+    atomic<uint64_t> epoch;
+
+    mutable mutex writerMutex;
+    shared_ptr<const TreeVersion> current;
+    vector<pair<uint64_t, shared_ptr<const TreeVersion>>> retired;
+    HashMode hashMode;
+    unsigned threadCount;
+
+    //blocks of the version being written that are private to it
+    vector<vector<char>> ownedBlocks;
+
+    void publish(shared_ptr<const TreeVersion> next)
+    {
+        shared_ptr<const TreeVersion> previous = move(current);
+        current = move(next);
+        published.store(current.get());
+
+        //a reader that announces this epoch or later loads the new pointer
+        uint64_t retireEpoch = epoch.fetch_add(1) + 1;
+        retired.push_back({ retireEpoch, move(previous) });
+        reclaimRetired();
+    }
+
+    void reclaimRetired()
+    {
+        uint64_t oldestPinned = UINT64_MAX;
+        for (size_t i = 0; i < MAX_READERS; i++)
+        {
+            uint64_t pinned = slots[i].pinnedEpoch.load();
+            if (pinned != 0) oldestPinned = min(oldestPinned, pinned);
+        }
+
+        retired.erase(remove_if(retired.begin(), retired.end(),
+            [&](const pair<uint64_t, shared_ptr<const TreeVersion>>& entry) { return entry.first <= oldestPinned; }),
+            retired.end());
+    }
+
+    //make a block of next private (cloned from the shared one) before writing
+    TreeVersion::Block& writableBlock(TreeVersion& next, size_t level, size_t block)
+    {
+        vector<shared_ptr<TreeVersion::Block>>& blocks = next.levels[level].blocks;
+        if (!ownedBlocks[level][block])
+        {
+            blocks[block] = make_shared<TreeVersion::Block>(*blocks[block]);
+            ownedBlocks[level][block] = 1;
+        }
+        return *blocks[block];
+    }
+
+    Digest& writableNode(TreeVersion& next, size_t level, size_t index)
+    {
+        return writableBlock(next, level, index / TreeVersion::BLOCK_NODES)[index % TreeVersion::BLOCK_NODES];
+    }
+
+    //grow or shrink a level, new nodes are zero until their path is rehashed
+    void resizeLevel(TreeVersion& next, size_t level, size_t size)
+    {
+        const size_t B = TreeVersion::BLOCK_NODES;
+        TreeVersion::Level& target = next.levels[level];
+        vector<char>& owned = ownedBlocks[level];
+        size_t blockCount = (size + B - 1) / B;
+
+        if (blockCount < target.blocks.size())
+        {
+            target.blocks.resize(blockCount);
+            owned.resize(blockCount);
+        }
+
+        //fit the old last block, then add whole new blocks
+        if (!target.blocks.empty())
+        {
+            size_t last = target.blocks.size() - 1;
+            size_t lastSize = min(B, size - last * B);
+            if (target.blocks[last]->size() != lastSize) writableBlock(next, level, last).resize(lastSize);
+        }
+        while (target.blocks.size() < blockCount)
+        {
+            size_t blockSize = min(B, size - target.blocks.size() * B);
+            target.blocks.push_back(make_shared<TreeVersion::Block>(blockSize));
+            owned.push_back(1);
+        }
+        target.size = size;
+    }
+
+    static shared_ptr<TreeVersion> emptyVersion(HashMode mode, uint64_t number)
+    {
+        auto version = make_shared<TreeVersion>();
+        version->hashMode = mode;
+        version->number = number;
+        return version;
+    }
+
+public:
+    // ========================
+    // readers
+    // ========================
+
+    //a pinned version, valid until the Pin is destroyed
+    class Pin
+    {
+    private:
+        friend class ConcurrentMerkleTree;
+        ReaderSlot* slot;
+        const TreeVersion* version;
+
+        Pin(ReaderSlot* readerSlot, const TreeVersion* pinned) : slot(readerSlot), version(pinned) {}
+
+    public:
+        Pin(Pin&& other) noexcept : slot(other.slot), version(other.version) { other.slot = nullptr; }
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+        ~Pin()
+        {
+            if (slot) slot->pinnedEpoch.store(0, memory_order_release);
+        }
+
+        const TreeVersion& operator*() const { return *version; }
+        const TreeVersion* operator->() const { return version; }
+    };
+
+    //one per reader thread, owns a slot for as long as it lives
+    class Reader
+    {
+    private:
+        ConcurrentMerkleTree* tree;
+        ReaderSlot* slot;
+
+    public:
+        explicit Reader(ConcurrentMerkleTree& owner) : tree(&owner), slot(nullptr)
+        {
+            for (size_t i = 0; i < MAX_READERS && slot == nullptr; i++)
+            {
+                bool expected = false;
+                if (owner.slots[i].taken.compare_exchange_strong(expected, true)) slot = &owner.slots[i];
+            }
+            if (slot == nullptr) throw runtime_error("too many concurrent tree readers");
+        }
+
+        Reader(Reader&& other) noexcept : tree(other.tree), slot(other.slot) { other.slot = nullptr; }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader()
+        {
+            if (slot) slot->taken.store(false);
+        }
+
+        //pin the newest published version. one pin per reader at a time
+        Pin pin()
+        {
+            if (slot->pinnedEpoch.load(memory_order_relaxed) != 0)
+            {
+                throw logic_error("reader already holds a pinned version");
+            }
+
+            slot->pinnedEpoch.store(tree->epoch.load());
+            return Pin(slot, tree->published.load());
+        }
+    };
+
+    ConcurrentMerkleTree(HashMode mode = HashMode::HEX_COMPAT)
+        : slots(new ReaderSlot[MAX_READERS]), epoch(1), hashMode(mode), threadCount(1)
+    {
+        current = emptyVersion(mode, 0);
+        published.store(current.get());
+    }
+
+    //threads used to hash leaves and batches, 0 = one per core
+    void setThreadCount(unsigned threads) { threadCount = threads; }
+
+    // ========================
+    // writers
+    // ========================
+
+    //publish a copy of an already built flat tree (for example a snapshot)
+    void publishTree(const FlatMerkleTree& tree)
+    {
+        auto next = emptyVersion(tree.getHashMode(), 0);
+        next->levels.resize(tree.getHeight());
+        for (size_t level = 0; level < tree.getHeight(); level++)
+        {
+            TreeVersion::Level& target = next->levels[level];
+            target.size = tree.getLevelSize(level);
+            for (size_t begin = 0; begin < target.size; begin += TreeVersion::BLOCK_NODES)
+            {
+                size_t end = min(target.size, begin + TreeVersion::BLOCK_NODES);
+                auto block = make_shared<TreeVersion::Block>(end - begin);
+                for (size_t index = begin; index < end; index++) (*block)[index - begin] = tree.getNode(level, index);
+                target.blocks.push_back(move(block));
+            }
+        }
+
+        auto index = make_shared<LeafIndex>();
+        index->reserve(tree.getLeafCount());
+        for (size_t leaf = 0; leaf < tree.getLeafCount(); leaf++) index->append(tree.getLeafId(leaf));
+        next->leafIndex = VersionIdIndex(index);
+
+        lock_guard<mutex> lock(writerMutex);
+        hashMode = tree.getHashMode();
+        next->number = current->number + 1;
+        publish(move(next));
+    }
+
+    //build a new tree from review data and ids and publish it
+    void buildTreeFromReviews(const vector<string>& reviewData, const vector<string>& reviewIds)
+    {
+        FlatMerkleTree tree(hashMode);
+        tree.setThreadCount(threadCount);
+        tree.buildTreeFromReviews(reviewData, reviewIds);
+        publishTree(tree);
+    }
+
+    //apply a batch with the same rules and resulting root as
+    //FlatMerkleTree::applyBatch, then publish it as one new version. only the
+    //blocks holding changed nodes are copied; readers keep seeing the old
+    //version until the new one is published
+    BatchResult applyBatch(const vector<TreeUpdate>& updates)
+    {
+        lock_guard<mutex> lock(writerMutex);
+        BatchResult result;
+
+        vector<const uint8_t*> messages;
+        vector<size_t> lengths;
+        for (const TreeUpdate& update : updates)
+        {
+            if (update.type == TreeUpdate::REMOVE) continue;
+            messages.push_back(reinterpret_cast<const uint8_t*>(update.reviewData.data()));
+            lengths.push_back(update.reviewData.size());
+        }
+
+        vector<Digest> leafDigests(messages.size());
+        parallelFor(messages.size(), threadCount, [&](size_t begin, size_t end)
+            {
+                SHA256Batch::hashMessages(&messages[begin], &lengths[begin], &leafDigests[begin], end - begin);
+            }, 256);
+        result.hashesComputed = messages.size();
+
+        auto next = make_shared<TreeVersion>(*current);
+        next->number = current->number + 1;
+        if (next->levels.empty()) next->levels.emplace_back();
+        ownedBlocks.assign(next->levels.size(), vector<char>());
+        for (size_t level = 0; level < next->levels.size(); level++)
+        {
+            ownedBlocks[level].assign(next->levels[level].blocks.size(), 0);
+        }
+
+        size_t oldLeafCount = next->levels[0].size;
+        vector<size_t> dirty;
+        size_t nextDigest = 0;
+
+        for (const TreeUpdate& update : updates)
+        {
+            size_t leaf;
+            size_t leafCount = next->levels[0].size;
+            switch (update.type)
+            {
+            case TreeUpdate::INSERT:
+            {
+                const Digest& digest = leafDigests[nextDigest++];
+                if (!next->leafIndex.append(update.reviewId))
+                {
+                    result.rejected++;
+                    break;
+                }
+                resizeLevel(*next, 0, leafCount + 1);
+                writableNode(*next, 0, leafCount) = digest;
+                dirty.push_back(leafCount);
+                result.inserted++;
+                break;
+            }
+            case TreeUpdate::UPDATE:
+            {
+                const Digest& digest = leafDigests[nextDigest++];
+                if (!next->leafIndex.find(update.reviewId, leaf))
+                {
+                    result.rejected++;
+                    break;
+                }
+                writableNode(*next, 0, leaf) = digest;
+                dirty.push_back(leaf);
+                result.updated++;
+                break;
+            }
+            case TreeUpdate::REMOVE:
+            {
+                if (!next->leafIndex.find(update.reviewId, leaf))
+                {
+                    result.rejected++;
+                    break;
+                }
+                size_t last = leafCount - 1;
+                if (leaf != last)
+                {
+                    writableNode(*next, 0, leaf) = next->getNode(0, last);
+                    dirty.push_back(leaf);
+                }
+                resizeLevel(*next, 0, last);
+                next->leafIndex.eraseLeaf(leaf);
+                result.removed++;
+                break;
+            }
+            }
+        }
+
+        next->leafIndex.seal();
+
+        size_t leafCount = next->levels[0].size;
+        if (leafCount == 0)
+        {
+            next->levels.clear();
+            publish(move(next));
+            return result;
+        }
+
+        size_t height = 1;
+        for (size_t size = leafCount; size > 1; size = (size + 1) / 2) height++;
+        next->levels.resize(height);
+        ownedBlocks.resize(height);
+        for (size_t level = 1; level < height; level++)
+        {
+            resizeLevel(*next, level, (next->levels[level - 1].size + 1) / 2);
+        }
+
+        sort(dirty.begin(), dirty.end());
+        dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+        dirty.erase(lower_bound(dirty.begin(), dirty.end(), leafCount), dirty.end());
+        if (leafCount != oldLeafCount && (dirty.empty() || dirty.back() != leafCount - 1))
+        {
+            dirty.push_back(leafCount - 1);
+        }
+
+        //recompute the dirty parents of each level in one batch
+        size_t messageSize = (next->hashMode == HashMode::RAW_DIGEST) ? 64 : 128;
+        vector<uint8_t> buffers;
+        vector<Digest> parents;
+        vector<size_t> parentDirty;
+
+        for (size_t level = 0; level + 1 < height; level++)
+        {
+            size_t levelSize = next->levels[level].size;
+
+            parentDirty.clear();
+            for (size_t node : dirty)
+            {
+                if (parentDirty.empty() || parentDirty.back() != node / 2) parentDirty.push_back(node / 2);
+            }
+
+            size_t count = parentDirty.size();
+            buffers.resize(count * 128);
+            messages.resize(count);
+            lengths.assign(count, messageSize);
+            parents.resize(count);
+
+            for (size_t j = 0; j < count; j++)
+            {
+                size_t left = 2 * parentDirty[j];
+                size_t right = (left + 1 < levelSize) ? left + 1 : left;
+                SHA256Batch::writePair(next->getNode(level, left), next->getNode(level, right), next->hashMode, &buffers[j * 128]);
+                messages[j] = &buffers[j * 128];
+            }
+
+            parallelFor(count, threadCount, [&](size_t begin, size_t end)
+                {
+                    SHA256Batch::hashMessages(&messages[begin], &lengths[begin], &parents[begin], end - begin);
+                }, 256);
+
+            for (size_t j = 0; j < count; j++)
+            {
+                writableNode(*next, level + 1, parentDirty[j]) = parents[j];
+            }
+
+            result.hashesComputed += count;
+            dirty.swap(parentDirty);
+        }
+
+        publish(move(next));
+        return result;
+    }
+
+    //add a single review as a one entry batch
+    void addReview(const string& reviewData, const string& reviewId)
+    {
+        BatchResult result = applyBatch({ { TreeUpdate::INSERT, reviewId, reviewData } });
+        if (result.rejected > 0)
+        {
+            throw invalid_argument("Review ID already exists: " + reviewId);
+        }
+    }
+
+    //publish an empty tree
+    void clear()
+    {
+        lock_guard<mutex> lock(writerMutex);
+        publish(emptyVersion(hashMode, current->number + 1));
+    }
+
+    //newest version as an owning pointer, for callers that keep a version
+    //beyond a pin (takes the writer lock, not for the proof serving path)
+    shared_ptr<const TreeVersion> getCurrentVersion() const
+    {
+        lock_guard<mutex> lock(writerMutex);
+        return current;
+    }
+
+    //free retired versions no reader can still see, returns how many remain
+    size_t reclaim()
+    {
+        lock_guard<mutex> lock(writerMutex);
+        reclaimRetired();
+        return retired.size();
+    }
+
+    size_t getRetiredCount() const
+    {
+        lock_guard<mutex> lock(writerMutex);
+        return retired.size();
+    }
+};
@@ -7,7 +7,13 @@
 #include <unordered_set>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <charconv>
+#include <string_view>
 #include "json.hpp"
+#include "MappedFile.h"
+#include "JsonLineScanner.h"
+#include "ParallelUtils.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -82,19 +88,81 @@ struct Review
         reviewID = reviewerID + "_" + asin + "_" + unixReviewTime;
     }
 
+    //create review from field values that were extracted without a json DOM
+    Review(string reviewerIdValue, string asinValue, string textValue,
+        string summaryValue, double rating, string reviewTime)
+        : reviewerID(move(reviewerIdValue)), reviewText(move(textValue)), summary(move(summaryValue)),
+        asin(move(asinValue)), overall(rating), unixReviewTime(move(reviewTime))
+    {
+        trimInPlace(reviewerID);
+        trimInPlace(reviewText);
+        trimInPlace(summary);
+        trimInPlace(asin);
+
+        //generate unique ID
+        reviewID = reviewerID + "_" + asin + "_" + unixReviewTime;
+    }
+
     //helpers
     //convert to string so review can be hashed
     string convertToString() const
     {
-        ostringstream oss;
-        oss << "reviewID: " << reviewID << "\n"
-            << "asin: " << asin << "\n"
-            << "reviewerID: " << reviewerID << "\n"
-            << "reviewText: " << reviewText << "\n"
-            << "summary: " << summary << "\n"
-            << "overall: " << overall << "\n"
-            << "unixReviewTime: " << unixReviewTime;
-        return oss.str();
+        string buffer;
+        buffer.reserve(canonicalSize());
+        appendCanonical(buffer);
+        return buffer;
+    }
+
+    //append the hashed layout to buffer without iostreams. the bytes are the
+    //ones the old ostringstream version produced: overall is written like
+    //operator<< with default precision (%g, 6 digits) in the C locale, so
+    //existing roots stay valid. reuse one buffer to avoid allocating per review
+    void appendCanonical(string& buffer) const
+    {
+        char rating[32];
+        size_t ratingLength = formatRating(rating, sizeof(rating));
+
+        buffer.append("reviewID: ").append(reviewID)
+            .append("\nasin: ").append(asin)
+            .append("\nreviewerID: ").append(reviewerID)
+            .append("\nreviewText: ").append(reviewText)
+            .append("\nsummary: ").append(summary)
+            .append("\noverall: ").append(rating, ratingLength)
+            .append("\nunixReviewTime: ").append(unixReviewTime);
+    }
+
+    //review id field of a canonical string, empty if it is not one
+    static string_view canonicalReviewId(string_view reviewData)
+    {
+        size_t stop = reviewData.find("\nasin: ");
+        if (reviewData.compare(0, 10, "reviewID: ") != 0 || stop == string_view::npos) return string_view();
+        return reviewData.substr(10, stop - 10);
+    }
+
+    //asin field of a canonical string, it directly follows the review id
+    static bool canonicalAsin(string_view reviewData, string_view& asin)
+    {
+        const string_view marker = "\nasin: ";
+        size_t start = reviewData.find(marker);
+        if (reviewData.compare(0, 10, "reviewID: ") != 0 || start == string_view::npos) return false;
+        start += marker.size();
+        size_t stop = reviewData.find('\n', start);
+        asin = reviewData.substr(start, stop == string_view::npos ? string_view::npos : stop - start);
+        return true;
+    }
+
+    //upper bound on the bytes appendCanonical writes
+    size_t canonicalSize() const
+    {
+        return 80 + reviewID.size() + asin.size() + reviewerID.size() + reviewText.size()
+            + summary.size() + unixReviewTime.size() + 32;
+    }
+
+    //overall formatted like ostream << double, returns the length
+    size_t formatRating(char* out, size_t capacity) const
+    {
+        auto result = to_chars(out, out + capacity, overall, chars_format::general, 6);
+        return static_cast<size_t>(result.ptr - out);
     }
 
     //trim whitespace from strings
@@ -109,6 +177,19 @@ struct Review
         return str.substr(start, end - start + 1);
     }
 
+    //same as trimString without allocating a new string
+    static void trimInPlace(string& str)
+    {
+        size_t end = str.find_last_not_of(" \t\n\r");
+        if (end == string::npos)
+        {
+            str.clear();
+            return;
+        }
+        str.erase(end + 1);
+        str.erase(0, str.find_first_not_of(" \t\n\r"));
+    }
+
     //getters
     string getUniqueID() const { return reviewID; }
 };
@@ -201,6 +282,170 @@ public:
         return true;
     }
 
+    //load reviews by mapping the file and scanning each line in place. only the
+    //fields Review needs are extracted, there is no json DOM and unescaped
+    //strings are copied once straight from the mapping. accepts, skips and
+    //orders records exactly like loadFromJSON
+    bool loadFromJSONMapped(const string& filename, int maxRecords)
+    {
+        MappedFile file;
+        if (!file.open(filename))
+        {
+            cout << "Could not open file " << filename << endl;
+            return false;
+        }
+
+        reviews.clear();
+        int count = 0;
+        int duplicatesRemoved = 0;
+        unordered_set<string> parsedIDs;
+        JsonLineScanner scanner;
+        string errorMessage;
+
+        cout << "Loading reviews from " << filename << " (memory mapped)" << endl;
+
+        const char* cursor = file.data();
+        const char* fileEnd = file.data() + file.size();
+
+        while (cursor < fileEnd)
+        {
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', fileEnd - cursor));
+            const char* lineEnd = newline ? newline : fileEnd;
+            string_view line(cursor, static_cast<size_t>(lineEnd - cursor));
+            cursor = newline ? newline + 1 : fileEnd;
+
+            LineStatus status = parseReviewLine(line, scanner, reviews, errorMessage);
+            if (status == LineStatus::PARSE_ERROR)
+            {
+                cout << "Error parsing JSON line: " << errorMessage << endl;
+                continue;
+            }
+            if (status != LineStatus::ACCEPTED) continue;
+
+            if (!acceptLastReview(parsedIDs, duplicatesRemoved)) continue;
+            count++;
+
+            if (count % 100000 == 0)
+            {
+                cout << "Loaded " << count << " reviews..." << endl;
+            }
+
+            if (maxRecords > 0 && count >= maxRecords)
+            {
+                break;
+            }
+        }
+
+        totalRecords = count;
+
+        if (duplicatesRemoved > 0)
+        {
+            cout << "Removed " << duplicatesRemoved << " duplicate reviews" << endl;
+        }
+
+        cout << "Successfully loaded " << totalRecords << " reviews" << endl;
+        return true;
+    }
+
+    //load reviews with the mapped scanner on several threads. the file is cut
+    //into newline aligned chunks that are parsed a wave at a time, then merged
+    //in file order so duplicate removal, maxRecords and the resulting reviews
+    //(and root hash) are identical to loadFromJSON. 0 threads = one per core
+    bool loadFromJSONParallel(const string& filename, int maxRecords, unsigned threadCount, size_t chunkSize = 4 << 20)
+    {
+        MappedFile file;
+        if (!file.open(filename))
+        {
+            cout << "Could not open file " << filename << endl;
+            return false;
+        }
+
+        unsigned threads = resolveThreadCount(threadCount);
+        reviews.clear();
+        int count = 0;
+        int duplicatesRemoved = 0;
+        unordered_set<string> parsedIDs;
+
+        cout << "Loading reviews from " << filename << " (" << threads << " threads)" << endl;
+
+        //chunk boundaries, each chunk starts right after a newline
+        chunkSize = max<size_t>(1, chunkSize);
+        const char* fileEnd = file.data() + file.size();
+        vector<const char*> boundaries;
+        const char* chunkStart = file.data();
+        while (chunkStart < fileEnd)
+        {
+            boundaries.push_back(chunkStart);
+            if (static_cast<size_t>(fileEnd - chunkStart) <= chunkSize) break;
+            const char* newline = static_cast<const char*>(memchr(chunkStart + chunkSize, '\n', fileEnd - chunkStart - chunkSize));
+            chunkStart = newline ? newline + 1 : fileEnd;
+        }
+        boundaries.push_back(fileEnd);
+
+        size_t chunkCount = boundaries.size() - 1;
+        bool stop = false;
+
+        for (size_t waveStart = 0; waveStart < chunkCount && !stop; waveStart += threads)
+        {
+            size_t waveSize = min<size_t>(threads, chunkCount - waveStart);
+            vector<ParsedChunk> wave(waveSize);
+
+            parallelFor(waveSize, threads, [&](size_t begin, size_t end) {
+                JsonLineScanner scanner;
+                for (size_t c = begin; c < end; c++)
+                {
+                    parseChunk(boundaries[waveStart + c], boundaries[waveStart + c + 1], scanner, wave[c]);
+                }
+            }, 1);
+
+            //merge in file order
+            for (size_t c = 0; c < waveSize && !stop; c++)
+            {
+                ParsedChunk& chunk = wave[c];
+                size_t nextError = 0;
+
+                for (size_t i = 0; i < chunk.reviews.size(); i++)
+                {
+                    //errors from lines before this review
+                    while (nextError < chunk.errors.size() && chunk.errors[nextError].first <= i)
+                    {
+                        cout << "Error parsing JSON line: " << chunk.errors[nextError++].second << endl;
+                    }
+
+                    reviews.push_back(move(chunk.reviews[i]));
+                    if (!acceptLastReview(parsedIDs, duplicatesRemoved)) continue;
+                    count++;
+
+                    if (count % 100000 == 0)
+                    {
+                        cout << "Loaded " << count << " reviews..." << endl;
+                    }
+
+                    if (maxRecords > 0 && count >= maxRecords)
+                    {
+                        stop = true;
+                        break;
+                    }
+                }
+
+                while (!stop && nextError < chunk.errors.size())
+                {
+                    cout << "Error parsing JSON line: " << chunk.errors[nextError++].second << endl;
+                }
+            }
+        }
+
+        totalRecords = count;
+
+        if (duplicatesRemoved > 0)
+        {
+            cout << "Removed " << duplicatesRemoved << " duplicate reviews" << endl;
+        }
+
+        cout << "Successfully loaded " << totalRecords << " reviews" << endl;
+        return true;
+    }
+
     //helper to print sample reviews
     void printSampleReviews(int count) const
     {
@@ -233,6 +478,147 @@ public:
             });
     }
 
+    enum class LineStatus
+    {
+        ACCEPTED,
+        SKIPPED,
+        PARSE_ERROR
+    };
+
+    //parse one json line and append the review to out. blank lines and
+    //reviews without text are SKIPPED; invalid json and fields of the wrong
+    //type are PARSE_ERROR, mirroring what Review(const json&) throws on
+    static LineStatus parseReviewLine(string_view line, JsonLineScanner& scanner,
+        vector<Review>& out, string& errorMessage)
+    {
+        static const char* const names[] = { "reviewerID", "asin", "reviewText", "summary", "overall", "unixReviewTime" };
+        JsonLineScanner::Field fields[6];
+
+        if (all_of(line.begin(), line.end(), [](unsigned char c) { return isspace(c); }))
+            return LineStatus::SKIPPED;
+
+        //nlohmann skips a utf-8 byte order mark at the start of its input
+        if (line.size() >= 3 && memcmp(line.data(), "\xEF\xBB\xBF", 3) == 0) line.remove_prefix(3);
+
+        bool isObject;
+        if (!scanner.scan(line, names, fields, 6, isObject))
+        {
+            errorMessage = scanner.getError();
+            return LineStatus::PARSE_ERROR;
+        }
+        if (!isObject) return LineStatus::SKIPPED;
+
+        string reviewerIdValue, asinValue, textValue, summaryValue, reviewTime;
+        bool typesValid = true;
+        if (fields[5].type == JsonLineScanner::NUMBER)
+            reviewTime = to_string(jsonNumberToLong(fields[5].raw));
+        else
+            typesValid = extractString(fields[5], reviewTime);
+
+        typesValid = typesValid && extractString(fields[0], reviewerIdValue) && extractString(fields[1], asinValue) &&
+            extractString(fields[2], textValue) && extractString(fields[3], summaryValue);
+
+        if (!typesValid)
+        {
+            errorMessage = "type must be string";
+            return LineStatus::PARSE_ERROR;
+        }
+
+        //skip reviews with empty text
+        Review::trimInPlace(textValue);
+        if (textValue.empty()) return LineStatus::SKIPPED;
+
+        double rating = (fields[4].type == JsonLineScanner::NUMBER) ? jsonNumberToDouble(fields[4].raw) : 0.0;
+
+        out.emplace_back(move(reviewerIdValue), move(asinValue), move(textValue),
+            move(summaryValue), rating, move(reviewTime));
+        return LineStatus::ACCEPTED;
+    }
+
+    //reviews parsed from one chunk, errors are tagged with the number of
+    //reviews that came before them in the chunk
+    struct ParsedChunk
+    {
+        vector<Review> reviews;
+        vector<pair<size_t, string>> errors;
+    };
+
+    //parse every line in [begin, end) into chunk
+    static void parseChunk(const char* begin, const char* end, JsonLineScanner& scanner, ParsedChunk& chunk)
+    {
+        string errorMessage;
+        while (begin < end)
+        {
+            const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            const char* lineEnd = newline ? newline : end;
+            string_view line(begin, static_cast<size_t>(lineEnd - begin));
+            begin = newline ? newline + 1 : end;
+
+            if (parseReviewLine(line, scanner, chunk.reviews, errorMessage) == LineStatus::PARSE_ERROR)
+            {
+                chunk.errors.emplace_back(chunk.reviews.size(), errorMessage);
+            }
+        }
+    }
+
+    //copy a string field (decoding escapes if any), false if it is not a string
+    static bool extractString(const JsonLineScanner::Field& field, string& out)
+    {
+        if (field.type == JsonLineScanner::MISSING)
+        {
+            out.clear();
+            return true;
+        }
+        if (field.type != JsonLineScanner::STRING) return false;
+
+        if (field.hasEscapes) JsonLineScanner::decodeString(field.raw, out);
+        else out.assign(field.raw.data(), field.raw.size());
+        return true;
+    }
+
+    //json number as nlohmann get<double> returns it
+    static double jsonNumberToDouble(string_view raw)
+    {
+        double value = 0.0;
+        auto result = from_chars(raw.data(), raw.data() + raw.size(), value);
+        if (result.ec == errc::result_out_of_range)
+        {
+            value = strtod(string(raw).c_str(), nullptr);
+        }
+        return value;
+    }
+
+    //json number as nlohmann get<long> returns it (integers stay exact)
+    static long jsonNumberToLong(string_view raw)
+    {
+        if (raw.find_first_of(".eE") == string_view::npos)
+        {
+            if (raw[0] == '-')
+            {
+                long long value;
+                if (from_chars(raw.data(), raw.data() + raw.size(), value).ec == errc()) return static_cast<long>(value);
+            }
+            else
+            {
+                unsigned long long value;
+                if (from_chars(raw.data(), raw.data() + raw.size(), value).ec == errc()) return static_cast<long>(value);
+            }
+        }
+        return static_cast<long>(jsonNumberToDouble(raw));
+    }
+
+    //keep reviews.back() unless its id was already seen (first one wins)
+    bool acceptLastReview(unordered_set<string>& parsedIDs, int& duplicatesRemoved)
+    {
+        if (!parsedIDs.insert(reviews.back().getUniqueID()).second)
+        {
+            reviews.pop_back();
+            duplicatesRemoved++;
+            return false;
+        }
+        return true;
+    }
+
     //getters
     const vector<Review>& getReviews() const { return reviews; }
 
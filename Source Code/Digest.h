@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "SHA256.h"
+
+using namespace std;
+
+// ========================
+// fixed size sha-256 digest
+// ========================
+typedef array<uint8_t, 32> Digest;
+
+//write 64 lowercase hex chars into out (no terminator)
+inline void writeDigestHex(const Digest& digest, char* out)
+{
+    static const char hexChars[] = "0123456789abcdef";
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+        out[2 * i] = hexChars[digest[i] >> 4];
+        out[2 * i + 1] = hexChars[digest[i] & 0x0f];
+    }
+}
+
+//convert digest to the 64 char hex form used for display and storage
+inline string digestToHex(const Digest& digest)
+{
+    string hex(64, '0');
+    writeDigestHex(digest, &hex[0]);
+    return hex;
+}
+
+//parse 64 char hex string back into a digest, false if malformed
+inline bool digestFromHex(const string& hex, Digest& digest)
+{
+    if (hex.size() != 64) return false;
+
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+        int value = 0;
+        for (int j = 0; j < 2; j++)
+        {
+            char c = hex[2 * i + j];
+            int nibble;
+            if (c >= '0' && c <= '9') nibble = c - '0';
+            else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+            else return false;
+            value = (value << 4) | nibble;
+        }
+        digest[i] = static_cast<uint8_t>(value);
+    }
+    return true;
+}
+
+//byte order matches the order of the lowercase hex strings
+inline bool digestLess(const Digest& a, const Digest& b)
+{
+    return memcmp(a.data(), b.data(), a.size()) < 0;
+}
+
+// ========================
+// digest hashing
+// ========================
+// HEX_COMPAT combines children by hashing their 128 char hex forms, which is
+// what MerkleTree does. RAW_DIGEST hashes the 64 raw bytes instead: one less
+// compression per internal node and no hex encoding, but different roots.
+enum class HashMode
+{
+    HEX_COMPAT,
+    RAW_DIGEST
+};
+
+//hash raw bytes into a digest
+inline void hashToDigest(SHA256& hasher, const void* data, size_t length, Digest& out)
+{
+    hasher.reset();
+    hasher.add(data, length);
+    hasher.getHash(out.data());
+}
+
+//parent digest of two children, combined in sorted order like MerkleTree
+inline void combineDigests(SHA256& hasher, const Digest& a, const Digest& b, HashMode mode, Digest& out)
+{
+    const Digest& first = digestLess(b, a) ? b : a;
+    const Digest& second = (&first == &a) ? b : a;
+
+    if (mode == HashMode::RAW_DIGEST)
+    {
+        uint8_t buffer[64];
+        memcpy(buffer, first.data(), 32);
+        memcpy(buffer + 32, second.data(), 32);
+        hashToDigest(hasher, buffer, sizeof(buffer), out);
+    }
+    else
+    {
+        char buffer[128];
+        writeDigestHex(first, buffer);
+        writeDigestHex(second, buffer + 64);
+        hashToDigest(hasher, buffer, sizeof(buffer), out);
+    }
+}
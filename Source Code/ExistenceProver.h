@@ -4,7 +4,11 @@
 #include <string>
 #include <unordered_map>
 #include <chrono>
+#include <algorithm>
 #include "MerkleTree.h"
+#include "MultiProof.h"
+#include "SortedMerkleTree.h"
+#include "BatchVerifier.h"
 
 using namespace std;
 
@@ -15,6 +19,8 @@ struct ProofResult
     string status;
     vector<string> proofPath;
     bool verified = false;
+    bool absenceProven = false;      //REVIEW_NOT_FOUND backed by a non-membership proof
+    NonMembershipProof absenceProof;
     long long proofTimeMicros = 0;
     long long verificationTimeMicros = 0;
     chrono::system_clock::time_point timestamp;
@@ -24,6 +30,11 @@ struct ProofResult
         cout << "Proof Result:" << endl;
         cout << "  Review ID: " << reviewId << endl;
         cout << "  Status: " << status << endl;
+        if (absenceProven)
+        {
+            cout << "  Absence Proven: YES (" << absenceProof.leafData.size() << " bracketing leaves, "
+                << absenceProof.proof.siblings.size() << " siblings)" << endl;
+        }
         if (!proofPath.empty())
         {
             cout << "  Proof Size: " << proofPath.size() << " elements" << endl;
@@ -41,35 +52,95 @@ struct ProofResult
     }
 };
 
+struct MultiProofResult
+{
+    vector<string> reviewIds;
+    vector<string> reviewData;
+    string status;
+    MultiProof proof;
+    bool verified = false;
+    long long proofTimeMicros = 0;
+    long long verificationTimeMicros = 0;
+
+    void print() const
+    {
+        cout << "Multiproof Result:" << endl;
+        cout << "  Reviews: " << reviewIds.size() << endl;
+        cout << "  Status: " << status << endl;
+        if (status == "PROOF_GENERATED")
+        {
+            cout << "  Siblings: " << proof.siblings.size() << " (vs "
+                << MultiProofs::individualProofDigests(proof) << " in single proofs)" << endl;
+            cout << "  Payload: " << proof.payloadBytes() << " bytes" << endl;
+            cout << "  Verified: " << (verified ? "YES" : "NO") << endl;
+            cout << "  Generation Time: " << proofTimeMicros << " microseconds" << endl;
+            cout << "  Verification Time: " << verificationTimeMicros << " microseconds" << endl;
+        }
+        cout << endl;
+    }
+};
+
 class ExistenceProof
 {
 private:
     MerkleTree* merkleTree;
+    const SortedMerkleTree* sortedTree = nullptr;
     unordered_map<string, string> reviewIdToData;
     unordered_map<string, vector<string>> productToReviewIds;
 
 public:
     ExistenceProof(MerkleTree* tree) : merkleTree(tree) {}
 
+    //id sorted tree over the same reviews, lets missing reviews come with a
+    //non-membership proof against its root
+    void attachSortedTree(const SortedMerkleTree* tree) { sortedTree = tree; }
+
     void indexReviews(const vector<Review>& reviews)
     {
         reviewIdToData.clear();
         productToReviewIds.clear();
 
+        reviewIdToData.reserve(reviews.size());
         for (const auto& review : reviews)
         {
-            string reviewData = review.convertToString();
-            string reviewId = review.getUniqueID();
-            string productId = review.asin;
-
-            reviewIdToData[reviewId] = reviewData;
-            productToReviewIds[productId].push_back(reviewId);
+            string& reviewData = reviewIdToData[review.reviewID];
+            reviewData.clear();
+            reviewData.reserve(review.canonicalSize());
+            review.appendCanonical(reviewData);
+            productToReviewIds[review.asin].push_back(review.reviewID);
         }
 
         cout << "Indexed " << reviewIdToData.size() << " reviews for "
             << productToReviewIds.size() << " products" << endl;
     }
 
+    //add or replace one review without reindexing everything
+    void indexReview(const Review& review)
+    {
+        auto dataIt = reviewIdToData.find(review.reviewID);
+        if (dataIt == reviewIdToData.end())
+        {
+            dataIt = reviewIdToData.emplace(review.reviewID, string()).first;
+            productToReviewIds[review.asin].push_back(review.reviewID);
+        }
+
+        dataIt->second.clear();
+        review.appendCanonical(dataIt->second);
+    }
+
+    //drop one review from both indexes
+    void removeReview(const Review& review)
+    {
+        if (reviewIdToData.erase(review.reviewID) == 0) return;
+
+        auto productIt = productToReviewIds.find(review.asin);
+        if (productIt == productToReviewIds.end()) return;
+
+        vector<string>& ids = productIt->second;
+        ids.erase(remove(ids.begin(), ids.end(), review.reviewID), ids.end());
+        if (ids.empty()) productToReviewIds.erase(productIt);
+    }
+
     ProofResult generateReviewProof(const string& reviewId)
     {
         ProofResult result;
@@ -82,6 +153,14 @@ public:
         if (dataIt == reviewIdToData.end())
         {
             result.status = "REVIEW_NOT_FOUND";
+            if (sortedTree && sortedTree->generateNonMembershipProof(reviewId, result.absenceProof))
+            {
+                auto end = chrono::high_resolution_clock::now();
+                result.proofTimeMicros = chrono::duration_cast<chrono::microseconds>(end - start).count();
+                result.absenceProven = SortedMerkleTree::verifyNonMembershipProof(result.absenceProof,
+                    sortedTree->getRootDigest(), sortedTree->getHashMode());
+                return result;
+            }
             result.proofTimeMicros = 0;
             return result;
         }
@@ -162,6 +241,73 @@ public:
         return results;
     }
 
+    //one multiproof covering all reviewIds, each shared sibling included once
+    MultiProofResult generateMultiproof(const vector<string>& reviewIds)
+    {
+        MultiProofResult result;
+        result.reviewIds = reviewIds;
+        result.reviewData.reserve(reviewIds.size());
+
+        for (const string& reviewId : reviewIds)
+        {
+            auto dataIt = reviewIdToData.find(reviewId);
+            if (dataIt == reviewIdToData.end())
+            {
+                result.status = "REVIEW_NOT_FOUND: " + reviewId;
+                return result;
+            }
+            result.reviewData.push_back(dataIt->second);
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        bool generated = !reviewIds.empty() && MultiProofs::generate(*merkleTree, reviewIds, result.proof);
+        auto end = chrono::high_resolution_clock::now();
+        result.proofTimeMicros = chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+        if (!generated)
+        {
+            result.status = "PROOF_GENERATION_FAILED";
+            return result;
+        }
+
+        result.status = "PROOF_GENERATED";
+        start = chrono::high_resolution_clock::now();
+        result.verified = MultiProofs::verify(result.reviewData, result.proof, merkleTree->getRootHash());
+        end = chrono::high_resolution_clock::now();
+        result.verificationTimeMicros = chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+        return result;
+    }
+
+    //multiproof for every review of a product
+    MultiProofResult generateProductMultiproof(const string& productId)
+    {
+        auto productIt = productToReviewIds.find(productId);
+        if (productIt == productToReviewIds.end())
+        {
+            MultiProofResult emptyResult;
+            emptyResult.status = "PRODUCT_NOT_FOUND";
+            return emptyResult;
+        }
+
+        cout << "Generating multiproof for product " << productId
+            << " (" << productIt->second.size() << " reviews)" << endl;
+        return generateMultiproof(productIt->second);
+    }
+
+    //re-verify generated proofs against rootHash in one batch, as an auditor
+    //holding only the proofs would. results[i] is 1 if proofs[i] verified
+    static vector<uint8_t> verifyProofsBatch(const vector<ProofResult>& proofs, const string& rootHash, unsigned threads = 0)
+    {
+        BatchVerifier verifier(HashMode::HEX_COMPAT, threads);
+        size_t rootId = verifier.addRoot(rootHash);
+        for (const ProofResult& proof : proofs)
+        {
+            verifier.add(proof.reviewData, proof.proofPath, rootId);
+        }
+        return verifier.verifyAll();
+    }
+
     static ProofResult verifyProofExternally(const string& reviewData, const vector<string>& proof, const string& rootHash)
     {
         ProofResult result;
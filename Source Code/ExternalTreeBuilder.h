@@ -0,0 +1,662 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include "DataPreprocessor.h"
+#include "MappedFile.h"
+#include "JsonLineScanner.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "LeafIndex.h"
+#include "TreeSnapshot.h"
+
+using namespace std;
+
+// ========================
+// external memory tree builder
+// ========================
+// builds the tree for corpora that do not fit in RAM and writes it straight
+// into a snapshot file, which FlatMerkleTree::loadSnapshot then maps. nothing
+// proportional to the record count is held in memory:
+//
+//   1. spill    json lines are parsed and hashed in batches (hashing overlaps
+//               parsing like StreamingTreeBuilder). leaf digests, ids and id
+//               end offsets are appended to spill files, and each id's
+//               (fingerprint, record) key goes to a run buffer that is sorted
+//               and written out as a run file whenever it fills up
+//   2. dedupe   the runs are merged, records with equal fingerprints have their
+//               real ids compared and later copies are dropped (first one
+//               wins, like DataPreprocessor::loadFromJSON)
+//   3. leaves   surviving digests become the snapshot's leaf level, their ids
+//               are respilled in the snapshot's offset/arena layout
+//   4. levels   every level is read back from the snapshot in chunks and its
+//               parents appended, one sequential pass per level
+//   5. ids      the id offsets and arena are copied in after the levels and
+//               the header goes in last with the body checksum
+//
+// memory is the two record batches plus the run buffer and the level chunk,
+// which share setMemoryBudget. the snapshot has no persisted index table, the
+// id index is rebuilt when the file is loaded.
+class ExternalTreeBuilder
+{
+private:
+    //duplicate check key, runs are sorted by fingerprint then record
+    struct IdKey
+    {
+        uint64_t fingerprint;
+        uint64_t record;
+
+        bool operator<(const IdKey& other) const
+        {
+            return fingerprint != other.fingerprint ? fingerprint < other.fingerprint : record < other.record;
+        }
+    };
+
+    //sequential reader over count items of a file starting at offsetBytes,
+    //bufferItems at a time
+    template<typename T>
+    class SpillReader
+    {
+    private:
+        ifstream file;
+        vector<T> buffer;
+        size_t position;
+        size_t filled;
+        uint64_t remaining;
+
+        bool refill()
+        {
+            filled = static_cast<size_t>(min<uint64_t>(remaining, buffer.size()));
+            position = 0;
+            if (filled == 0) return false;
+            file.read(reinterpret_cast<char*>(buffer.data()), static_cast<streamsize>(filled * sizeof(T)));
+            if (!file.good()) filled = 0;
+            remaining -= filled;
+            return filled > 0;
+        }
+
+    public:
+        SpillReader() : position(0), filled(0), remaining(0) {}
+
+        bool open(const string& filename, uint64_t offsetBytes, uint64_t count, size_t bufferItems)
+        {
+            file.open(filename, ios::binary);
+            if (!file.is_open()) return false;
+            file.seekg(static_cast<streamoff>(offsetBytes));
+            buffer.resize(static_cast<size_t>(max<uint64_t>(1, min<uint64_t>(bufferItems, count))));
+            position = filled = 0;
+            remaining = count;
+            return file.good();
+        }
+
+        bool next(T& item)
+        {
+            if (position == filled && !refill()) return false;
+            item = buffer[position++];
+            return true;
+        }
+
+        //up to count items into out, returns how many were read
+        size_t read(T* out, size_t count)
+        {
+            size_t done = 0;
+            while (done < count && (position < filled || refill()))
+            {
+                size_t take = min(count - done, filled - position);
+                memcpy(out + done, buffer.data() + position, take * sizeof(T));
+                position += take;
+                done += take;
+            }
+            return done;
+        }
+    };
+
+    //one parsed batch: canonical strings and ids, then their digests. the
+    //canonical buffers are kept between batches
+    struct Batch
+    {
+        vector<string> reviewData;
+        vector<string> reviewIds;
+        vector<Digest> digests;
+        uint64_t firstRecord = 0;
+
+        //next canonical buffer, emptied but keeping its capacity
+        string& nextData()
+        {
+            if (reviewData.size() <= reviewIds.size()) reviewData.emplace_back();
+            string& buffer = reviewData[reviewIds.size()];
+            buffer.clear();
+            return buffer;
+        }
+    };
+
+    static constexpr size_t COPY_BUFFER = 1 << 20; //bytes per sequential reader
+
+    size_t batchSize;
+    unsigned threadCount;
+    HashMode hashMode;
+    size_t memoryBudget;
+    string spillPrefix;
+
+    //state of the build in progress
+    string prefix;
+    ofstream leafSpill;
+    ofstream idSpill;
+    ofstream idEndSpill;
+    uint64_t idSpillBytes;
+    vector<IdKey> runBuffer;
+    vector<string> runFiles;
+    vector<uint64_t> runSizes;
+    vector<string> spillFiles;
+
+    uint64_t recordCount;        //records spilled, duplicates included
+    uint64_t leafCount;          //leaves written to the snapshot
+    uint64_t duplicatesRemoved;
+    uint64_t spillBytes;
+
+    size_t runCapacity() const { return max<size_t>(16, memoryBudget / 2 / sizeof(IdKey)); }
+
+    //digests per level chunk, even so a chunk never splits a sibling pair.
+    //the chunk and its parents take a quarter of the budget
+    size_t chunkDigests() const
+    {
+        size_t chunk = memoryBudget / 4 / (sizeof(Digest) + sizeof(Digest) / 2);
+        return max<size_t>(2, chunk & ~static_cast<size_t>(1));
+    }
+
+    template<typename T>
+    static size_t bufferItems() { return max<size_t>(1, COPY_BUFFER / sizeof(T)); }
+
+    string spillName(const string& name) const { return prefix + "." + name + ".spill"; }
+
+    bool openSpill(ofstream& file, const string& filename)
+    {
+        spillFiles.push_back(filename);
+        file.open(filename, ios::binary | ios::trunc);
+        if (!file.is_open())
+        {
+            cout << "Could not open spill file " << filename << endl;
+            return false;
+        }
+        return true;
+    }
+
+    void removeSpills()
+    {
+        leafSpill.close();
+        idSpill.close();
+        idEndSpill.close();
+        for (const string& filename : spillFiles) remove(filename.c_str());
+        spillFiles.clear();
+        runFiles.clear();
+        runSizes.clear();
+        runBuffer.clear();
+        runBuffer.shrink_to_fit();
+    }
+
+    //sort the run buffer and write it out as the next run file
+    bool writeRun()
+    {
+        if (runBuffer.empty()) return true;
+
+        sort(runBuffer.begin(), runBuffer.end());
+        string filename = spillName("run" + to_string(runFiles.size()));
+        ofstream run;
+        if (!openSpill(run, filename)) return false;
+        run.write(reinterpret_cast<const char*>(runBuffer.data()), static_cast<streamsize>(runBuffer.size() * sizeof(IdKey)));
+
+        spillBytes += runBuffer.size() * sizeof(IdKey);
+        runFiles.push_back(filename);
+        runSizes.push_back(runBuffer.size());
+        runBuffer.clear();
+        return run.good();
+    }
+
+    //hash a batch across threads and append it to the spill files
+    bool spillBatch(Batch& batch)
+    {
+        size_t count = batch.reviewIds.size();
+        batch.digests.resize(count);
+        parallelFor(count, threadCount, [&](size_t begin, size_t end)
+            {
+                SHA256Batch::hashStrings(batch.reviewData, begin, end, &batch.digests[begin]);
+            }, 256);
+
+        leafSpill.write(reinterpret_cast<const char*>(batch.digests.data()), static_cast<streamsize>(count * sizeof(Digest)));
+        spillBytes += count * (sizeof(Digest) + sizeof(uint64_t));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const string& id = batch.reviewIds[i];
+            idSpill.write(id.data(), static_cast<streamsize>(id.size()));
+            idSpillBytes += id.size();
+            spillBytes += id.size();
+            idEndSpill.write(reinterpret_cast<const char*>(&idSpillBytes), sizeof(idSpillBytes));
+
+            runBuffer.push_back({ LeafIndex::fingerprint(id), batch.firstRecord + i });
+            if (runBuffer.size() >= runCapacity() && !writeRun()) return false;
+        }
+
+        return leafSpill.good() && idSpill.good() && idEndSpill.good();
+    }
+
+    //pass 1: parse, hash and spill every accepted record of every input
+    bool spillInputs(const vector<string>& inputFiles)
+    {
+        if (!openSpill(leafSpill, spillName("leaves")) || !openSpill(idSpill, spillName("ids")) ||
+            !openSpill(idEndSpill, spillName("idends")))
+        {
+            return false;
+        }
+
+        bool overlap = resolveThreadCount(threadCount) > 1;
+        Batch batches[2];
+        Batch* parsing = &batches[0];
+        Batch* hashing = &batches[1];
+        thread worker;
+        atomic<bool> spillOk(true);
+
+        //spill the parsed batch (on the worker unless it is the last one) and
+        //start the next. spill files are only touched by one batch at a time
+        auto handOff = [&](bool last)
+            {
+                if (worker.joinable()) worker.join();
+                swap(parsing, hashing);
+                parsing->reviewIds.clear();
+                parsing->firstRecord = recordCount;
+                if (hashing->reviewIds.empty()) return;
+
+                if (overlap && !last) worker = thread([this, hashing, &spillOk]() { if (!spillBatch(*hashing)) spillOk = false; });
+                else if (!spillBatch(*hashing)) spillOk = false;
+            };
+
+        JsonLineScanner scanner;
+        vector<Review> scratch;
+        string errorMessage;
+        bool opened = true;
+
+        for (const string& filename : inputFiles)
+        {
+            MappedFile file;
+            if (!file.open(filename))
+            {
+                cout << "Could not open file " << filename << endl;
+                opened = false;
+                break;
+            }
+            cout << "Spilling reviews from " << filename << " in batches of " << batchSize << endl;
+
+            //batches hold copies, so a batch can outlive its file's mapping
+            const char* cursor = file.data();
+            const char* fileEnd = file.data() + file.size();
+            while (cursor < fileEnd && spillOk)
+            {
+                const char* lineStart = cursor;
+                const char* newline = static_cast<const char*>(memchr(cursor, '\n', fileEnd - cursor));
+                const char* lineEnd = newline ? newline : fileEnd;
+                cursor = newline ? newline + 1 : fileEnd;
+
+                scratch.clear();
+                DataPreprocessor::LineStatus status = DataPreprocessor::parseReviewLine(
+                    string_view(lineStart, static_cast<size_t>(lineEnd - lineStart)), scanner, scratch, errorMessage);
+                if (status == DataPreprocessor::LineStatus::PARSE_ERROR)
+                {
+                    cout << "Error parsing JSON line: " << errorMessage << endl;
+                    continue;
+                }
+                if (status != DataPreprocessor::LineStatus::ACCEPTED) continue;
+
+                const Review& review = scratch.back();
+                review.appendCanonical(parsing->nextData());
+                parsing->reviewIds.push_back(review.reviewID);
+                recordCount++;
+
+                if (recordCount % 1000000 == 0)
+                {
+                    cout << "Spilled " << recordCount << " reviews..." << endl;
+                }
+
+                if (parsing->reviewIds.size() >= batchSize) handOff(false);
+            }
+        }
+
+        handOff(true);
+        if (worker.joinable()) worker.join();
+
+        leafSpill.close();
+        idSpill.close();
+        idEndSpill.close();
+        if (!opened) return false;
+        if (!spillOk || !writeRun())
+        {
+            cout << "Error writing spill files" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    //id of a spilled record, read back by offset (only for fingerprint ties)
+    bool readSpilledId(ifstream& ids, ifstream& idEnds, uint64_t record, string& id) const
+    {
+        uint64_t bounds[2] = { 0, 0 };
+        if (record == 0)
+        {
+            idEnds.seekg(0);
+            idEnds.read(reinterpret_cast<char*>(&bounds[1]), sizeof(uint64_t));
+        }
+        else
+        {
+            idEnds.seekg(static_cast<streamoff>((record - 1) * sizeof(uint64_t)));
+            idEnds.read(reinterpret_cast<char*>(bounds), sizeof(bounds));
+        }
+        if (!idEnds.good() || bounds[1] < bounds[0]) return false;
+
+        id.resize(static_cast<size_t>(bounds[1] - bounds[0]));
+        ids.seekg(static_cast<streamoff>(bounds[0]));
+        ids.read(&id[0], static_cast<streamsize>(id.size()));
+        return ids.good();
+    }
+
+    //pass 2: k-way merge of the runs. records sharing a fingerprint arrive
+    //together in record order, a record whose id matches an earlier one of
+    //its group is a duplicate. dropped comes back sorted
+    bool findDuplicates(vector<uint64_t>& dropped)
+    {
+        dropped.clear();
+        if (runFiles.empty()) return true;
+
+        vector<SpillReader<IdKey>> readers(runFiles.size());
+        size_t perRun = max<size_t>(64, runCapacity() / runFiles.size());
+        typedef pair<IdKey, size_t> HeapEntry;
+        auto later = [](const HeapEntry& a, const HeapEntry& b) { return b.first < a.first; };
+        priority_queue<HeapEntry, vector<HeapEntry>, decltype(later)> heap(later);
+
+        for (size_t run = 0; run < runFiles.size(); run++)
+        {
+            IdKey key;
+            if (!readers[run].open(runFiles[run], 0, runSizes[run], perRun)) return false;
+            if (readers[run].next(key)) heap.push({ key, run });
+        }
+
+        ifstream ids(spillName("ids"), ios::binary);
+        ifstream idEnds(spillName("idends"), ios::binary);
+        vector<uint64_t> group;
+        vector<string> seen;
+        string id;
+
+        auto resolveGroup = [&]()
+            {
+                if (group.size() < 2) return true;
+                seen.clear();
+                for (uint64_t record : group)
+                {
+                    if (!readSpilledId(ids, idEnds, record, id)) return false;
+                    if (find(seen.begin(), seen.end(), id) != seen.end()) dropped.push_back(record);
+                    else seen.push_back(id);
+                }
+                return true;
+            };
+
+        uint64_t groupFingerprint = 0;
+        while (!heap.empty())
+        {
+            HeapEntry top = heap.top();
+            heap.pop();
+
+            if (!group.empty() && top.first.fingerprint != groupFingerprint)
+            {
+                if (!resolveGroup()) return false;
+                group.clear();
+            }
+            groupFingerprint = top.first.fingerprint;
+            group.push_back(top.first.record);
+
+            IdKey key;
+            if (readers[top.second].next(key)) heap.push({ key, top.second });
+        }
+        if (!resolveGroup()) return false;
+
+        sort(dropped.begin(), dropped.end());
+        return true;
+    }
+
+    //copy count bytes of a spill file into the snapshot
+    static bool copySpill(const string& filename, uint64_t count, const function<void(const void*, size_t)>& emit)
+    {
+        SpillReader<char> reader;
+        if (!reader.open(filename, 0, count, COPY_BUFFER)) return count == 0;
+
+        vector<char> buffer(COPY_BUFFER);
+        uint64_t copied = 0;
+        while (copied < count)
+        {
+            size_t n = reader.read(buffer.data(), buffer.size());
+            if (n == 0) return false;
+            emit(buffer.data(), n);
+            copied += n;
+        }
+        return true;
+    }
+
+    //passes 3-5: leaf level, upper levels and ids into the snapshot file
+    bool writeSnapshot(const string& outputFile, const vector<uint64_t>& dropped, int maxRecords)
+    {
+        ofstream out(outputFile, ios::binary | ios::trunc);
+        if (!out.is_open())
+        {
+            cout << "Could not open file " << outputFile << endl;
+            return false;
+        }
+
+        TreeSnapshot::Header header = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header)); //rewritten at the end
+
+        TreeSnapshot::Checksum checksum;
+        auto emit = [&](const void* data, size_t length)
+            {
+                out.write(static_cast<const char*>(data), static_cast<streamsize>(length));
+                checksum.add(data, length);
+            };
+
+        //leaves: skip dropped records, stop after maxRecords survivors
+        ofstream offsetSpill, arenaSpill;
+        if (!openSpill(offsetSpill, spillName("offsets")) || !openSpill(arenaSpill, spillName("arena"))) return false;
+
+        SpillReader<Digest> leaves;
+        SpillReader<uint64_t> ends;
+        SpillReader<char> ids;
+        if (!leaves.open(spillName("leaves"), 0, recordCount, bufferItems<Digest>()) ||
+            !ends.open(spillName("idends"), 0, recordCount, bufferItems<uint64_t>()) ||
+            !ids.open(spillName("ids"), 0, idSpillBytes, COPY_BUFFER))
+        {
+            cout << "Could not reopen spill files" << endl;
+            return false;
+        }
+
+        size_t chunk = chunkDigests();
+        uint64_t limit = maxRecords > 0 ? static_cast<uint64_t>(maxRecords) : UINT64_MAX;
+        size_t leafChunk = static_cast<size_t>(min<uint64_t>(chunk, max<uint64_t>(1, recordCount)));
+        vector<Digest> digests(leafChunk);
+        vector<Digest> kept;
+        vector<uint64_t> idEnds(leafChunk);
+        string idBytes;
+        uint64_t record = 0;
+        uint64_t previousEnd = 0;
+        uint64_t arenaBytes = 0;
+        size_t nextDropped = 0;
+
+        while (record < recordCount && leafCount < limit)
+        {
+            size_t n = leaves.read(digests.data(), static_cast<size_t>(min<uint64_t>(leafChunk, recordCount - record)));
+            if (n == 0 || ends.read(idEnds.data(), n) != n) return false;
+            idBytes.resize(static_cast<size_t>(idEnds[n - 1] - previousEnd));
+            if (ids.read(&idBytes[0], idBytes.size()) != idBytes.size()) return false;
+
+            kept.clear();
+            uint64_t start = previousEnd;
+            for (size_t i = 0; i < n && leafCount < limit; i++)
+            {
+                uint64_t length = idEnds[i] - start;
+                const char* id = idBytes.data() + (start - previousEnd);
+                start = idEnds[i];
+
+                if (nextDropped < dropped.size() && dropped[nextDropped] == record + i)
+                {
+                    nextDropped++;
+                    continue;
+                }
+
+                kept.push_back(digests[i]);
+                arenaSpill.write(id, static_cast<streamsize>(length));
+                arenaBytes += length;
+                offsetSpill.write(reinterpret_cast<const char*>(&arenaBytes), sizeof(arenaBytes));
+                leafCount++;
+            }
+            emit(kept.data(), kept.size() * sizeof(Digest));
+
+            previousEnd = idEnds[n - 1];
+            record += n;
+        }
+        duplicatesRemoved = nextDropped;
+        offsetSpill.close();
+        arenaSpill.close();
+
+        //upper levels: read the finished level back, append its parents
+        uint64_t levelOffset = sizeof(TreeSnapshot::Header);
+        vector<Digest> children;
+        vector<Digest> parents;
+        for (uint64_t size = leafCount; size > 1; size = (size + 1) / 2)
+        {
+            out.flush();
+            SpillReader<Digest> level;
+            if (!out.good() || !level.open(outputFile, levelOffset, size, bufferItems<Digest>())) return false;
+
+            for (uint64_t done = 0; done < size;)
+            {
+                //odd last child only ever ends the final chunk, so it pairs with itself
+                children.resize(static_cast<size_t>(min<uint64_t>(chunk, size - done)));
+                if (level.read(children.data(), children.size()) != children.size()) return false;
+
+                parents.resize((children.size() + 1) / 2);
+                parallelFor(parents.size(), threadCount, [&](size_t begin, size_t end)
+                    {
+                        SHA256Batch::combineLevel(children, begin, end, hashMode, &parents[begin]);
+                    }, 256);
+                emit(parents.data(), parents.size() * sizeof(Digest));
+                done += children.size();
+            }
+            levelOffset += size * sizeof(Digest);
+        }
+
+        //no index table; ids as leafCount + 1 offsets and the arena
+        uint64_t zero = 0;
+        emit(&zero, sizeof(zero));
+        if (!copySpill(spillName("offsets"), leafCount * sizeof(uint64_t), emit) ||
+            !copySpill(spillName("arena"), arenaBytes, emit))
+        {
+            return false;
+        }
+
+        memcpy(header.magic, TreeSnapshot::MAGIC, sizeof(header.magic));
+        header.version = TreeSnapshot::VERSION;
+        header.endianMarker = TreeSnapshot::ENDIAN_MARKER;
+        header.hashMode = static_cast<uint32_t>(hashMode);
+        header.indexSlotBits = 0;
+        header.leafCount = leafCount;
+        header.nodeCount = TreeSnapshot::countNodes(leafCount, header.levelCount);
+        header.idArenaBytes = arenaBytes;
+        header.checksum = checksum.finish();
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        return !out.fail();
+    }
+
+public:
+    ExternalTreeBuilder(size_t batch = 65536, unsigned threads = 0, HashMode mode = HashMode::HEX_COMPAT)
+        : batchSize(batch > 0 ? batch : 1), threadCount(threads), hashMode(mode),
+        memoryBudget(static_cast<size_t>(1) << 30), idSpillBytes(0),
+        recordCount(0), leafCount(0), duplicatesRemoved(0), spillBytes(0) {
+    }
+
+    //bytes for the duplicate check run buffer and the level chunk (the
+    //record batches come on top, see batchSize)
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+
+    //path prefix of the spill files, e.g. on a different disk. by default
+    //they sit next to the snapshot
+    void setSpillPrefix(const string& path) { spillPrefix = path; }
+
+    //build a snapshot of every record of inputFiles, in order, into
+    //outputFile. maxRecords keeps the first maxRecords unique records.
+    //false if an input cannot be read or a file cannot be written
+    bool build(const vector<string>& inputFiles, const string& outputFile, int maxRecords = 0)
+    {
+        prefix = spillPrefix.empty() ? outputFile : spillPrefix;
+        idSpillBytes = 0;
+        recordCount = 0;
+        leafCount = 0;
+        duplicatesRemoved = 0;
+        spillBytes = 0;
+
+        auto start = chrono::high_resolution_clock::now();
+
+        bool ok = spillInputs(inputFiles);
+        size_t runCount = runFiles.size();
+        auto spilled = chrono::high_resolution_clock::now();
+
+        vector<uint64_t> dropped;
+        if (ok && !findDuplicates(dropped))
+        {
+            cout << "Error reading duplicate check runs" << endl;
+            ok = false;
+        }
+        auto checked = chrono::high_resolution_clock::now();
+
+        if (ok && !writeSnapshot(outputFile, dropped, maxRecords))
+        {
+            cout << "Error writing snapshot " << outputFile << endl;
+            ok = false;
+        }
+        removeSpills();
+        if (!ok) return false;
+
+        auto end = chrono::high_resolution_clock::now();
+        auto ms = [](chrono::high_resolution_clock::time_point a, chrono::high_resolution_clock::time_point b)
+            {
+                return static_cast<long long>(chrono::duration_cast<chrono::milliseconds>(b - a).count());
+            };
+
+        if (duplicatesRemoved > 0)
+        {
+            cout << "Removed " << duplicatesRemoved << " duplicate reviews" << endl;
+        }
+        cout << "spill " << ms(start, spilled) << " ms, duplicate check " << ms(spilled, checked)
+            << " ms (" << runCount << " runs), levels " << ms(checked, end) << " ms" << endl;
+        cout << "wrote snapshot of " << leafCount << " leaves to " << outputFile
+            << " in " << ms(start, end) << " ms" << endl;
+        return true;
+    }
+
+    bool build(const string& inputFile, const string& outputFile, int maxRecords = 0)
+    {
+        return build(vector<string>{ inputFile }, outputFile, maxRecords);
+    }
+
+    uint64_t getLeafCount() const { return leafCount; }
+    uint64_t getRecordCount() const { return recordCount; }
+    uint64_t getDuplicatesRemoved() const { return duplicatesRemoved; }
+    uint64_t getSpillBytes() const { return spillBytes; }
+};
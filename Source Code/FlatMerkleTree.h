@@ -0,0 +1,950 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include "SHA256.h"
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "MappedFile.h"
+#include "TreeSnapshot.h"
+#include "LeafIndex.h"
+
+using namespace std;
+
+//one step of a binary proof: sibling digest and which side it sits on
+struct ProofStep
+{
+    Digest sibling;
+    bool siblingOnRight;
+};
+
+//one change for FlatMerkleTree::applyBatch. reviewData is the string that
+//gets hashed (Review::convertToString) and is ignored for REMOVE
+struct TreeUpdate
+{
+    enum Type
+    {
+        INSERT,
+        UPDATE,
+        REMOVE
+    };
+
+    Type type;
+    string reviewId;
+    string reviewData;
+};
+
+//what a batch did. hashesComputed counts leaf and internal node hashes
+struct BatchResult
+{
+    int inserted = 0;
+    int updated = 0;
+    int removed = 0;
+    int rejected = 0;
+    size_t hashesComputed = 0;
+};
+
+// ========================
+// flat merkle tree
+// ========================
+// array backed alternative to MerkleTree. every level is one contiguous vector
+// of 32-byte digests (levels[0] = leaves, levels.back() = root) and the tree
+// shape is implicit: parent of node i is i / 2, its sibling is i ^ 1. an odd
+// last node is paired with itself, exactly like MerkleTree duplicates it, and
+// in HEX_COMPAT mode parents hash the hex form of the children so roots and
+// proofs are identical to the ones MerkleTree produces for the same input.
+// RAW_DIGEST mode keeps everything binary and only converts to hex at the
+// display/storage boundary (getRootHash, generateProof).
+// a tree can be saved to a snapshot file and reopened with loadSnapshot, which
+// maps the file and reads the digests in place until the tree is modified.
+class FlatMerkleTree
+{
+private:
+    vector<vector<Digest>> levels;
+    LeafIndex leafIndex;
+    HashMode hashMode;
+    unsigned threadCount;
+    SHA256Batch::Kernel hashKernel;
+    SHA256 hasher;
+
+    //levels served straight from a mapped snapshot until the tree is modified
+    shared_ptr<MappedFile> snapshotFile;
+    vector<const Digest*> mappedLevels;
+    vector<size_t> mappedSizes;
+
+    //leaves touched by in place changes (addReview, applyBatch), tagged with
+    //the version that changed them, so caches can drop only what moved.
+    //rebuilds and clears start over and are not journalled
+    uint64_t version = 0;
+    uint64_t journalStart = 0;
+    vector<pair<uint64_t, size_t>> changeJournal;
+    static const size_t JOURNAL_LIMIT = 1 << 16;
+
+    size_t levelCount() const { return snapshotFile ? mappedLevels.size() : levels.size(); }
+    const Digest* levelData(size_t level) const { return snapshotFile ? mappedLevels[level] : levels[level].data(); }
+    size_t levelSize(size_t level) const { return snapshotFile ? mappedSizes[level] : levels[level].size(); }
+
+    void dropSnapshot()
+    {
+        snapshotFile.reset();
+        mappedLevels.clear();
+        mappedSizes.clear();
+    }
+
+    //copy mapped levels into owned storage before the tree changes
+    void detachSnapshot()
+    {
+        if (!snapshotFile) return;
+
+        levels.assign(mappedLevels.size(), vector<Digest>());
+        for (size_t level = 0; level < mappedLevels.size(); level++)
+        {
+            levels[level].assign(mappedLevels[level], mappedLevels[level] + mappedSizes[level]);
+        }
+        dropSnapshot();
+    }
+
+    //feed the snapshot body (everything after the header) to sink in order
+    void writeSnapshotBody(const vector<uint64_t>& idOffsets, const function<void(const void*, size_t)>& sink) const
+    {
+        for (size_t level = 0; level < levelCount(); level++)
+        {
+            sink(levelData(level), levelSize(level) * sizeof(Digest));
+        }
+        sink(leafIndex.slotData(), leafIndex.slotCount() * sizeof(uint64_t));
+        sink(idOffsets.data(), idOffsets.size() * sizeof(uint64_t));
+        for (size_t leaf = 0; leaf < leafIndex.size(); leaf++)
+        {
+            string_view id = leafIndex.idAt(leaf);
+            sink(id.data(), id.size());
+        }
+    }
+
+    //check a mapped snapshot, returns an error message or nullptr if usable
+    static const char* checkSnapshot(const MappedFile& file, TreeSnapshot::Header& header)
+    {
+        using namespace TreeSnapshot;
+
+        if (file.size() < sizeof(Header)) return "file too small";
+        memcpy(&header, file.data(), sizeof(Header));
+
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return "not a tree snapshot";
+        if (header.endianMarker != ENDIAN_MARKER) return "written with a different byte order";
+        if (header.version < 1 || header.version > VERSION) return "unsupported snapshot version";
+        if (header.indexSlotBits >= 48 || (header.version == 1 && header.indexSlotBits != 0)) return "bad index table size";
+        if (header.hashMode > static_cast<uint32_t>(HashMode::RAW_DIGEST)) return "unknown hash mode";
+
+        uint64_t bodySize = file.size() - sizeof(Header);
+        if (header.leafCount > bodySize / sizeof(Digest)) return "truncated file";
+
+        uint64_t levelCount;
+        uint64_t nodeCount = countNodes(header.leafCount, levelCount);
+        if (nodeCount != header.nodeCount || levelCount != header.levelCount) return "inconsistent level sizes";
+
+        uint64_t slotCount = header.indexSlotBits > 0 ? (1ULL << header.indexSlotBits) : 0;
+        if (slotCount > bodySize / sizeof(uint64_t)) return "truncated file";
+        uint64_t fixedSize = nodeCount * sizeof(Digest) + (slotCount + header.leafCount + 1) * sizeof(uint64_t);
+        if (fixedSize > bodySize || bodySize - fixedSize != header.idArenaBytes) return "file size does not match header";
+
+        Checksum checksum;
+        checksum.add(file.data() + sizeof(Header), bodySize);
+        if (checksum.finish() != header.checksum) return "checksum mismatch";
+
+        return nullptr;
+    }
+
+    //build every level above the leaves, each level split across threads.
+    //a parent only reads its own two children so chunks never overlap and
+    //the result is identical to the sequential build.
+    void buildLevels()
+    {
+        levels.resize(1);
+
+        while (levels.back().size() > 1)
+        {
+            const vector<Digest>& current = levels.back();
+            vector<Digest> next((current.size() + 1) / 2);
+
+            parallelFor(next.size(), threadCount, [&](size_t begin, size_t end)
+                {
+                    SHA256Batch::combineLevel(current, begin, end, hashMode, &next[begin], hashKernel);
+                });
+
+            levels.push_back(move(next));
+        }
+    }
+
+    //hash reviewData into levels[0] across threads
+    void hashLeaves(const vector<string>& reviewData)
+    {
+        levels.assign(1, vector<Digest>(reviewData.size()));
+
+        parallelFor(reviewData.size(), threadCount, [&](size_t begin, size_t end)
+            {
+                SHA256Batch::hashStrings(reviewData, begin, end, &levels[0][begin], hashKernel);
+            }, 256);
+    }
+
+    //give the next leaf an id, renaming duplicates the same way MerkleTree
+    //does. returns true if the id had to be renamed
+    bool indexLeafId(const string& reviewId)
+    {
+        if (leafIndex.append(reviewId)) return false;
+
+        int suffix = 1;
+        while (!leafIndex.append(reviewId + "_dup" + to_string(suffix++)))
+        {
+        }
+        return true;
+    }
+
+    //map ids to leaf positions
+    int indexLeafIds(const vector<string>& reviewIds)
+    {
+        size_t idBytes = 0;
+        for (const auto& id : reviewIds) idBytes += id.size();
+
+        leafIndex.clear();
+        leafIndex.reserve(reviewIds.size(), idBytes);
+        int duplicateCount = 0;
+
+        for (const auto& id : reviewIds)
+        {
+            if (indexLeafId(id)) duplicateCount++;
+        }
+
+        return duplicateCount;
+    }
+
+    void journalLeaf(size_t leaf) { changeJournal.push_back({ version, leaf }); }
+
+    //forget the journal, readers of older versions must start over
+    void resetJournal()
+    {
+        journalStart = ++version;
+        changeJournal.clear();
+    }
+
+    //drop the older half of an oversized journal, whole versions at a time
+    void trimJournal()
+    {
+        if (changeJournal.size() <= JOURNAL_LIMIT) return;
+
+        size_t cut = changeJournal.size() / 2;
+        while (cut < changeJournal.size() && changeJournal[cut].first == changeJournal[cut - 1].first) cut++;
+        journalStart = changeJournal[cut - 1].first;
+        changeJournal.erase(changeJournal.begin(), changeJournal.begin() + cut);
+    }
+
+    //recompute the parents of one leaf up to the root
+    void updatePath(size_t index)
+    {
+        for (size_t level = 0; level + 1 < levels.size(); level++)
+        {
+            const vector<Digest>& current = levels[level];
+            size_t left = index & ~static_cast<size_t>(1);
+            size_t right = (left + 1 < current.size()) ? left + 1 : left;
+            index /= 2;
+            combineDigests(hasher, current[left], current[right], hashMode, levels[level + 1][index]);
+        }
+    }
+
+public:
+    FlatMerkleTree(HashMode mode = HashMode::HEX_COMPAT)
+        : hashMode(mode), threadCount(1), hashKernel(SHA256Batch::Kernel::AUTO) {
+    }
+
+    //threads used by buildTreeFromReviews, 0 = one per core
+    void setThreadCount(unsigned threads) { threadCount = threads; }
+    unsigned getThreadCount() const { return threadCount; }
+
+    //force a batch hashing kernel (benchmarks), AUTO picks the best one
+    void setHashKernel(SHA256Batch::Kernel kernel) { hashKernel = kernel; }
+
+    // build from review data and ids
+    void buildTreeFromReviews(const vector<string>& reviewData,
+        const vector<string>& reviewIds)
+    {
+        if (reviewData.size() != reviewIds.size())
+        {
+            throw invalid_argument("review data and id arrays must match in size");
+        }
+
+        clear();
+
+        if (reviewData.empty()) return;
+
+        cout << "building flat merkle tree with " << reviewData.size() << " reviews ("
+            << resolveThreadCount(threadCount) << " threads)..." << endl;
+        auto start = chrono::high_resolution_clock::now();
+
+        //the id index is single threaded, overlap it with leaf hashing
+        int duplicateCount = 0;
+        if (resolveThreadCount(threadCount) > 1)
+        {
+            thread indexer([&]() { duplicateCount = indexLeafIds(reviewIds); });
+            hashLeaves(reviewData);
+            indexer.join();
+        }
+        else
+        {
+            hashLeaves(reviewData);
+            duplicateCount = indexLeafIds(reviewIds);
+        }
+
+        if (duplicateCount > 0)
+        {
+            cout << "duplicate reviews found: " << duplicateCount << endl;
+        }
+
+        buildLevels();
+
+        auto end = chrono::high_resolution_clock::now();
+        auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        cout << "flat merkle tree built in " << totalTime.count() << " ms" << endl;
+        cout << "root hash: " << getRootHash() << endl;
+    }
+
+    // ========================
+    // streaming construction
+    // ========================
+    // leaves can be appended in batches of precomputed digests so the review
+    // text never has to be resident all at once. upper levels are only valid
+    // again after finishLeaves()
+
+    //append already hashed leaves and their ids
+    void appendLeaves(const vector<Digest>& digests, const vector<string>& reviewIds)
+    {
+        if (digests.size() != reviewIds.size())
+        {
+            throw invalid_argument("digest and id arrays must match in size");
+        }
+
+        detachSnapshot();
+        resetJournal();
+        levels.resize(1);
+        levels[0].insert(levels[0].end(), digests.begin(), digests.end());
+
+        for (const auto& id : reviewIds)
+        {
+            indexLeafId(id);
+        }
+    }
+
+    //build the levels above the appended leaves
+    void finishLeaves()
+    {
+        detachSnapshot();
+        resetJournal();
+        if (levels.empty() || levels[0].empty())
+        {
+            levels.clear();
+            return;
+        }
+
+        buildLevels();
+        cout << "flat merkle tree finished with " << levels[0].size() << " streamed leaves" << endl;
+        cout << "root hash: " << getRootHash() << endl;
+    }
+
+    //drop all leaves, levels and ids
+    void clear()
+    {
+        dropSnapshot();
+        levels.clear();
+        leafIndex.clear();
+        resetJournal();
+    }
+
+    // get root hash
+    string getRootHash() const
+    {
+        return levelCount() == 0 ? "" : digestToHex(levelData(levelCount() - 1)[0]);
+    }
+
+    // get root as raw digest (zeroes if empty)
+    Digest getRootDigest() const
+    {
+        return levelCount() == 0 ? Digest{} : levelData(levelCount() - 1)[0];
+    }
+
+    HashMode getHashMode() const { return hashMode; }
+
+    // generate membership proof as raw sibling digests, leaf to root
+    vector<ProofStep> generateDigestProof(const string& reviewId) const
+    {
+        vector<ProofStep> proof;
+
+        size_t index;
+        if (!leafIndex.find(reviewId, index))
+            return proof;
+
+        proof.reserve(levelCount());
+
+        for (size_t level = 0; level + 1 < levelCount(); level++)
+        {
+            const Digest* current = levelData(level);
+            ProofStep step;
+            step.siblingOnRight = (index % 2 == 0);
+            size_t sibling = step.siblingOnRight ? index + 1 : index - 1;
+            step.sibling = current[sibling < levelSize(level) ? sibling : index];
+            proof.push_back(step);
+            index /= 2;
+        }
+
+        return proof;
+    }
+
+    // verify a raw digest proof against a raw root
+    static bool verifyDigestProof(const string& reviewData,
+        const vector<ProofStep>& proof,
+        const Digest& rootDigest,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (proof.empty()) return false;
+
+        SHA256 hasher;
+        Digest current;
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), current);
+
+        for (const ProofStep& step : proof)
+        {
+            combineDigests(hasher, current, step.sibling, mode, current);
+        }
+
+        return current == rootDigest;
+    }
+
+    // generate membership proof in the same format as MerkleTree::generateProof
+    vector<string> generateProof(const string& reviewId) const
+    {
+        vector<string> proof;
+
+        size_t index;
+        if (!leafIndex.find(reviewId, index))
+            return proof;
+
+        proof.reserve(2 * levelCount());
+
+        for (size_t level = 0; level + 1 < levelCount(); level++)
+        {
+            const Digest* current = levelData(level);
+
+            if (index % 2 == 0)
+            {
+                size_t sibling = (index + 1 < levelSize(level)) ? index + 1 : index;
+                proof.push_back(digestToHex(current[sibling]));
+                proof.push_back("r");
+            }
+            else
+            {
+                proof.push_back(digestToHex(current[index - 1]));
+                proof.push_back("l");
+            }
+
+            index /= 2;
+        }
+
+        return proof;
+    }
+
+    // verify many digest proofs against one root. leaves are hashed together
+    // and then every proof advances one level per round, so each round is a
+    // single batch of equally sized combine inputs
+    static vector<bool> verifyDigestProofs(const vector<string>& reviewData,
+        const vector<vector<ProofStep>>& proofs,
+        const Digest& rootDigest,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (reviewData.size() != proofs.size())
+        {
+            throw invalid_argument("review data and proof arrays must match in size");
+        }
+
+        vector<Digest> current(reviewData.size());
+        SHA256Batch::hashStrings(reviewData, 0, reviewData.size(), current.data());
+
+        size_t maxDepth = 0;
+        for (const auto& proof : proofs) maxDepth = max(maxDepth, proof.size());
+
+        vector<uint8_t> buffers;
+        vector<const uint8_t*> messages;
+        vector<size_t> lengths, owners;
+        vector<Digest> parents;
+        size_t messageSize = (mode == HashMode::RAW_DIGEST) ? 64 : 128;
+
+        for (size_t depth = 0; depth < maxDepth; depth++)
+        {
+            owners.clear();
+            for (size_t i = 0; i < proofs.size(); i++)
+            {
+                if (depth < proofs[i].size()) owners.push_back(i);
+            }
+
+            buffers.resize(owners.size() * 128);
+            messages.resize(owners.size());
+            lengths.assign(owners.size(), messageSize);
+            parents.resize(owners.size());
+
+            for (size_t j = 0; j < owners.size(); j++)
+            {
+                uint8_t* buffer = &buffers[j * 128];
+                SHA256Batch::writePair(current[owners[j]], proofs[owners[j]][depth].sibling, mode, buffer);
+                messages[j] = buffer;
+            }
+
+            SHA256Batch::hashMessages(messages.data(), lengths.data(), parents.data(), owners.size());
+
+            for (size_t j = 0; j < owners.size(); j++)
+            {
+                current[owners[j]] = parents[j];
+            }
+        }
+
+        vector<bool> results(proofs.size());
+        for (size_t i = 0; i < proofs.size(); i++)
+        {
+            results[i] = !proofs[i].empty() && current[i] == rootDigest;
+        }
+        return results;
+    }
+
+    // verify inclusion proof, accepts MerkleTree proofs as well
+    static bool verifyProof(const string& reviewData,
+        const vector<string>& proof,
+        const string& rootHash,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (proof.empty()) return false;
+
+        SHA256 hasher;
+        Digest current, sibling;
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), current);
+
+        for (size_t i = 0; i + 1 < proof.size(); i += 2)
+        {
+            //pairs are combined in sorted order so the direction is implied
+            if (!digestFromHex(proof[i], sibling)) return false;
+            combineDigests(hasher, current, sibling, mode, current);
+        }
+
+        return digestToHex(current) == rootHash;
+    }
+
+    // check if review id exists
+    bool contains(const string& reviewId) const
+    {
+        return leafIndex.contains(reviewId);
+    }
+
+    // count leaves
+    size_t getLeafCount() const
+    {
+        return levelCount() == 0 ? 0 : levelSize(0);
+    }
+
+    // number of levels including leaves and root
+    size_t getHeight() const
+    {
+        return levelCount();
+    }
+
+    //read-only node access by level (0 = leaves) and position, for tools
+    //that walk two trees side by side
+    size_t getLevelSize(size_t level) const { return level < levelCount() ? levelSize(level) : 0; }
+    const Digest& getNode(size_t level, size_t index) const { return levelData(level)[index]; }
+
+    //review id of a leaf and leaf position of a review id
+    string_view getLeafId(size_t leaf) const { return leafIndex.idAt(leaf); }
+    bool findLeaf(const string& reviewId, size_t& leaf) const { return leafIndex.find(reviewId, leaf); }
+
+    //add a single review by appending a leaf, only its path is rehashed
+    void addReview(const string& reviewData, const string& reviewId)
+    {
+        if (leafIndex.contains(reviewId))
+        {
+            throw invalid_argument("Review ID already exists: " + reviewId);
+        }
+
+        detachSnapshot();
+        if (levels.empty()) levels.emplace_back();
+
+        size_t index = levels[0].size();
+        levels[0].emplace_back();
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), levels[0][index]);
+        leafIndex.append(reviewId);
+
+        //grow each level by one node where the new leaf needs a new parent
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            size_t needed = (levels[level].size() + 1) / 2;
+            if (levels[level].size() == 1) break;
+            if (level + 1 == levels.size()) levels.emplace_back();
+            if (levels[level + 1].size() < needed) levels[level + 1].resize(needed);
+        }
+
+        updatePath(index);
+
+        version++;
+        journalLeaf(index);
+        trimJournal();
+    }
+
+    //bumped by every change to the tree
+    uint64_t getVersion() const { return version; }
+
+    //leaves touched by changes made after version sinceVersion. false if the
+    //tree was rebuilt or cleared since then, or the journal no longer reaches
+    //back that far; the caller has to assume every leaf changed
+    bool getChangedLeaves(uint64_t sinceVersion, vector<size_t>& leaves) const
+    {
+        leaves.clear();
+        if (sinceVersion < journalStart) return false;
+
+        auto it = upper_bound(changeJournal.begin(), changeJournal.end(), sinceVersion,
+            [](uint64_t value, const pair<uint64_t, size_t>& change) { return value < change.first; });
+        for (; it != changeJournal.end(); ++it) leaves.push_back(it->second);
+        return true;
+    }
+
+    // ========================
+    // snapshots
+    // ========================
+
+    //write all levels and the id -> leaf mapping to filename
+    bool saveSnapshot(const string& filename) const
+    {
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file.is_open())
+        {
+            cout << "Could not open file " << filename << endl;
+            return false;
+        }
+
+        //ids in leaf order, every leaf has exactly one (possibly renamed) id
+        size_t leafCount = getLeafCount();
+        vector<uint64_t> idOffsets(leafCount + 1, 0);
+        for (size_t i = 0; i < leafCount; i++)
+        {
+            idOffsets[i + 1] = idOffsets[i] + leafIndex.idAt(i).size();
+        }
+
+        int slotBits = 0;
+        while ((static_cast<size_t>(1) << slotBits) < leafIndex.slotCount()) slotBits++;
+
+        TreeSnapshot::Header header = {};
+        memcpy(header.magic, TreeSnapshot::MAGIC, sizeof(header.magic));
+        header.version = TreeSnapshot::VERSION;
+        header.endianMarker = TreeSnapshot::ENDIAN_MARKER;
+        header.hashMode = static_cast<uint32_t>(hashMode);
+        header.indexSlotBits = static_cast<uint32_t>(slotBits);
+        header.leafCount = leafCount;
+        header.nodeCount = TreeSnapshot::countNodes(leafCount, header.levelCount);
+        header.idArenaBytes = idOffsets.back();
+
+        TreeSnapshot::Checksum checksum;
+        writeSnapshotBody(idOffsets, [&](const void* data, size_t length) { checksum.add(data, length); });
+        header.checksum = checksum.finish();
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeSnapshotBody(idOffsets, [&](const void* data, size_t length) {
+            file.write(static_cast<const char*>(data), static_cast<streamsize>(length));
+            });
+
+        if (!file.good())
+        {
+            cout << "Error writing snapshot " << filename << endl;
+            return false;
+        }
+
+        cout << "saved snapshot of " << leafCount << " leaves to " << filename << endl;
+        return true;
+    }
+
+    //reopen a snapshot written by saveSnapshot. the digests are used in place
+    //from the mapping, nothing is rehashed. false if the file is missing,
+    //corrupt or from an incompatible version
+    bool loadSnapshot(const string& filename)
+    {
+        auto start = chrono::high_resolution_clock::now();
+
+        auto file = make_shared<MappedFile>();
+        if (!file->open(filename))
+        {
+            cout << "Could not open file " << filename << endl;
+            return false;
+        }
+
+        TreeSnapshot::Header header;
+        const char* error = checkSnapshot(*file, header);
+        if (error != nullptr)
+        {
+            cout << "Invalid snapshot " << filename << ": " << error << endl;
+            return false;
+        }
+
+        const char* cursor = file->data() + sizeof(header);
+        const char* slotData = cursor + header.nodeCount * sizeof(Digest);
+        size_t slotCount = header.indexSlotBits > 0 ? (static_cast<size_t>(1) << header.indexSlotBits) : 0;
+        const char* idOffsetData = slotData + slotCount * sizeof(uint64_t);
+        const char* idArena = idOffsetData + (header.leafCount + 1) * sizeof(uint64_t);
+
+        //offsets are read before anything changes so a bad file leaves the tree alone
+        vector<uint64_t> idOffsets(header.leafCount + 1);
+        memcpy(idOffsets.data(), idOffsetData, idOffsets.size() * sizeof(uint64_t));
+        for (size_t i = 0; i < header.leafCount; i++)
+        {
+            if (idOffsets[i] > idOffsets[i + 1])
+            {
+                cout << "Invalid snapshot " << filename << ": bad id offsets" << endl;
+                return false;
+            }
+        }
+        if (idOffsets[0] != 0 || idOffsets.back() != header.idArenaBytes)
+        {
+            cout << "Invalid snapshot " << filename << ": bad id offsets" << endl;
+            return false;
+        }
+
+        clear();
+        hashMode = static_cast<HashMode>(header.hashMode);
+
+        for (uint64_t size = header.leafCount; mappedLevels.size() < header.levelCount; size = (size + 1) / 2)
+        {
+            mappedLevels.push_back(reinterpret_cast<const Digest*>(cursor));
+            mappedSizes.push_back(static_cast<size_t>(size));
+            cursor += size * sizeof(Digest);
+        }
+        snapshotFile = file;
+
+        //version 1 files have no index table, it is rebuilt from the ids
+        vector<uint64_t> slotTable(slotCount);
+        memcpy(slotTable.data(), slotData, slotCount * sizeof(uint64_t));
+        if (!leafIndex.assign(idOffsets.data(), idArena, header.leafCount, slotTable.empty() ? nullptr : slotTable.data(), slotCount))
+        {
+            clear();
+            cout << "Invalid snapshot " << filename << ": bad ids" << endl;
+            return false;
+        }
+
+        auto end = chrono::high_resolution_clock::now();
+        auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
+        cout << "loaded snapshot of " << header.leafCount << " leaves in " << totalTime.count() << " ms" << endl;
+        return true;
+    }
+
+    //true while digests are read from a mapped snapshot
+    bool isSnapshotMapped() const { return snapshotFile != nullptr; }
+
+    //apply a batch of inserts, updates and removals in order. new leaf data is
+    //hashed in one multi-lane batch, then every internal node above a touched
+    //leaf is recomputed exactly once, level by level, so k changes cost about
+    //k * log(n) hashes. inserts append leaves; a removal moves the last leaf
+    //into the freed position (leaf positions of other reviews never change
+    //otherwise). inserts of existing ids and updates/removals of unknown ids
+    //are rejected and counted, the rest of the batch still applies
+    BatchResult applyBatch(const vector<TreeUpdate>& updates)
+    {
+        BatchResult result;
+        detachSnapshot();
+        if (levels.empty()) levels.emplace_back();
+        version++;
+
+        //hash every new leaf up front, across threads
+        vector<const uint8_t*> messages;
+        vector<size_t> lengths;
+        for (const TreeUpdate& update : updates)
+        {
+            if (update.type == TreeUpdate::REMOVE) continue;
+            messages.push_back(reinterpret_cast<const uint8_t*>(update.reviewData.data()));
+            lengths.push_back(update.reviewData.size());
+        }
+
+        vector<Digest> leafDigests(messages.size());
+        parallelFor(messages.size(), threadCount, [&](size_t begin, size_t end)
+            {
+                SHA256Batch::hashMessages(&messages[begin], &lengths[begin], &leafDigests[begin], end - begin, hashKernel);
+            }, 256);
+        result.hashesComputed = messages.size();
+
+        //apply leaf changes in order, remembering which leaves changed
+        vector<Digest>& leaves = levels[0];
+        size_t oldLeafCount = leaves.size();
+        vector<size_t> dirty;
+        size_t nextDigest = 0;
+
+        for (const TreeUpdate& update : updates)
+        {
+            size_t leaf;
+            switch (update.type)
+            {
+            case TreeUpdate::INSERT:
+            {
+                const Digest& digest = leafDigests[nextDigest++];
+                if (!leafIndex.append(update.reviewId))
+                {
+                    result.rejected++;
+                    break;
+                }
+                dirty.push_back(leaves.size());
+                leaves.push_back(digest);
+                result.inserted++;
+                break;
+            }
+            case TreeUpdate::UPDATE:
+            {
+                const Digest& digest = leafDigests[nextDigest++];
+                if (!leafIndex.find(update.reviewId, leaf))
+                {
+                    result.rejected++;
+                    break;
+                }
+                leaves[leaf] = digest;
+                dirty.push_back(leaf);
+                result.updated++;
+                break;
+            }
+            case TreeUpdate::REMOVE:
+            {
+                if (!leafIndex.find(update.reviewId, leaf))
+                {
+                    result.rejected++;
+                    break;
+                }
+                size_t last = leaves.size() - 1;
+                leaves[leaf] = leaves[last];
+                leaves.pop_back();
+                leafIndex.eraseLeaf(leaf);
+                if (leaf != last) dirty.push_back(leaf);
+                journalLeaf(last); //the review that sat there moved
+                result.removed++;
+                break;
+            }
+            }
+        }
+
+        size_t leafCount = leaves.size();
+        if (leafCount == 0)
+        {
+            levels.clear();
+            resetJournal();
+            return result;
+        }
+
+        //resize every level for the new leaf count
+        size_t height = 1;
+        for (size_t size = leafCount; size > 1; size = (size + 1) / 2) height++;
+        levels.resize(height);
+        for (size_t level = 1; level < height; level++)
+        {
+            levels[level].resize((levels[level - 1].size() + 1) / 2);
+        }
+
+        sort(dirty.begin(), dirty.end());
+        dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+        dirty.erase(lower_bound(dirty.begin(), dirty.end(), leafCount), dirty.end());
+
+        //when the count changed the last node of each level may have gained or
+        //lost its sibling. marking the last leaf reaches all of them
+        if (leafCount != oldLeafCount && (dirty.empty() || dirty.back() != leafCount - 1))
+        {
+            dirty.push_back(leafCount - 1);
+        }
+        for (size_t leaf : dirty) journalLeaf(leaf);
+        trimJournal();
+
+        //recompute the dirty parents of each level in one batch
+        size_t messageSize = (hashMode == HashMode::RAW_DIGEST) ? 64 : 128;
+        vector<uint8_t> buffers;
+        vector<Digest> parents;
+        vector<size_t> parentDirty;
+
+        for (size_t level = 0; level + 1 < height; level++)
+        {
+            const vector<Digest>& current = levels[level];
+
+            parentDirty.clear();
+            for (size_t index : dirty)
+            {
+                if (parentDirty.empty() || parentDirty.back() != index / 2) parentDirty.push_back(index / 2);
+            }
+
+            size_t count = parentDirty.size();
+            buffers.resize(count * 128);
+            messages.resize(count);
+            lengths.assign(count, messageSize);
+            parents.resize(count);
+
+            for (size_t j = 0; j < count; j++)
+            {
+                size_t left = 2 * parentDirty[j];
+                size_t right = (left + 1 < current.size()) ? left + 1 : left;
+                SHA256Batch::writePair(current[left], current[right], hashMode, &buffers[j * 128]);
+                messages[j] = &buffers[j * 128];
+            }
+
+            parallelFor(count, threadCount, [&](size_t begin, size_t end)
+                {
+                    SHA256Batch::hashMessages(&messages[begin], &lengths[begin], &parents[begin], end - begin, hashKernel);
+                }, 256);
+
+            for (size_t j = 0; j < count; j++)
+            {
+                levels[level + 1][parentDirty[j]] = parents[j];
+            }
+
+            result.hashesComputed += count;
+            dirty.swap(parentDirty);
+        }
+
+        return result;
+    }
+
+    //approximate bytes held by digests and the id index
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = 0;
+        for (const auto& level : levels)
+        {
+            bytes += level.capacity() * sizeof(Digest);
+        }
+        for (size_t size : mappedSizes)
+        {
+            bytes += size * sizeof(Digest);
+        }
+        return bytes + leafIndex.getMemoryUsage();
+    }
+
+    // print tree structure, root first
+    void printTree(int maxLevels = 3) const
+    {
+        if (levelCount() == 0)
+        {
+            cout << "tree is empty" << endl;
+            return;
+        }
+
+        int printed = 0;
+        for (size_t level = levelCount(); level-- > 0 && printed < maxLevels; printed++)
+        {
+            cout << "level " << printed << " (" << levelSize(level) << " nodes): ";
+            for (size_t i = 0; i < levelSize(level) && i < 16; i++)
+            {
+                cout << digestToHex(levelData(level)[i]).substr(0, 8) << "... ";
+            }
+            if (levelSize(level) > 16) cout << "...";
+            cout << endl;
+        }
+
+        if (printed < static_cast<int>(levelCount()))
+            cout << "... (additional levels not shown)" << endl;
+    }
+};
@@ -3,6 +3,11 @@
 #include <string>
 #include <fstream>
 #include <unordered_map>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+#include "MerkleMountainRange.h"
 
 using namespace std;
 
@@ -10,13 +15,22 @@ class IntegrityVerifier
 {
 private:
     unordered_map<string, string> storedRoots;
+    unordered_map<string, vector<pair<time_t, string>>> rootHistory;   //per dataset, oldest first
+    unordered_map<string, size_t> storedSizes;                         //leaf count of stored log roots
     string currentRoot;
     string currentDataset;
 
+    void recordHistory(const string& datasetName, const string& rootHash, time_t storedAt)
+    {
+        vector<pair<time_t, string>>& history = rootHistory[datasetName];
+        if (!history.empty()) storedAt = max(storedAt, history.back().first);
+        history.push_back({ storedAt, rootHash });
+    }
+
 public:
     IntegrityVerifier() : currentRoot(""), currentDataset("") {}
 
-    bool storeRootHash(const string& datasetName, const string& rootHash)
+    bool storeRootHash(const string& datasetName, const string& rootHash, time_t storedAt = time(nullptr))
     {
         if (datasetName.empty() || rootHash.empty())
         {
@@ -25,6 +39,8 @@ public:
         }
 
         storedRoots[datasetName] = rootHash;
+        storedSizes.erase(datasetName);
+        recordHistory(datasetName, rootHash, storedAt);
         currentRoot = rootHash;
         currentDataset = datasetName;
 
@@ -33,6 +49,23 @@ public:
         return true;
     }
 
+    // store the root of an append-only log together with the leaf count it
+    // was published at, the base the next detectAppendOnlyUpdate checks against
+    bool storeLogRoot(const string& datasetName, const string& rootHash, size_t treeSize,
+        time_t storedAt = time(nullptr))
+    {
+        if (!storeRootHash(datasetName, rootHash, storedAt)) return false;
+        storedSizes[datasetName] = treeSize;
+        return true;
+    }
+
+    // leaf count stored with a log root, 0 if none
+    size_t getStoredSize(const string& datasetName) const
+    {
+        auto it = storedSizes.find(datasetName);
+        return it == storedSizes.end() ? 0 : it->second;
+    }
+
     bool saveRootToFile(const string& filename, const string& datasetName, const string& rootHash)
     {
         ofstream file(filename, ios::app);
@@ -58,6 +91,8 @@ public:
         }
 
         storedRoots.clear();
+        rootHistory.clear();
+        storedSizes.clear();
         string line;
         int count = 0;
 
@@ -71,6 +106,7 @@ public:
                 string name = line.substr(0, pos1);
                 string hash = line.substr(pos1 + 1, pos2 - pos1 - 1);
                 storedRoots[name] = hash;
+                recordHistory(name, hash, static_cast<time_t>(atoll(line.c_str() + pos2 + 1)));
                 count++;
             }
         }
@@ -135,6 +171,62 @@ public:
         }
     }
 
+    // check that a new log root is an append-only extension of the stored one
+    // using a consistency proof, without the dataset. sizes are the leaf counts
+    // the two roots were published at
+    string detectAppendOnlyUpdate(const string& datasetName, size_t oldSize, size_t newSize,
+        const string& newRoot, const vector<Digest>& consistencyProof)
+    {
+        auto it = storedRoots.find(datasetName);
+        if (it == storedRoots.end())
+        {
+            return "UNKNOWN: No previous version found for dataset: " + datasetName;
+        }
+
+        Digest oldDigest, newDigest;
+        if (!digestFromHex(it->second, oldDigest) || !digestFromHex(newRoot, newDigest))
+        {
+            return "ERROR: Root hashes must be 64 hex characters";
+        }
+
+        if (!MerkleMountainRange::verifyConsistency(oldSize, newSize, oldDigest, newDigest, consistencyProof))
+        {
+            return "NOT_APPEND_ONLY: New root is not an extension of the stored root";
+        }
+
+        if (oldSize == newSize)
+        {
+            return "NO_UPDATES: Dataset unchanged since last verification";
+        }
+        return "APPEND_ONLY_VERIFIED: " + to_string(newSize - oldSize) + " reviews appended, earlier reviews unchanged";
+    }
+
+    // same, from the size stored with the root by storeLogRoot
+    string detectAppendOnlyUpdate(const string& datasetName, size_t newSize,
+        const string& newRoot, const vector<Digest>& consistencyProof)
+    {
+        auto it = storedSizes.find(datasetName);
+        if (it == storedSizes.end())
+        {
+            return "UNKNOWN: No stored log size for dataset: " + datasetName;
+        }
+        return detectAppendOnlyUpdate(datasetName, it->second, newSize, newRoot, consistencyProof);
+    }
+
+    // root that was stored for a dataset at time at (the latest one stored at
+    // or before it), empty if none. pairs with VersionedMerkleTree proofs for
+    // "was this review in the dataset as of date X"
+    string getRootAsOf(const string& datasetName, time_t at) const
+    {
+        auto it = rootHistory.find(datasetName);
+        if (it == rootHistory.end()) return "";
+
+        const vector<pair<time_t, string>>& history = it->second;
+        auto next = upper_bound(history.begin(), history.end(), at,
+            [](time_t value, const pair<time_t, string>& entry) { return value < entry.first; });
+        return next == history.begin() ? "" : prev(next)->second;
+    }
+
     void listStoredRoots() const
     {
         if (storedRoots.empty())
@@ -164,6 +256,8 @@ public:
     void clear()
     {
         storedRoots.clear();
+        rootHistory.clear();
+        storedSizes.clear();
         currentRoot = "";
         currentDataset = "";
     }
@@ -0,0 +1,485 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+// ========================
+// single line json field scanner
+// ========================
+// validates one json object without building a DOM and records where the
+// requested top level fields sit in the input. string values are returned as
+// views of the raw (still escaped) bytes, decodeString turns them into text.
+// acceptance follows nlohmann::json: strict number grammar, utf-8 and escape
+// validation, last duplicate key wins.
+class JsonLineScanner
+{
+public:
+    enum FieldType
+    {
+        MISSING,
+        STRING,
+        NUMBER,
+        OTHER
+    };
+
+    struct Field
+    {
+        FieldType type = MISSING;
+        string_view raw;
+        bool hasEscapes = false;
+    };
+
+private:
+    const char* pos;
+    const char* end;
+    const char* error;
+
+    bool fail(const char* message)
+    {
+        if (error == nullptr) error = message;
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) pos++;
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    //read the 4 hex digits after \u, pos points at the first digit
+    bool readCodeUnit(unsigned& unit)
+    {
+        if (end - pos < 4) return fail("truncated \\u escape");
+        unit = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            int value = hexValue(pos[i]);
+            if (value < 0) return fail("invalid \\u escape");
+            unit = (unit << 4) | static_cast<unsigned>(value);
+        }
+        pos += 4;
+        return true;
+    }
+
+    //check one multi-byte utf-8 sequence starting at pos
+    bool skipUtf8Sequence()
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(pos);
+        size_t available = static_cast<size_t>(end - pos);
+        unsigned char lead = p[0];
+        size_t length;
+        unsigned char low = 0x80, high = 0xBF;
+
+        if (lead >= 0xC2 && lead <= 0xDF) length = 2;
+        else if (lead == 0xE0) { length = 3; low = 0xA0; }
+        else if (lead == 0xED) { length = 3; high = 0x9F; }
+        else if (lead >= 0xE1 && lead <= 0xEF) length = 3;
+        else if (lead == 0xF0) { length = 4; low = 0x90; }
+        else if (lead == 0xF4) { length = 4; high = 0x8F; }
+        else if (lead >= 0xF1 && lead <= 0xF3) length = 4;
+        else return fail("invalid utf-8 byte");
+
+        if (available < length) return fail("truncated utf-8 sequence");
+        if (p[1] < low || p[1] > high) return fail("invalid utf-8 sequence");
+        for (size_t i = 2; i < length; i++)
+        {
+            if (p[i] < 0x80 || p[i] > 0xBF) return fail("invalid utf-8 sequence");
+        }
+
+        pos += length;
+        return true;
+    }
+
+    //pos at the opening quote, raw receives the bytes between the quotes
+    bool scanString(string_view& raw, bool& hasEscapes)
+    {
+        pos++;
+        const char* start = pos;
+        hasEscapes = false;
+
+        while (pos < end)
+        {
+            unsigned char c = static_cast<unsigned char>(*pos);
+
+            if (c == '"')
+            {
+                raw = string_view(start, static_cast<size_t>(pos - start));
+                pos++;
+                return true;
+            }
+
+            if (c == '\\')
+            {
+                hasEscapes = true;
+                pos++;
+                if (pos >= end) break;
+
+                char escape = *pos++;
+                if (escape == 'u')
+                {
+                    unsigned unit;
+                    if (!readCodeUnit(unit)) return false;
+
+                    if (unit >= 0xDC00 && unit <= 0xDFFF) return fail("lone low surrogate");
+                    if (unit >= 0xD800 && unit <= 0xDBFF)
+                    {
+                        unsigned lowUnit;
+                        if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') return fail("missing low surrogate");
+                        pos += 2;
+                        if (!readCodeUnit(lowUnit)) return false;
+                        if (lowUnit < 0xDC00 || lowUnit > 0xDFFF) return fail("invalid low surrogate");
+                    }
+                }
+                else if (strchr("\"\\/bfnrt", escape) == nullptr || escape == '\0')
+                {
+                    return fail("invalid escape");
+                }
+                continue;
+            }
+
+            if (c < 0x20) return fail("control character in string");
+
+            if (c >= 0x80)
+            {
+                if (!skipUtf8Sequence()) return false;
+                continue;
+            }
+
+            pos++;
+        }
+
+        return fail("unterminated string");
+    }
+
+    //json number grammar: -?(0|[1-9]d*)(.d+)?([eE][+-]?d+)?. numbers that
+    //overflow a double are rejected like nlohmann's out_of_range.406
+    bool scanNumber(string_view& raw)
+    {
+        const char* start = pos;
+
+        if (pos < end && *pos == '-') pos++;
+        if (pos >= end) return fail("invalid number");
+
+        if (*pos == '0') pos++;
+        else if (*pos >= '1' && *pos <= '9')
+        {
+            while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+        }
+        else return fail("invalid number");
+
+        if (pos < end && *pos == '.')
+        {
+            pos++;
+            if (pos >= end || *pos < '0' || *pos > '9') return fail("invalid number");
+            while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+        }
+
+        if (pos < end && (*pos == 'e' || *pos == 'E'))
+        {
+            pos++;
+            if (pos < end && (*pos == '+' || *pos == '-')) pos++;
+            if (pos >= end || *pos < '0' || *pos > '9') return fail("invalid number");
+            while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+        }
+
+        raw = string_view(start, static_cast<size_t>(pos - start));
+
+        //only an exponent or a few hundred digits can reach infinity
+        if (raw.find_first_of("eE") != string_view::npos || raw.size() > 300)
+        {
+            if (!isfinite(strtod(string(raw).c_str(), nullptr))) return fail("number overflow");
+        }
+        return true;
+    }
+
+    bool expectLiteral(const char* literal)
+    {
+        size_t length = strlen(literal);
+        if (static_cast<size_t>(end - pos) < length || memcmp(pos, literal, length) != 0)
+            return fail("invalid literal");
+        pos += length;
+        return true;
+    }
+
+    //object key and the ':' after it
+    bool scanKey()
+    {
+        skipWhitespace();
+        if (pos >= end || *pos != '"') return fail("expected object key");
+        string_view key;
+        bool keyEscapes;
+        if (!scanString(key, keyEscapes)) return false;
+        skipWhitespace();
+        if (pos >= end || *pos != ':') return fail("expected ':'");
+        pos++;
+        return true;
+    }
+
+    //string, number or literal
+    bool scanScalar(Field& field)
+    {
+        switch (*pos)
+        {
+        case '"':
+            field.type = STRING;
+            return scanString(field.raw, field.hasEscapes);
+        case 't':
+            field.type = OTHER;
+            return expectLiteral("true");
+        case 'f':
+            field.type = OTHER;
+            return expectLiteral("false");
+        case 'n':
+            field.type = OTHER;
+            return expectLiteral("null");
+        default:
+            field.type = NUMBER;
+            return scanNumber(field.raw);
+        }
+    }
+
+    //validate and skip the object or array at pos. open containers are kept
+    //on an explicit stack instead of recursing, so like nlohmann's parser any
+    //nesting depth is accepted
+    bool skipContainer()
+    {
+        string closers; //closing bracket of every open container, innermost last
+
+        while (true)
+        {
+            //pos is at the start of a value
+            skipWhitespace();
+            if (pos >= end) return fail("unexpected end of input");
+
+            if (*pos == '{' || *pos == '[')
+            {
+                char close = (*pos == '{') ? '}' : ']';
+                pos++;
+                skipWhitespace();
+                if (pos >= end || *pos != close)
+                {
+                    closers.push_back(close);
+                    if (close == '}' && !scanKey()) return false;
+                    continue;
+                }
+                pos++; //empty container
+            }
+            else
+            {
+                Field ignored;
+                if (!scanScalar(ignored)) return false;
+            }
+
+            //a value is complete: close containers until one has another element
+            while (true)
+            {
+                if (closers.empty()) return true;
+                char close = closers.back();
+                skipWhitespace();
+
+                if (pos < end && *pos == ',')
+                {
+                    pos++;
+                    if (close == '}' && !scanKey()) return false;
+                    break;
+                }
+                if (pos < end && *pos == close)
+                {
+                    pos++;
+                    closers.pop_back();
+                    continue;
+                }
+                return fail(close == '}' ? "expected ',' or '}'" : "expected ',' or ']'");
+            }
+        }
+    }
+
+    //validate and skip any value, field receives its type and raw text
+    bool scanValue(Field& field)
+    {
+        skipWhitespace();
+        if (pos >= end) return fail("unexpected end of input");
+
+        const char* start = pos;
+        field.hasEscapes = false;
+
+        if (*pos == '{' || *pos == '[')
+        {
+            if (!skipContainer()) return false;
+            field.type = OTHER;
+            field.raw = string_view(start, static_cast<size_t>(pos - start));
+            return true;
+        }
+        return scanScalar(field);
+    }
+
+public:
+    JsonLineScanner() : pos(nullptr), end(nullptr), error(nullptr) {}
+
+    //scan one line. fields[i] receives the value of top level key names[i].
+    //returns false with getError() set if the line is not valid json.
+    //isObject is false for valid json that is not an object
+    bool scan(string_view line, const char* const* names, Field* fields, size_t count, bool& isObject)
+    {
+        pos = line.data();
+        end = line.data() + line.size();
+        error = nullptr;
+        isObject = false;
+
+        for (size_t i = 0; i < count; i++) fields[i] = Field();
+
+        skipWhitespace();
+        if (pos < end && *pos == '{')
+        {
+            isObject = true;
+            pos++;
+            skipWhitespace();
+
+            if (pos < end && *pos == '}')
+            {
+                pos++;
+            }
+            else
+            {
+                string decodedKey;
+                while (true)
+                {
+                    skipWhitespace();
+                    if (pos >= end || *pos != '"') return fail("expected object key");
+
+                    string_view key;
+                    bool keyEscapes;
+                    if (!scanString(key, keyEscapes)) return false;
+                    if (keyEscapes)
+                    {
+                        decodeString(key, decodedKey);
+                        key = decodedKey;
+                    }
+
+                    skipWhitespace();
+                    if (pos >= end || *pos != ':') return fail("expected ':'");
+                    pos++;
+
+                    Field value;
+                    if (!scanValue(value)) return false;
+
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        if (key == names[i])
+                        {
+                            fields[i] = value;
+                            break;
+                        }
+                    }
+
+                    skipWhitespace();
+                    if (pos < end && *pos == ',')
+                    {
+                        pos++;
+                        continue;
+                    }
+                    if (pos < end && *pos == '}')
+                    {
+                        pos++;
+                        break;
+                    }
+                    return fail("expected ',' or '}'");
+                }
+            }
+        }
+        else
+        {
+            Field ignored;
+            if (!scanValue(ignored)) return false;
+        }
+
+        skipWhitespace();
+        if (pos != end) return fail("trailing characters after json value");
+        return true;
+    }
+
+    const char* getError() const { return error != nullptr ? error : ""; }
+
+    //decode a validated raw string into out (replaces out)
+    static void decodeString(string_view raw, string& out)
+    {
+        out.clear();
+        out.reserve(raw.size());
+
+        for (size_t i = 0; i < raw.size(); i++)
+        {
+            char c = raw[i];
+            if (c != '\\')
+            {
+                out.push_back(c);
+                continue;
+            }
+
+            char escape = raw[++i];
+            switch (escape)
+            {
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u':
+            {
+                unsigned codePoint = 0;
+                for (int k = 0; k < 4; k++) codePoint = (codePoint << 4) | static_cast<unsigned>(hexValue(raw[i + 1 + k]));
+                i += 4;
+
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+                {
+                    unsigned lowUnit = 0;
+                    for (int k = 0; k < 4; k++) lowUnit = (lowUnit << 4) | static_cast<unsigned>(hexValue(raw[i + 3 + k]));
+                    i += 6;
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowUnit - 0xDC00);
+                }
+
+                appendUtf8(codePoint, out);
+                break;
+            }
+            default: out.push_back(escape); break;
+            }
+        }
+    }
+
+    static void appendUtf8(unsigned codePoint, string& out)
+    {
+        if (codePoint < 0x80)
+        {
+            out.push_back(static_cast<char>(codePoint));
+        }
+        else if (codePoint < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+};
@@ -0,0 +1,314 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "SHA256.h"
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "LeafIndex.h"
+
+using namespace std;
+
+// ========================
+// k-ary flat merkle tree
+// ========================
+// FlatMerkleTree with Arity children per node, fixed at compile time (2, 4,
+// 8 or 16). levels are contiguous digest arrays and the shape is implicit:
+// parent of node i is i / Arity. a short last group is padded by repeating its
+// last child and a parent hashes its children in sorted order, the k-ary form
+// of the binary tree's odd node duplication and sorted pairs, so
+// KaryMerkleTree<2> has the same roots as FlatMerkleTree.
+//
+// a wider tree is log2(Arity) times shallower: fewer hash calls per proof,
+// each over Arity contiguous children (Arity * 32 bytes raw, * 64 hex), but a
+// proof carries Arity - 1 siblings per level instead of one.
+template<size_t Arity>
+class KaryMerkleTree
+{
+    static_assert(Arity == 2 || Arity == 4 || Arity == 8 || Arity == 16, "arity must be 2, 4, 8 or 16");
+
+public:
+    //sibling digests per proof level
+    static constexpr size_t SIBLINGS = Arity - 1;
+
+private:
+    vector<vector<Digest>> levels; //levels[0] = leaves, back() = root
+    LeafIndex leafIndex;
+    HashMode hashMode;
+    unsigned threadCount;
+    SHA256Batch::Kernel hashKernel;
+    SHA256 hasher;
+
+    static size_t messageSize(HashMode mode) { return Arity * (mode == HashMode::RAW_DIGEST ? 32 : 64); }
+
+    //combine input for one parent: count children (a short group repeats the
+    //last one) laid out in sorted order
+    static void writeGroup(const Digest* const* children, size_t count, HashMode mode, uint8_t* buffer)
+    {
+        const Digest* sorted[Arity];
+        for (size_t i = 0; i < Arity; i++) sorted[i] = children[min(i, count - 1)];
+        sort(sorted, sorted + Arity, [](const Digest* a, const Digest* b) { return digestLess(*a, *b); });
+
+        for (size_t i = 0; i < Arity; i++)
+        {
+            if (mode == HashMode::RAW_DIGEST) memcpy(buffer + 32 * i, sorted[i]->data(), 32);
+            else writeDigestHex(*sorted[i], reinterpret_cast<char*>(buffer) + 64 * i);
+        }
+    }
+
+    //group of node index within a level of levelSize nodes
+    static size_t groupOf(size_t index, size_t levelSize, size_t& count)
+    {
+        size_t first = index - index % Arity;
+        count = min(Arity, levelSize - first);
+        return first;
+    }
+
+    //parents [begin, end) of one level, hashed in lane batches like
+    //SHA256Batch::combineLevel
+    static void combineLevel(const vector<Digest>& children, size_t begin, size_t end,
+        HashMode mode, Digest* out, SHA256Batch::Kernel kernel)
+    {
+        const size_t group = 16;
+        uint8_t buffers[group][Arity * 64];
+        const uint8_t* messages[group];
+        size_t lengths[group];
+        const Digest* pointers[Arity];
+
+        for (size_t i = begin; i < end; i += group)
+        {
+            size_t n = min(group, end - i);
+            for (size_t j = 0; j < n; j++)
+            {
+                size_t first = (i + j) * Arity;
+                size_t count = min(Arity, children.size() - first);
+                for (size_t c = 0; c < count; c++) pointers[c] = &children[first + c];
+                writeGroup(pointers, count, mode, buffers[j]);
+                messages[j] = buffers[j];
+                lengths[j] = messageSize(mode);
+            }
+            SHA256Batch::hashMessages(messages, lengths, out + (i - begin), n, kernel);
+        }
+    }
+
+    void buildLevels()
+    {
+        levels.resize(1);
+
+        while (levels.back().size() > 1)
+        {
+            const vector<Digest>& current = levels.back();
+            vector<Digest> next((current.size() + Arity - 1) / Arity);
+
+            parallelFor(next.size(), threadCount, [&](size_t begin, size_t end)
+                {
+                    combineLevel(current, begin, end, hashMode, &next[begin], hashKernel);
+                });
+
+            levels.push_back(move(next));
+        }
+    }
+
+    //map ids to leaf positions, renaming duplicates like FlatMerkleTree
+    int indexLeafIds(const vector<string>& reviewIds)
+    {
+        size_t idBytes = 0;
+        for (const auto& id : reviewIds) idBytes += id.size();
+
+        leafIndex.clear();
+        leafIndex.reserve(reviewIds.size(), idBytes);
+        int duplicateCount = 0;
+
+        for (const auto& id : reviewIds)
+        {
+            if (leafIndex.append(id)) continue;
+
+            int suffix = 1;
+            while (!leafIndex.append(id + "_dup" + to_string(suffix++)))
+            {
+            }
+            duplicateCount++;
+        }
+
+        return duplicateCount;
+    }
+
+public:
+    KaryMerkleTree(HashMode mode = HashMode::HEX_COMPAT)
+        : hashMode(mode), threadCount(1), hashKernel(SHA256Batch::Kernel::AUTO) {
+    }
+
+    //threads used by buildTreeFromReviews, 0 = one per core
+    void setThreadCount(unsigned threads) { threadCount = threads; }
+
+    //force a batch hashing kernel (benchmarks), AUTO picks the best one
+    void setHashKernel(SHA256Batch::Kernel kernel) { hashKernel = kernel; }
+
+    void buildTreeFromReviews(const vector<string>& reviewData, const vector<string>& reviewIds)
+    {
+        if (reviewData.size() != reviewIds.size())
+        {
+            throw invalid_argument("review data and id arrays must match in size");
+        }
+
+        clear();
+        if (reviewData.empty()) return;
+
+        cout << "building " << Arity << "-ary merkle tree with " << reviewData.size() << " reviews ("
+            << resolveThreadCount(threadCount) << " threads)..." << endl;
+        auto start = chrono::high_resolution_clock::now();
+
+        levels.assign(1, vector<Digest>(reviewData.size()));
+        auto hashLeaves = [&]()
+            {
+                parallelFor(reviewData.size(), threadCount, [&](size_t begin, size_t end)
+                    {
+                        SHA256Batch::hashStrings(reviewData, begin, end, &levels[0][begin], hashKernel);
+                    }, 256);
+            };
+
+        //the id index is single threaded, overlap it with leaf hashing
+        int duplicateCount = 0;
+        if (resolveThreadCount(threadCount) > 1)
+        {
+            thread indexer([&]() { duplicateCount = indexLeafIds(reviewIds); });
+            hashLeaves();
+            indexer.join();
+        }
+        else
+        {
+            hashLeaves();
+            duplicateCount = indexLeafIds(reviewIds);
+        }
+
+        if (duplicateCount > 0)
+        {
+            cout << "duplicate reviews found: " << duplicateCount << endl;
+        }
+
+        buildLevels();
+
+        auto end = chrono::high_resolution_clock::now();
+        auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
+        cout << Arity << "-ary merkle tree built in " << totalTime.count() << " ms" << endl;
+        cout << "root hash: " << getRootHash() << endl;
+    }
+
+    //replace the data of an existing review and rehash its path, one
+    //Arity-wide hash per level. false if the id is unknown
+    bool updateReview(const string& reviewId, const string& reviewData)
+    {
+        size_t index;
+        if (!leafIndex.find(reviewId, index)) return false;
+
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), levels[0][index]);
+
+        uint8_t buffer[Arity * 64];
+        const Digest* pointers[Arity];
+        for (size_t level = 0; level + 1 < levels.size(); level++)
+        {
+            size_t count;
+            size_t first = groupOf(index, levels[level].size(), count);
+            for (size_t c = 0; c < count; c++) pointers[c] = &levels[level][first + c];
+            writeGroup(pointers, count, hashMode, buffer);
+
+            index /= Arity;
+            hashToDigest(hasher, buffer, messageSize(hashMode), levels[level + 1][index]);
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        levels.clear();
+        leafIndex.clear();
+    }
+
+    // ========================
+    // proofs
+    // ========================
+    // a proof is SIBLINGS digests per level, leaf to root: the other children
+    // of the node's group, padding copies included. children are combined in
+    // sorted order, so positions are not needed
+
+    //proof for a review id, false if it is not in the tree
+    bool generateProof(const string& reviewId, vector<Digest>& proof) const
+    {
+        size_t index;
+        if (!leafIndex.find(reviewId, index)) return false;
+        generateLeafProof(index, proof);
+        return true;
+    }
+
+    //proof for a leaf position (index < getLeafCount())
+    void generateLeafProof(size_t index, vector<Digest>& proof) const
+    {
+        proof.clear();
+        proof.reserve(levels.empty() ? 0 : (levels.size() - 1) * SIBLINGS);
+
+        for (size_t level = 0; level + 1 < levels.size(); level++)
+        {
+            const vector<Digest>& current = levels[level];
+            size_t count;
+            size_t first = groupOf(index, current.size(), count);
+            for (size_t slot = 0; slot < Arity; slot++)
+            {
+                if (first + slot == index) continue;
+                proof.push_back(current[first + min(slot, count - 1)]);
+            }
+            index /= Arity;
+        }
+    }
+
+    //check a proof against a raw root
+    static bool verifyProof(const string& reviewData, const vector<Digest>& proof,
+        const Digest& rootDigest, HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (proof.empty() || proof.size() % SIBLINGS != 0) return false;
+
+        SHA256 hasher;
+        Digest current;
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), current);
+
+        uint8_t buffer[Arity * 64];
+        const Digest* pointers[Arity];
+        for (size_t step = 0; step < proof.size(); step += SIBLINGS)
+        {
+            pointers[0] = &current;
+            for (size_t i = 0; i < SIBLINGS; i++) pointers[i + 1] = &proof[step + i];
+            writeGroup(pointers, Arity, mode, buffer);
+            hashToDigest(hasher, buffer, messageSize(mode), current);
+        }
+
+        return current == rootDigest;
+    }
+
+    // ========================
+    // queries
+    // ========================
+
+    string getRootHash() const { return levels.empty() ? "" : digestToHex(levels.back()[0]); }
+    Digest getRootDigest() const { return levels.empty() ? Digest{} : levels.back()[0]; }
+    HashMode getHashMode() const { return hashMode; }
+
+    bool contains(const string& reviewId) const { return leafIndex.contains(reviewId); }
+    size_t getLeafCount() const { return levels.empty() ? 0 : levels[0].size(); }
+
+    //number of levels including leaves and root
+    size_t getHeight() const { return levels.size(); }
+
+    //proof size in bytes for any leaf of this tree
+    size_t getProofBytes() const { return levels.empty() ? 0 : (levels.size() - 1) * SIBLINGS * sizeof(Digest); }
+
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = 0;
+        for (const auto& level : levels) bytes += level.capacity() * sizeof(Digest);
+        return bytes + leafIndex.getMemoryUsage();
+    }
+};
@@ -0,0 +1,294 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// ========================
+// compact leaf index
+// ========================
+// maps review ids to leaf positions without a heap string and hash node per
+// entry. ids are interned back to back in one arena and every leaf keeps a
+// packed (offset, length) reference to its id. lookups go through an
+// open-addressing table of 8-byte slots: the high 24 bits hold a tag from the
+// id's 64-bit fingerprint, the low 40 bits hold leaf + 1 (0 = empty). a tag
+// match is confirmed against the arena so fingerprint collisions are harmless.
+// about 8-10 bytes of table + 8 bytes of reference + the id bytes per leaf,
+// against 100+ bytes for unordered_map<string, ...>.
+class LeafIndex
+{
+private:
+    static constexpr uint64_t LEAF_MASK = (1ULL << 40) - 1;
+    static constexpr int LENGTH_BITS = 24;
+
+    vector<uint64_t> slots;       //power of two sized, linear probing
+    vector<uint64_t> leafIds;     //per leaf: arena offset << 24 | id length
+    vector<char> arena;
+    size_t garbageBytes;          //arena bytes of erased ids
+
+    static uint64_t mix(uint64_t hash, uint64_t word)
+    {
+        hash ^= word * 0xBF58476D1CE4E5B9ULL;
+        hash = (hash << 27) | (hash >> 37);
+        return hash * 0x94D049BB133111EBULL;
+    }
+
+    static uint64_t tagOf(uint64_t hash) { return hash >> 40; }
+
+    size_t mask() const { return slots.size() - 1; }
+
+    //slot holding id, or the empty slot where it would go
+    size_t probe(string_view id, uint64_t hash, bool& found) const
+    {
+        uint64_t tag = tagOf(hash);
+        size_t slot = static_cast<size_t>(hash) & mask();
+
+        while (slots[slot] != 0)
+        {
+            if ((slots[slot] >> 40) == tag && idAt((slots[slot] & LEAF_MASK) - 1) == id)
+            {
+                found = true;
+                return slot;
+            }
+            slot = (slot + 1) & mask();
+        }
+
+        found = false;
+        return slot;
+    }
+
+    void placeSlot(uint64_t hash, size_t leaf)
+    {
+        size_t slot = static_cast<size_t>(hash) & mask();
+        while (slots[slot] != 0) slot = (slot + 1) & mask();
+        slots[slot] = (tagOf(hash) << 40) | (leaf + 1);
+    }
+
+    //rebuild the table with at least capacity slots
+    void rehash(size_t capacity)
+    {
+        size_t size = 16;
+        while (size < capacity) size *= 2;
+
+        slots.assign(size, 0);
+        for (size_t leaf = 0; leaf < leafIds.size(); leaf++)
+        {
+            placeSlot(fingerprint(idAt(leaf)), leaf);
+        }
+    }
+
+    //keep the load factor under 0.85
+    void growFor(size_t entries)
+    {
+        if (entries * 20 > slots.size() * 17) rehash(max<size_t>(16, entries * 20 / 17 + 1));
+    }
+
+    //remove a slot with backward shift deletion, no tombstones needed
+    void removeSlot(size_t slot)
+    {
+        size_t hole = slot;
+        size_t next = (slot + 1) & mask();
+
+        while (slots[next] != 0)
+        {
+            size_t home = static_cast<size_t>(fingerprint(idAt((slots[next] & LEAF_MASK) - 1))) & mask();
+            //move the entry into the hole if the hole lies on its probe path
+            if (((next - home) & mask()) >= ((next - hole) & mask()))
+            {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+            next = (next + 1) & mask();
+        }
+        slots[hole] = 0;
+    }
+
+    //drop the bytes of erased ids once they are half the arena
+    void compactArena()
+    {
+        if (garbageBytes * 2 < arena.size()) return;
+
+        vector<char> compacted;
+        compacted.reserve(arena.size() - garbageBytes);
+        for (uint64_t& reference : leafIds)
+        {
+            uint64_t length = reference & ((1ULL << LENGTH_BITS) - 1);
+            uint64_t offset = reference >> LENGTH_BITS;
+            uint64_t newOffset = compacted.size();
+            compacted.insert(compacted.end(), arena.begin() + offset, arena.begin() + offset + length);
+            reference = (newOffset << LENGTH_BITS) | length;
+        }
+        arena.swap(compacted);
+        garbageBytes = 0;
+    }
+
+public:
+    LeafIndex() : garbageBytes(0)
+    {
+        slots.assign(16, 0);
+    }
+
+    //stable 64-bit hash of an id (also used for the persisted table)
+    static uint64_t fingerprint(string_view id)
+    {
+        uint64_t hash = 0x9E3779B97F4A7C15ULL ^ id.size();
+        size_t i = 0;
+        for (; i + 8 <= id.size(); i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, id.data() + i, 8);
+            hash = mix(hash, word);
+        }
+        if (i < id.size())
+        {
+            uint64_t word = 0;
+            memcpy(&word, id.data() + i, id.size() - i);
+            hash = mix(hash, word);
+        }
+        hash ^= hash >> 31;
+        hash *= 0xD6E8FEB86659FD93ULL;
+        return hash ^ (hash >> 32);
+    }
+
+    void clear()
+    {
+        slots.assign(16, 0);
+        leafIds.clear();
+        arena.clear();
+        garbageBytes = 0;
+    }
+
+    void reserve(size_t entries, size_t idBytes = 0)
+    {
+        leafIds.reserve(entries);
+        arena.reserve(idBytes);
+        growFor(entries);
+    }
+
+    size_t size() const { return leafIds.size(); }
+
+    //give the next leaf (size()) this id, false if the id is already taken
+    bool append(string_view id)
+    {
+        if (id.size() >= (1ULL << LENGTH_BITS)) throw length_error("review id too long for the leaf index");
+
+        uint64_t hash = fingerprint(id);
+        bool found;
+        probe(id, hash, found);
+        if (found) return false;
+
+        growFor(leafIds.size() + 1);
+
+        size_t leaf = leafIds.size();
+        leafIds.push_back((static_cast<uint64_t>(arena.size()) << LENGTH_BITS) | id.size());
+        arena.insert(arena.end(), id.begin(), id.end());
+        placeSlot(hash, leaf);
+        return true;
+    }
+
+    //leaf position of id
+    bool find(string_view id, size_t& leaf) const
+    {
+        bool found;
+        size_t slot = probe(id, fingerprint(id), found);
+        if (found) leaf = static_cast<size_t>(slots[slot] & LEAF_MASK) - 1;
+        return found;
+    }
+
+    bool contains(string_view id) const
+    {
+        bool found;
+        probe(id, fingerprint(id), found);
+        return found;
+    }
+
+    //id stored for a leaf
+    string_view idAt(size_t leaf) const
+    {
+        uint64_t reference = leafIds[leaf];
+        return string_view(arena.data() + (reference >> LENGTH_BITS),
+            static_cast<size_t>(reference & ((1ULL << LENGTH_BITS) - 1)));
+    }
+
+    //remove the id of leaf and move the last leaf's id into its place, the
+    //same swap the tree does when it deletes a leaf
+    void eraseLeaf(size_t leaf)
+    {
+        bool found;
+        string_view id = idAt(leaf);
+        size_t slot = probe(id, fingerprint(id), found);
+        removeSlot(slot);
+        garbageBytes += id.size();
+
+        size_t last = leafIds.size() - 1;
+        if (leaf != last)
+        {
+            string_view movedId = idAt(last);
+            size_t movedSlot = probe(movedId, fingerprint(movedId), found);
+            slots[movedSlot] = (slots[movedSlot] & ~LEAF_MASK) | (leaf + 1);
+            leafIds[leaf] = leafIds[last];
+        }
+        leafIds.pop_back();
+        compactArena();
+    }
+
+    //approximate bytes held by the table, references and arena
+    size_t getMemoryUsage() const
+    {
+        return slots.capacity() * sizeof(uint64_t) + leafIds.capacity() * sizeof(uint64_t) + arena.capacity();
+    }
+
+    // ========================
+    // persistence
+    // ========================
+    const uint64_t* slotData() const { return slots.data(); }
+    size_t slotCount() const { return slots.size(); }
+
+    //restore from persisted parts: ids given as leafCount + 1 arena offsets.
+    //slotTable may be null (or have the wrong shape) and is then rebuilt.
+    //false if the data is inconsistent, the index is left empty then
+    bool assign(const uint64_t* idOffsets, const char* idArena, size_t leafCount,
+        const uint64_t* slotTable, size_t tableSize)
+    {
+        clear();
+        arena.assign(idArena, idArena + idOffsets[leafCount]);
+        leafIds.resize(leafCount);
+        for (size_t leaf = 0; leaf < leafCount; leaf++)
+        {
+            uint64_t length = idOffsets[leaf + 1] - idOffsets[leaf];
+            if (idOffsets[leaf + 1] < idOffsets[leaf] || length >= (1ULL << LENGTH_BITS))
+            {
+                clear();
+                return false;
+            }
+            leafIds[leaf] = (idOffsets[leaf] << LENGTH_BITS) | length;
+        }
+
+        bool tableUsable = slotTable != nullptr && tableSize >= 16 && (tableSize & (tableSize - 1)) == 0 &&
+            leafCount * 20 <= tableSize * 17;
+        if (tableUsable)
+        {
+            slots.assign(slotTable, slotTable + tableSize);
+            size_t used = 0;
+            for (uint64_t slot : slots)
+            {
+                if (slot == 0) continue;
+                used++;
+                if ((slot & LEAF_MASK) > leafCount) tableUsable = false;
+            }
+            tableUsable = tableUsable && used == leafCount;
+        }
+
+        if (!tableUsable)
+        {
+            slots.assign(16, 0);
+            rehash(leafCount * 20 / 17 + 1);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// ========================
+// read-only memory mapped file
+// ========================
+// maps a whole file so it can be scanned in place without copying it into
+// strings first. the mapping lives until close() or destruction.
+class MappedFile
+{
+private:
+    const char* mappedData;
+    size_t mappedSize;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+
+public:
+    MappedFile() : mappedData(nullptr), mappedSize(0)
+#ifdef _WIN32
+        , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#else
+        , fileDescriptor(-1)
+#endif
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //map filename read-only, false if it cannot be opened or mapped
+    bool open(const string& filename)
+    {
+        close();
+
+#ifdef _WIN32
+        fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize))
+        {
+            close();
+            return false;
+        }
+
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+        if (mappedSize == 0) return true;
+
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (mappedData == nullptr)
+        {
+            close();
+            return false;
+        }
+#else
+        fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+        if (fileDescriptor < 0) return false;
+
+        struct stat info;
+        if (fstat(fileDescriptor, &info) != 0)
+        {
+            close();
+            return false;
+        }
+
+        mappedSize = static_cast<size_t>(info.st_size);
+        if (mappedSize == 0) return true;
+
+        void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (address == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+
+        madvise(address, mappedSize, MADV_SEQUENTIAL);
+        mappedData = static_cast<const char*>(address);
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (mappedData != nullptr) UnmapViewOfFile(mappedData);
+        if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (mappedData != nullptr) munmap(const_cast<char*>(mappedData), mappedSize);
+        if (fileDescriptor >= 0) ::close(fileDescriptor);
+        fileDescriptor = -1;
+#endif
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    const char* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+};
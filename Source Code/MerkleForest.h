@@ -0,0 +1,310 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <stdexcept>
+#include <chrono>
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+#include "LeafIndex.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// merkle forest
+// ========================
+// N independent FlatMerkleTree shards (one per category, or per ASIN hash
+// range) under one forest root. the forest root is a small binary tree over
+// one leaf per shard, hash(shard name || shard root), built with the same
+// sorted pairing as FlatMerkleTree. the leaf binds the name to the shard
+// root (not to a position), so a review cannot be proven under the wrong
+// shard. a forest proof has two stages: the review's path to its shard root,
+// then the shard leaf's path to the forest root. shards are built
+// concurrently and a shard can be rebuilt or updated on its own; only the
+// top tree (a few hashes per shard) is recomputed afterwards. not thread
+// safe across calls.
+class MerkleForest
+{
+public:
+    struct ForestProof
+    {
+        string shardName;
+        vector<ProofStep> reviewSteps;   //leaf to shard root
+        Digest shardRoot;
+        vector<ProofStep> shardSteps;    //shard leaf to forest root
+    };
+
+private:
+    struct Shard
+    {
+        string name;
+        unique_ptr<FlatMerkleTree> tree;
+    };
+
+    vector<Shard> shards;                      //top leaf order
+    unordered_map<string, size_t> shardByName;
+    vector<vector<Digest>> topLevels;          //[0] = shard leaves, back() = forest root
+    HashMode hashMode;
+    unsigned threadCount;
+
+    //the top tree only has one node per shard, rebuild it whole
+    void rebuildTop()
+    {
+        topLevels.clear();
+        if (shards.empty()) return;
+
+        topLevels.emplace_back(shards.size());
+        for (size_t i = 0; i < shards.size(); i++)
+        {
+            topLevels[0][i] = shardLeaf(shards[i].name, shards[i].tree->getRootDigest());
+        }
+
+        while (topLevels.back().size() > 1)
+        {
+            const vector<Digest>& current = topLevels.back();
+            vector<Digest> next((current.size() + 1) / 2);
+            SHA256Batch::combineLevel(current, 0, next.size(), hashMode, next.data());
+            topLevels.push_back(move(next));
+        }
+    }
+
+    Shard& shardFor(const string& shardName)
+    {
+        auto it = shardByName.find(shardName);
+        if (it != shardByName.end()) return shards[it->second];
+
+        shardByName[shardName] = shards.size();
+        shards.push_back({ shardName, make_unique<FlatMerkleTree>(hashMode) });
+        return shards.back();
+    }
+
+    static vector<ProofStep> topProof(const vector<vector<Digest>>& levels, size_t index)
+    {
+        vector<ProofStep> proof;
+        for (size_t level = 0; level + 1 < levels.size(); level++)
+        {
+            ProofStep step;
+            step.siblingOnRight = (index % 2 == 0);
+            size_t sibling = step.siblingOnRight ? index + 1 : index - 1;
+            step.sibling = levels[level][sibling < levels[level].size() ? sibling : index];
+            proof.push_back(step);
+            index /= 2;
+        }
+        return proof;
+    }
+
+public:
+    MerkleForest(HashMode mode = HashMode::HEX_COMPAT) : hashMode(mode), threadCount(0) {}
+
+    //threads shared by the shards of one build, 0 = one per core
+    void setThreadCount(unsigned threads) { threadCount = threads; }
+
+    //top tree leaf of a shard: binds the shard name to its root
+    static Digest shardLeaf(const string& shardName, const Digest& shardRoot)
+    {
+        SHA256 hasher;
+        hasher.add(shardName.data(), shardName.size());
+        hasher.add(shardRoot.data(), shardRoot.size());
+        Digest leaf;
+        hasher.getHash(leaf.data());
+        return leaf;
+    }
+
+    //shard for an ASIN when partitioning by hash range
+    static size_t shardForAsin(const string& asin, size_t shardCount)
+    {
+        return static_cast<size_t>(LeafIndex::fingerprint(asin) % shardCount);
+    }
+
+    // ========================
+    // building
+    // ========================
+
+    //build (or rebuild) several shards at once, one shard per thread. shards
+    //not named keep their trees. a name may appear only once, two builds of
+    //the same shard would run on the same tree
+    void buildShards(const vector<string>& shardNames, const vector<vector<string>>& reviewData,
+        const vector<vector<string>>& reviewIds)
+    {
+        if (shardNames.size() != reviewData.size() || shardNames.size() != reviewIds.size())
+        {
+            throw invalid_argument("shard name, data and id arrays must match in size");
+        }
+
+        unordered_map<string, size_t> seen;
+        for (const string& name : shardNames)
+        {
+            if (++seen[name] > 1) throw invalid_argument("duplicate shard name: " + name);
+        }
+
+        cout << "building merkle forest with " << shardNames.size() << " shards ("
+            << resolveThreadCount(threadCount) << " threads)..." << endl;
+        auto start = chrono::high_resolution_clock::now();
+
+        vector<FlatMerkleTree*> trees;
+        for (const string& name : shardNames) trees.push_back(shardFor(name).tree.get());
+
+        //more cores than shards: the spare ones go to the shards' own builds
+        unsigned threads = resolveThreadCount(threadCount);
+        unsigned perShard = max<unsigned>(1, threads / static_cast<unsigned>(max<size_t>(1, shardNames.size())));
+        parallelFor(shardNames.size(), threads, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    trees[i]->setThreadCount(perShard);
+                    trees[i]->buildTreeFromReviews(reviewData[i], reviewIds[i]);
+                }
+            }, 1);
+
+        rebuildTop();
+
+        auto end = chrono::high_resolution_clock::now();
+        auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
+        cout << "merkle forest built in " << totalTime.count() << " ms" << endl;
+        cout << "forest root: " << getRootHash() << endl;
+    }
+
+    //build (or rebuild) one shard, the others are untouched
+    void buildShard(const string& shardName, const vector<string>& reviewData, const vector<string>& reviewIds)
+    {
+        buildShards({ shardName }, { reviewData }, { reviewIds });
+    }
+
+    //split one dataset into shardCount shards by ASIN hash and build them
+    void buildByAsin(const vector<string>& reviewData, const vector<string>& reviewIds,
+        const vector<string>& asins, size_t shardCount)
+    {
+        if (reviewData.size() != reviewIds.size() || reviewData.size() != asins.size())
+        {
+            throw invalid_argument("review data, id and asin arrays must match in size");
+        }
+        if (shardCount == 0) throw invalid_argument("shard count must be positive");
+
+        vector<string> names(shardCount);
+        vector<vector<string>> data(shardCount), ids(shardCount);
+        for (size_t i = 0; i < shardCount; i++) names[i] = "asin-" + to_string(i);
+        for (size_t i = 0; i < reviewData.size(); i++)
+        {
+            size_t shard = shardForAsin(asins[i], shardCount);
+            data[shard].push_back(reviewData[i]);
+            ids[shard].push_back(reviewIds[i]);
+        }
+
+        buildShards(names, data, ids);
+    }
+
+    //apply a batch to an existing shard and refresh the forest root. a batch
+    //for an unknown shard is rejected whole, shards are created by building
+    BatchResult applyBatch(const string& shardName, const vector<TreeUpdate>& updates)
+    {
+        auto it = shardByName.find(shardName);
+        if (it == shardByName.end())
+        {
+            BatchResult rejected;
+            rejected.rejected = static_cast<int>(updates.size());
+            return rejected;
+        }
+
+        BatchResult result = shards[it->second].tree->applyBatch(updates);
+        rebuildTop();
+        return result;
+    }
+
+    //remove a shard and its reviews
+    bool removeShard(const string& shardName)
+    {
+        auto it = shardByName.find(shardName);
+        if (it == shardByName.end()) return false;
+
+        shards.erase(shards.begin() + it->second);
+        shardByName.clear();
+        for (size_t i = 0; i < shards.size(); i++) shardByName[shards[i].name] = i;
+        rebuildTop();
+        return true;
+    }
+
+    // ========================
+    // queries
+    // ========================
+
+    string getRootHash() const { return topLevels.empty() ? "" : digestToHex(topLevels.back()[0]); }
+    Digest getRootDigest() const { return topLevels.empty() ? Digest{} : topLevels.back()[0]; }
+    HashMode getHashMode() const { return hashMode; }
+
+    size_t getShardCount() const { return shards.size(); }
+    const string& getShardName(size_t shard) const { return shards[shard].name; }
+
+    //a shard's tree, null if there is no such shard
+    const FlatMerkleTree* getShard(const string& shardName) const
+    {
+        auto it = shardByName.find(shardName);
+        return it == shardByName.end() ? nullptr : shards[it->second].tree.get();
+    }
+
+    size_t getLeafCount() const
+    {
+        size_t leaves = 0;
+        for (const Shard& shard : shards) leaves += shard.tree->getLeafCount();
+        return leaves;
+    }
+
+    //two stage proof for a review in a known shard, false if it is not there
+    bool generateProof(const string& shardName, const string& reviewId, ForestProof& proof) const
+    {
+        auto it = shardByName.find(shardName);
+        if (it == shardByName.end()) return false;
+
+        const FlatMerkleTree& tree = *shards[it->second].tree;
+        if (!tree.contains(reviewId)) return false;
+
+        proof.shardName = shardName;
+        proof.reviewSteps = tree.generateDigestProof(reviewId);
+        proof.shardRoot = tree.getRootDigest();
+        proof.shardSteps = topProof(topLevels, it->second);
+        return true;
+    }
+
+    //same, looking the review up in every shard
+    bool generateProof(const string& reviewId, ForestProof& proof) const
+    {
+        for (const Shard& shard : shards)
+        {
+            if (shard.tree->contains(reviewId)) return generateProof(shard.name, reviewId, proof);
+        }
+        return false;
+    }
+
+    //check both stages against the forest root alone
+    static bool verifyProof(const string& reviewData, const ForestProof& proof,
+        const Digest& forestRoot, HashMode mode = HashMode::HEX_COMPAT)
+    {
+        //a single leaf shard has no steps but is still its own root
+        SHA256 hasher;
+        Digest current;
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), current);
+        for (const ProofStep& step : proof.reviewSteps)
+        {
+            combineDigests(hasher, current, step.sibling, mode, current);
+        }
+        if (current != proof.shardRoot) return false;
+
+        current = shardLeaf(proof.shardName, proof.shardRoot);
+        for (const ProofStep& step : proof.shardSteps)
+        {
+            combineDigests(hasher, current, step.sibling, mode, current);
+        }
+        return current == forestRoot;
+    }
+
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = 0;
+        for (const Shard& shard : shards) bytes += shard.tree->getMemoryUsage();
+        for (const auto& level : topLevels) bytes += level.capacity() * sizeof(Digest);
+        return bytes;
+    }
+};
@@ -0,0 +1,406 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "SHA256.h"
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "LeafIndex.h"
+
+using namespace std;
+
+// ========================
+// merkle mountain range
+// ========================
+// append-only history tree for a live review stream, hashed as in RFC 6962:
+//   leaf = SHA256(0x00 || review data)
+//   node = SHA256(0x01 || left || right)   (children in position order)
+// the root of n leaves splits at the largest power of two below n, so every
+// complete subtree of 2^l aligned leaves never changes once it exists. nodes[l]
+// holds those subtrees for level l; an append adds one leaf and merges equal
+// sized peaks, about one hash per append on average. leaf positions never
+// move, and inclusion proofs can be produced for any leaf against the current
+// or any earlier tree size from the stored subtrees, and so can consistency
+// proofs showing an earlier tree is a prefix of a later one.
+// not compatible with MerkleTree roots (positional, domain separated hashes)
+class MerkleMountainRange
+{
+public:
+    //root published after a batch of appends
+    struct Checkpoint
+    {
+        size_t treeSize;
+        Digest root;
+    };
+
+private:
+    vector<vector<Digest>> nodes; //nodes[l][i] covers leaves [i * 2^l, (i + 1) * 2^l)
+    LeafIndex leafIndex;
+    vector<Checkpoint> checkpoints;
+    SHA256 hasher;
+
+    static constexpr uint8_t LEAF_PREFIX = 0x00;
+    static constexpr uint8_t NODE_PREFIX = 0x01;
+
+    static void hashNode(SHA256& hasher, const Digest& left, const Digest& right, Digest& out)
+    {
+        uint8_t buffer[65];
+        buffer[0] = NODE_PREFIX;
+        memcpy(buffer + 1, left.data(), 32);
+        memcpy(buffer + 33, right.data(), 32);
+        hashToDigest(hasher, buffer, sizeof(buffer), out);
+    }
+
+    //largest power of two strictly below n (n >= 2)
+    static size_t splitPoint(size_t n)
+    {
+        size_t k = 1;
+        while (k * 2 < n) k *= 2;
+        return k;
+    }
+
+    //build every parent whose two children exist, one batch per level
+    void mergePeaks()
+    {
+        vector<uint8_t> buffer;
+        vector<const uint8_t*> messages;
+        vector<size_t> lengths;
+
+        for (size_t level = 0; nodes[level].size() >= 2; level++)
+        {
+            if (level + 1 == nodes.size()) nodes.emplace_back();
+
+            const vector<Digest>& children = nodes[level];
+            vector<Digest>& parents = nodes[level + 1];
+            size_t first = parents.size();
+            size_t count = children.size() / 2 - first;
+            if (count == 0) break;
+
+            buffer.resize(count * 65);
+            messages.resize(count);
+            lengths.assign(count, 65);
+            for (size_t p = 0; p < count; p++)
+            {
+                uint8_t* message = &buffer[p * 65];
+                message[0] = NODE_PREFIX;
+                memcpy(message + 1, children[2 * (first + p)].data(), 32);
+                memcpy(message + 33, children[2 * (first + p) + 1].data(), 32);
+                messages[p] = message;
+            }
+
+            parents.resize(first + count);
+            SHA256Batch::hashMessages(messages.data(), lengths.data(), &parents[first], count);
+        }
+    }
+
+    //hash of leaves [begin, begin + size), the subtree must lie within the tree
+    Digest subtreeHash(size_t begin, size_t size)
+    {
+        int level = 0;
+        while ((size_t(1) << level) < size) level++;
+
+        if ((size_t(1) << level) == size && (begin & (size - 1)) == 0)
+        {
+            return nodes[level][begin >> level];
+        }
+
+        size_t k = splitPoint(size);
+        Digest left = subtreeHash(begin, k);
+        Digest right = subtreeHash(begin + k, size - k);
+        Digest out;
+        hashNode(hasher, left, right, out);
+        return out;
+    }
+
+    //RFC 6962 audit path of leaf m within leaves [begin, begin + size)
+    void auditPath(size_t m, size_t begin, size_t size, vector<Digest>& path)
+    {
+        if (size <= 1) return;
+
+        size_t k = splitPoint(size);
+        if (m < k)
+        {
+            auditPath(m, begin, k, path);
+            path.push_back(subtreeHash(begin + k, size - k));
+        }
+        else
+        {
+            auditPath(m - k, begin + k, size - k, path);
+            path.push_back(subtreeHash(begin, k));
+        }
+    }
+
+    //RFC 6962 SUBPROOF: consistency of the first m leaves with [begin, begin + size)
+    void consistencyPath(size_t m, size_t begin, size_t size, bool complete, vector<Digest>& path)
+    {
+        if (m == size)
+        {
+            if (!complete) path.push_back(subtreeHash(begin, size));
+            return;
+        }
+
+        size_t k = splitPoint(size);
+        if (m <= k)
+        {
+            consistencyPath(m, begin, k, complete, path);
+            path.push_back(subtreeHash(begin + k, size - k));
+        }
+        else
+        {
+            consistencyPath(m - k, begin + k, size - k, false, path);
+            path.push_back(subtreeHash(begin, k));
+        }
+    }
+
+public:
+    MerkleMountainRange()
+    {
+        nodes.emplace_back();
+    }
+
+    //leaf hash as stored in the range
+    static Digest hashLeaf(const string& reviewData)
+    {
+        SHA256 hasher;
+        hasher.reset();
+        hasher.add(&LEAF_PREFIX, 1);
+        hasher.add(reviewData.data(), reviewData.size());
+        Digest out;
+        hasher.getHash(out.data());
+        return out;
+    }
+
+    //append one review, false if its id is already in the range
+    bool append(const string& reviewData, const string& reviewId)
+    {
+        if (!leafIndex.append(reviewId)) return false;
+
+        nodes[0].push_back(hashLeaf(reviewData));
+
+        //merge while the newest peak has an equal sized left neighbour
+        for (size_t level = 0; nodes[level].size() % 2 == 0; level++)
+        {
+            if (level + 1 == nodes.size()) nodes.emplace_back();
+            const vector<Digest>& children = nodes[level];
+            Digest parent;
+            hashNode(hasher, children[children.size() - 2], children.back(), parent);
+            nodes[level + 1].push_back(parent);
+        }
+        return true;
+    }
+
+    //append a batch of reviews and publish the root after it. leaves are
+    //hashed together and new parents are formed one level at a time.
+    //reviews whose id is already present are skipped and counted
+    Checkpoint appendBatch(const vector<string>& reviewData, const vector<string>& reviewIds, int* skipped = nullptr)
+    {
+        if (reviewData.size() != reviewIds.size())
+        {
+            throw invalid_argument("review data and id arrays must match in size");
+        }
+
+        vector<size_t> accepted;
+        accepted.reserve(reviewData.size());
+        size_t totalBytes = 0;
+        for (size_t i = 0; i < reviewIds.size(); i++)
+        {
+            if (!leafIndex.append(reviewIds[i])) continue;
+            accepted.push_back(i);
+            totalBytes += reviewData[i].size() + 1;
+        }
+        if (skipped) *skipped = static_cast<int>(reviewIds.size() - accepted.size());
+
+        //prefixed leaf messages back to back in one buffer
+        vector<uint8_t> buffer(totalBytes);
+        vector<const uint8_t*> messages(accepted.size());
+        vector<size_t> lengths(accepted.size());
+        size_t offset = 0;
+        for (size_t j = 0; j < accepted.size(); j++)
+        {
+            const string& data = reviewData[accepted[j]];
+            buffer[offset] = LEAF_PREFIX;
+            if (!data.empty()) memcpy(&buffer[offset + 1], data.data(), data.size());
+            messages[j] = buffer.data() + offset;
+            lengths[j] = data.size() + 1;
+            offset += lengths[j];
+        }
+
+        size_t first = nodes[0].size();
+        nodes[0].resize(first + accepted.size());
+        SHA256Batch::hashMessages(messages.data(), lengths.data(), nodes[0].data() + first, accepted.size());
+        mergePeaks();
+
+        return publish();
+    }
+
+    //record the current root as a checkpoint
+    Checkpoint publish()
+    {
+        Checkpoint checkpoint = { size(), getRootDigest() };
+        checkpoints.push_back(checkpoint);
+        return checkpoint;
+    }
+
+    const vector<Checkpoint>& getCheckpoints() const { return checkpoints; }
+
+    size_t size() const { return nodes[0].size(); }
+
+    bool contains(const string& reviewId) const { return leafIndex.contains(reviewId); }
+
+    //leaf position of a review, false if it was never appended
+    bool findLeaf(const string& reviewId, size_t& leaf) const { return leafIndex.find(reviewId, leaf); }
+
+    // root of the first treeSize leaves, the hash of no data if treeSize is 0
+    Digest getRootDigest(size_t treeSize)
+    {
+        if (treeSize > size()) throw out_of_range("tree size beyond the appended leaves");
+
+        if (treeSize == 0)
+        {
+            Digest empty;
+            hashToDigest(hasher, "", 0, empty);
+            return empty;
+        }
+        return subtreeHash(0, treeSize);
+    }
+
+    Digest getRootDigest() { return getRootDigest(size()); }
+
+    string getRootHash() { return digestToHex(getRootDigest()); }
+
+    // inclusion proof of leaf in the tree of its first treeSize leaves, leaf
+    // to root. empty for a single leaf tree
+    vector<Digest> generateProof(size_t leaf, size_t treeSize)
+    {
+        if (leaf >= treeSize || treeSize > size()) throw out_of_range("leaf not within the tree size");
+
+        vector<Digest> path;
+        auditPath(leaf, 0, treeSize, path);
+        return path;
+    }
+
+    vector<Digest> generateProof(size_t leaf) { return generateProof(leaf, size()); }
+
+    // inclusion proof for a review id against the current root, empty if unknown
+    vector<Digest> generateProof(const string& reviewId)
+    {
+        size_t leaf;
+        if (!leafIndex.find(reviewId, leaf)) return vector<Digest>();
+        return generateProof(leaf, size());
+    }
+
+    // verify an inclusion proof (RFC 9162 section 2.1.3.2)
+    static bool verifyProof(const string& reviewData, size_t leaf, size_t treeSize,
+        const vector<Digest>& proof, const Digest& root)
+    {
+        if (leaf >= treeSize) return false;
+
+        SHA256 hasher;
+        Digest current = hashLeaf(reviewData);
+        size_t fn = leaf;
+        size_t sn = treeSize - 1;
+
+        for (const Digest& sibling : proof)
+        {
+            if (sn == 0) return false;
+
+            if ((fn & 1) == 1 || fn == sn)
+            {
+                hashNode(hasher, sibling, current, current);
+                while ((fn & 1) == 0 && fn != 0)
+                {
+                    fn >>= 1;
+                    sn >>= 1;
+                }
+            }
+            else
+            {
+                hashNode(hasher, current, sibling, current);
+            }
+            fn >>= 1;
+            sn >>= 1;
+        }
+
+        return sn == 0 && current == root;
+    }
+
+    // ========================
+    // consistency proofs
+    // ========================
+    // proof that the tree of the first oldSize leaves is a prefix of the tree
+    // of the first newSize leaves, at most about 2 * log2(newSize) digests.
+    // empty if the sizes are equal or oldSize is 0
+    vector<Digest> generateConsistencyProof(size_t oldSize, size_t newSize)
+    {
+        if (oldSize > newSize || newSize > size()) throw out_of_range("invalid tree sizes for a consistency proof");
+
+        vector<Digest> path;
+        if (oldSize == 0 || oldSize == newSize) return path;
+        consistencyPath(oldSize, 0, newSize, true, path);
+        return path;
+    }
+
+    vector<Digest> generateConsistencyProof(size_t oldSize) { return generateConsistencyProof(oldSize, size()); }
+
+    // verify a consistency proof between two published roots (RFC 9162
+    // section 2.1.4.2) without any of the leaf data
+    static bool verifyConsistency(size_t oldSize, size_t newSize, const Digest& oldRoot,
+        const Digest& newRoot, const vector<Digest>& proof)
+    {
+        if (oldSize > newSize) return false;
+        if (oldSize == newSize) return proof.empty() && oldRoot == newRoot;
+        if (oldSize == 0) return proof.empty();
+        if (proof.empty()) return false;
+
+        //a complete old tree is itself a node of the new one and is not sent
+        vector<Digest> path;
+        path.reserve(proof.size() + 1);
+        if ((oldSize & (oldSize - 1)) == 0) path.push_back(oldRoot);
+        path.insert(path.end(), proof.begin(), proof.end());
+
+        size_t fn = oldSize - 1;
+        size_t sn = newSize - 1;
+        while ((fn & 1) == 1)
+        {
+            fn >>= 1;
+            sn >>= 1;
+        }
+
+        SHA256 hasher;
+        Digest oldHash = path[0];
+        Digest newHash = path[0];
+        for (size_t i = 1; i < path.size(); i++)
+        {
+            if (sn == 0) return false;
+
+            if ((fn & 1) == 1 || fn == sn)
+            {
+                hashNode(hasher, path[i], oldHash, oldHash);
+                hashNode(hasher, path[i], newHash, newHash);
+                while ((fn & 1) == 0 && fn != 0)
+                {
+                    fn >>= 1;
+                    sn >>= 1;
+                }
+            }
+            else
+            {
+                hashNode(hasher, newHash, path[i], newHash);
+            }
+            fn >>= 1;
+            sn >>= 1;
+        }
+
+        return sn == 0 && oldHash == oldRoot && newHash == newRoot;
+    }
+
+    //approximate bytes held by stored subtrees and the id index
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = leafIndex.getMemoryUsage();
+        for (const auto& level : nodes) bytes += level.capacity() * sizeof(Digest);
+        return bytes;
+    }
+};
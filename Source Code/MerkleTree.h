@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <chrono>
 #include "SHA256.h"
+#include "SHA256Batch.h"
+#include "LeafIndex.h"
 
 using namespace std;
 
@@ -50,7 +52,8 @@ class MerkleTree
 {
 public:
     shared_ptr<MerkleNode> root;
-    unordered_map<string, shared_ptr<MerkleNode>> leafMap;
+    LeafIndex leafIndex;                     //review id -> position in leafNodes
+    vector<shared_ptr<MerkleNode>> leafNodes;
     SHA256 hasher;
 
     // compute hash of data
@@ -66,6 +69,34 @@ private:
         return (h1 < h2) ? computeHash(h1 + h2) : computeHash(h2 + h1);
     }
 
+    // parent hashes of one level via the batched sha-256 kernels
+    vector<string> combineLevel(const vector<shared_ptr<MerkleNode>>& level)
+    {
+        size_t parentCount = (level.size() + 1) / 2;
+        vector<string> inputs(parentCount);
+        vector<const uint8_t*> messages(parentCount);
+        vector<size_t> lengths(parentCount);
+
+        for (size_t p = 0; p < parentCount; p++)
+        {
+            const string& h1 = level[2 * p]->hash;
+            const string& h2 = (2 * p + 1 < level.size()) ? level[2 * p + 1]->hash : h1;
+            inputs[p] = (h1 < h2) ? h1 + h2 : h2 + h1;
+            messages[p] = reinterpret_cast<const uint8_t*>(inputs[p].data());
+            lengths[p] = inputs[p].size();
+        }
+
+        vector<Digest> digests(parentCount);
+        SHA256Batch::hashMessages(messages.data(), lengths.data(), digests.data(), parentCount);
+
+        vector<string> hashes(parentCount);
+        for (size_t p = 0; p < parentCount; p++)
+        {
+            hashes[p] = digestToHex(digests[p]);
+        }
+        return hashes;
+    }
+
     // build internal levels of the tree
     shared_ptr<MerkleNode> buildTree(vector<shared_ptr<MerkleNode>>& nodes)
     {
@@ -80,20 +111,21 @@ private:
             vector<shared_ptr<MerkleNode>> next;
             next.reserve((current.size() + 1) / 2);
 
+            // hash the whole level in one batch, same input as combineHashes
+            vector<string> parentHashes = combineLevel(current);
+
             for (size_t i = 0; i < current.size(); i += 2)
             {
                 shared_ptr<MerkleNode> parent;
 
                 if (i + 1 < current.size())
                 {
-                    string parentHash = combineHashes(current[i]->hash, current[i + 1]->hash);
-                    parent = make_shared<MerkleNode>(parentHash, current[i], current[i + 1]);
+                    parent = make_shared<MerkleNode>(parentHashes[i / 2], current[i], current[i + 1]);
                 }
                 else
                 {
                     // duplicate last node if odd
-                    string dupHash = combineHashes(current[i]->hash, current[i]->hash);
-                    parent = make_shared<MerkleNode>(dupHash, current[i], current[i]);
+                    parent = make_shared<MerkleNode>(parentHashes[i / 2], current[i], current[i]);
                 }
 
                 parent->left->parent = parent;
@@ -120,9 +152,13 @@ public:
             throw invalid_argument("review data and id arrays must match in size");
         }
 
-        leafMap.clear();
-        vector<shared_ptr<MerkleNode>> leaves;
-        leaves.reserve(reviewData.size());
+        leafIndex.clear();
+        leafNodes.clear();
+        leafNodes.reserve(reviewData.size());
+
+        size_t idBytes = 0;
+        for (const auto& id : reviewIds) idBytes += id.size();
+        leafIndex.reserve(reviewIds.size(), idBytes);
 
         cout << "building merkle tree with " << reviewData.size() << " reviews..." << endl;
 
@@ -131,27 +167,29 @@ public:
 
         auto start = chrono::high_resolution_clock::now();
 
+        // leaves are independent, hash them in batches
+        vector<Digest> leafDigests(reviewData.size());
+        SHA256Batch::hashStrings(reviewData, 0, reviewData.size(), leafDigests.data());
+
         for (size_t i = 0; i < reviewData.size(); i++)
         {
-            string leafHash = computeHash(reviewData[i]);
+            string leafHash = digestToHex(leafDigests[i]);
 
             //handle duplicates by creating unique IDs
             string uniqueId = reviewIds[i];
-            if (leafMap.find(uniqueId) != leafMap.end())
+            if (!leafIndex.append(uniqueId))
             {
                 //generate unique ID for duplicate
                 int suffix = 1;
                 do {
                     uniqueId = reviewIds[i] + "_dup" + to_string(suffix++);
-                } while (leafMap.find(uniqueId) != leafMap.end());
+                } while (!leafIndex.append(uniqueId));
 
                 duplicateTracker[reviewIds[i]]++;
                 duplicateCount++;
             }
 
-            auto leaf = make_shared<MerkleNode>(leafHash, uniqueId);
-            leaves.push_back(leaf);
-            leafMap[uniqueId] = leaf;
+            leafNodes.push_back(make_shared<MerkleNode>(leafHash, uniqueId));
         }
 
         if (duplicateCount > 0)
@@ -170,14 +208,15 @@ public:
         }
 
         cout << "building tree structure..." << endl;
-        root = buildTree(leaves);
+        vector<shared_ptr<MerkleNode>> level = leafNodes;
+        root = buildTree(level);
 
         auto end = chrono::high_resolution_clock::now();
         auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
 
         cout << "merkle tree built in " << totalTime.count() << " ms" << endl;
         cout << "root hash: " << root->hash << endl;
-        cout << "unique leaf count: " << leafMap.size() << endl;
+        cout << "unique leaf count: " << leafIndex.size() << endl;
     }
 
     // get root hash
@@ -191,11 +230,11 @@ public:
     {
         vector<string> proof;
 
-        auto it = leafMap.find(reviewId);
-        if (it == leafMap.end())
+        size_t leaf;
+        if (!leafIndex.find(reviewId, leaf))
             return proof;
 
-        auto current = it->second;
+        auto current = leafNodes[leaf];
         proof.reserve(40);
 
         while (current != root && current->parent != nullptr)
@@ -256,13 +295,13 @@ public:
     // check if review id exists
     bool contains(const string& reviewId) const
     {
-        return leafMap.find(reviewId) != leafMap.end();
+        return leafIndex.contains(reviewId);
     }
 
     // count leaves
     size_t getLeafCount() const
     {
-        return leafMap.size();
+        return leafIndex.size();
     }
 
     //helper method to insert a leaf and return new root
@@ -314,7 +353,7 @@ public:
     //add a single review to the tree (partial rebuild)
     void addReview(const string& reviewData, const string& reviewId) 
     {
-        if (leafMap.find(reviewId) != leafMap.end()) 
+        if (leafIndex.contains(reviewId)) 
         {
             throw invalid_argument("Review ID already exists: " + reviewId);
         }
@@ -326,8 +365,9 @@ public:
         string leafHash = computeHash(reviewData);
         auto newLeaf = make_shared<MerkleNode>(leafHash, reviewId);
 
-        //add to leaf map
-        leafMap[reviewId] = newLeaf;
+        //add to leaf index
+        leafIndex.append(reviewId);
+        leafNodes.push_back(newLeaf);
 
         if (!root) 
         {
@@ -0,0 +1,299 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include "Digest.h"
+#include "SHA256Batch.h"
+#include "MerkleTree.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// multiproofs
+// ========================
+// one inclusion proof for a set of leaves. single proofs for leaves that share
+// ancestors repeat every sibling above the point where their paths meet; a
+// multiproof walks all paths together bottom-up and only ships a sibling when
+// it cannot be computed from the proven leaves themselves, so the upper
+// levels cost one digest each instead of one per leaf.
+//
+// siblings are listed level by level, leaves first, in ascending node order.
+// the verifier rebuilds the same walk from the leaf positions and tree size,
+// consuming siblings in that order, and must end on the root with nothing
+// left over. works for MerkleTree and FlatMerkleTree trees built in input
+// order (buildTreeFromReviews / appendLeaves / applyBatch).
+//
+// pairs are combined in sorted order, so a proof alone does not pin a leaf to
+// its position: the same siblings verify it at its sibling's position too.
+// trees whose proofs make claims about positions (ranges, neighbours) hash
+// positionedLeaf(position, data) instead of the data and are checked with
+// verifyPositioned.
+struct MultiProof
+{
+    size_t leafCount = 0;          //leaves in the tree the proof is for
+    vector<size_t> leafPositions;  //same order as the proven reviews
+    vector<Digest> siblings;
+
+    //bytes on the wire: positions and siblings
+    size_t payloadBytes() const
+    {
+        return sizeof(uint64_t) * (1 + leafPositions.size()) + siblings.size() * sizeof(Digest);
+    }
+};
+
+class MultiProofs
+{
+private:
+    //sorted, unique node indices of the current level
+    static void sortPositions(const vector<size_t>& positions, vector<size_t>& sorted)
+    {
+        sorted = positions;
+        sort(sorted.begin(), sorted.end());
+        sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+    }
+
+    //generation shared by both tree types. nodeAt(level, index, out) fetches
+    //the digest of a node, false if the tree shape does not match
+    template <class NodeAt>
+    static bool collectSiblings(size_t leafCount, const vector<size_t>& positions, NodeAt nodeAt, vector<Digest>& siblings)
+    {
+        vector<size_t> current;
+        sortPositions(positions, current);
+        vector<size_t> parents;
+
+        size_t levelSize = leafCount;
+        for (size_t level = 0; levelSize > 1; level++)
+        {
+            parents.clear();
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                size_t index = current[i];
+                bool even = (index % 2 == 0);
+
+                if (even && i + 1 < current.size() && current[i + 1] == index + 1)
+                {
+                    i++; //both children proven
+                }
+                else if (!(even && index + 1 >= levelSize))
+                {
+                    Digest sibling;
+                    if (!nodeAt(level, even ? index + 1 : index - 1, sibling)) return false;
+                    siblings.push_back(sibling);
+                }
+                parents.push_back(index / 2);
+            }
+            current.swap(parents);
+            levelSize = (levelSize + 1) / 2;
+        }
+        return true;
+    }
+
+public:
+    // multiproof for reviewIds in a flat tree, false if an id is unknown
+    static bool generate(const FlatMerkleTree& tree, const vector<string>& reviewIds, MultiProof& proof)
+    {
+        proof = MultiProof();
+        proof.leafCount = tree.getLeafCount();
+        proof.leafPositions.reserve(reviewIds.size());
+
+        for (const string& reviewId : reviewIds)
+        {
+            size_t leaf;
+            if (!tree.findLeaf(reviewId, leaf)) return false;
+            proof.leafPositions.push_back(leaf);
+        }
+
+        return collectSiblings(proof.leafCount, proof.leafPositions,
+            [&](size_t level, size_t index, Digest& out)
+            {
+                out = tree.getNode(level, index);
+                return true;
+            }, proof.siblings);
+    }
+
+    // multiproof for reviewIds in a pointer tree. false if an id is unknown
+    // or the tree was reshaped by addReview (its leaves are no longer laid
+    // out in input order)
+    static bool generate(const MerkleTree& tree, const vector<string>& reviewIds, MultiProof& proof)
+    {
+        proof = MultiProof();
+        proof.leafCount = tree.leafNodes.size();
+        proof.leafPositions.reserve(reviewIds.size());
+
+        for (const string& reviewId : reviewIds)
+        {
+            size_t leaf;
+            if (!tree.leafIndex.find(reviewId, leaf)) return false;
+            proof.leafPositions.push_back(leaf);
+        }
+
+        //nodes of the levels being walked, found through parent pointers
+        vector<size_t> sortedLeaves;
+        sortPositions(proof.leafPositions, sortedLeaves);
+        size_t walkedLevel = 0;
+        vector<pair<size_t, const MerkleNode*>> walked;
+        for (size_t leaf : sortedLeaves) walked.push_back({ leaf, tree.leafNodes[leaf].get() });
+
+        //move the walked nodes one level up, checking the implicit shape
+        auto climb = [&]() -> bool
+        {
+            vector<pair<size_t, const MerkleNode*>> parents;
+            for (const auto& node : walked)
+            {
+                const MerkleNode* parent = node.second->parent.get();
+                if (parent == nullptr) return false;
+                const MerkleNode* expected = (node.first % 2 == 0) ? parent->left.get() : parent->right.get();
+                if (expected != node.second) return false;
+                if (parents.empty() || parents.back().first != node.first / 2)
+                {
+                    parents.push_back({ node.first / 2, parent });
+                }
+            }
+            walked.swap(parents);
+            walkedLevel++;
+            return true;
+        };
+
+        return collectSiblings(proof.leafCount, proof.leafPositions,
+            [&](size_t level, size_t index, Digest& out)
+            {
+                while (walkedLevel < level)
+                {
+                    if (!climb()) return false;
+                }
+
+                //a sibling shares its parent with a walked node
+                auto it = lower_bound(walked.begin(), walked.end(), index ^ 1,
+                    [](const pair<size_t, const MerkleNode*>& node, size_t value) { return node.first < value; });
+                if (it == walked.end() || it->first != (index ^ 1)) return false;
+                const MerkleNode* parent = it->second->parent.get();
+                if (parent == nullptr) return false;
+                const MerkleNode* sibling = (index % 2 == 0) ? parent->left.get() : parent->right.get();
+                return sibling != nullptr && digestFromHex(sibling->hash, out);
+            }, proof.siblings);
+    }
+
+    // verify a multiproof. reviewData[i] is the data of the review at
+    // proof.leafPositions[i]; all leaves are hashed in one batch and every
+    // level is combined in one batch
+    static bool verify(const vector<string>& reviewData, const MultiProof& proof,
+        const Digest& rootDigest, HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (reviewData.size() != proof.leafPositions.size() || reviewData.empty()) return false;
+
+        vector<Digest> leafDigests(reviewData.size());
+        SHA256Batch::hashStrings(reviewData, 0, reviewData.size(), leafDigests.data());
+
+        //(index, digest) sorted by index, a repeated leaf must agree with itself
+        vector<pair<size_t, Digest>> current;
+        current.reserve(reviewData.size());
+        for (size_t i = 0; i < reviewData.size(); i++)
+        {
+            if (proof.leafPositions[i] >= proof.leafCount) return false;
+            current.push_back({ proof.leafPositions[i], leafDigests[i] });
+        }
+        sort(current.begin(), current.end(),
+            [](const pair<size_t, Digest>& a, const pair<size_t, Digest>& b) { return a.first < b.first; });
+        for (size_t i = 1; i < current.size(); i++)
+        {
+            if (current[i].first == current[i - 1].first && current[i].second != current[i - 1].second) return false;
+        }
+        current.erase(unique(current.begin(), current.end()), current.end());
+
+        size_t messageSize = (mode == HashMode::RAW_DIGEST) ? 64 : 128;
+        vector<uint8_t> buffer;
+        vector<const uint8_t*> messages;
+        vector<size_t> lengths;
+        vector<pair<size_t, Digest>> parents;
+        size_t nextSibling = 0;
+
+        for (size_t levelSize = proof.leafCount; levelSize > 1; levelSize = (levelSize + 1) / 2)
+        {
+            parents.clear();
+            buffer.resize(current.size() * messageSize);
+            messages.clear();
+
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                size_t index = current[i].first;
+                const Digest& node = current[i].second;
+                bool even = (index % 2 == 0);
+                const Digest* sibling;
+
+                if (even && i + 1 < current.size() && current[i + 1].first == index + 1)
+                {
+                    sibling = &current[++i].second;
+                }
+                else if (even && index + 1 >= levelSize)
+                {
+                    sibling = &node; //odd node paired with itself
+                }
+                else
+                {
+                    if (nextSibling >= proof.siblings.size()) return false;
+                    sibling = &proof.siblings[nextSibling++];
+                }
+
+                //even index on the left, whatever supplied the other child
+                uint8_t* message = &buffer[messages.size() * messageSize];
+                if (even) SHA256Batch::writePair(node, *sibling, mode, message);
+                else SHA256Batch::writePair(*sibling, node, mode, message);
+                messages.push_back(message);
+                parents.push_back({ index / 2, Digest() });
+            }
+
+            lengths.assign(messages.size(), messageSize);
+            vector<Digest> digests(messages.size());
+            SHA256Batch::hashMessages(messages.data(), lengths.data(), digests.data(), messages.size());
+            for (size_t p = 0; p < parents.size(); p++) parents[p].second = digests[p];
+            current.swap(parents);
+        }
+
+        return nextSibling == proof.siblings.size() && current.size() == 1 && current[0].second == rootDigest;
+    }
+
+    // same against a hex root as returned by getRootHash
+    static bool verify(const vector<string>& reviewData, const MultiProof& proof,
+        const string& rootHash, HashMode mode = HashMode::HEX_COMPAT)
+    {
+        Digest rootDigest;
+        return digestFromHex(rootHash, rootDigest) && verify(reviewData, proof, rootDigest, mode);
+    }
+
+    // leaf message binding data to its leaf position: 8 byte big endian
+    // position, then the data
+    static string positionedLeaf(size_t position, string_view data)
+    {
+        string leaf(8, '\0');
+        for (int i = 7; i >= 0; i--, position >>= 8) leaf[i] = static_cast<char>(position & 0xFF);
+        leaf.append(data);
+        return leaf;
+    }
+
+    // verify a multiproof over a tree of positioned leaves. reviewData is the
+    // bare data, each item is bound to its claimed position before hashing,
+    // so a leaf moved to another position no longer reproduces the root
+    static bool verifyPositioned(const vector<string>& reviewData, const MultiProof& proof,
+        const Digest& rootDigest, HashMode mode = HashMode::HEX_COMPAT)
+    {
+        if (reviewData.size() != proof.leafPositions.size()) return false;
+
+        vector<string> leaves(reviewData.size());
+        for (size_t i = 0; i < reviewData.size(); i++)
+        {
+            leaves[i] = positionedLeaf(proof.leafPositions[i], reviewData[i]);
+        }
+        return verify(leaves, proof, rootDigest, mode);
+    }
+
+    // digests the same leaves would ship as independent single proofs
+    static size_t individualProofDigests(const MultiProof& proof)
+    {
+        size_t height = 0;
+        for (size_t size = proof.leafCount; size > 1; size = (size + 1) / 2) height++;
+        return height * proof.leafPositions.size();
+    }
+};
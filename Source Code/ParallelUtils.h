@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+// ========================
+// parallel helpers
+// ========================
+
+//0 means one thread per hardware core
+inline unsigned resolveThreadCount(unsigned requested)
+{
+    if (requested > 0) return requested;
+    unsigned cores = thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+//split [0, count) into one contiguous chunk per thread and run body(begin, end)
+//on each. the calling thread takes the first chunk. chunks below minChunk are
+//merged so small inputs stay on one thread.
+inline void parallelFor(size_t count, unsigned threadCount,
+    const function<void(size_t, size_t)>& body, size_t minChunk = 1024)
+{
+    if (count == 0) return;
+
+    size_t maxThreads = max<size_t>(1, count / max<size_t>(1, minChunk));
+    size_t threads = min<size_t>(resolveThreadCount(threadCount), maxThreads);
+
+    if (threads <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    size_t chunk = (count + threads - 1) / threads;
+    vector<thread> workers;
+    workers.reserve(threads - 1);
+
+    for (size_t t = 1; t < threads; t++)
+    {
+        size_t begin = t * chunk;
+        size_t end = min(count, begin + chunk);
+        if (begin >= end) break;
+        workers.emplace_back(body, begin, end);
+    }
+
+    body(0, min(count, chunk));
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
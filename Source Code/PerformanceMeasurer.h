@@ -6,9 +6,17 @@
 #include <memory>
 #include <fstream>
 #include <algorithm>
+#include <random>
+#include <cmath>
+#include <thread>
+#include <atomic>
 #include <windows.h>
 #include <psapi.h>
 #include "MerkleTree.h"
+#include "FlatMerkleTree.h"
+#include "ProofCache.h"
+#include "ConcurrentMerkleTree.h"
+#include "KaryMerkleTree.h"
 
 using namespace std;
 
@@ -99,6 +107,28 @@ public:
         return result;
     }
 
+    MeasurementResult measureBatchHashingSpeed(const vector<string>& data)
+    {
+        MeasurementResult result;
+        result.testName = string("SHA-256 Batch Hashing Speed (") + SHA256Batch::kernelName(SHA256Batch::Kernel::AUTO) + ")";
+        result.datasetSize = static_cast<int>(data.size());
+
+        auto startTime = chrono::high_resolution_clock::now();
+        auto startMemory = getCurrentMemoryUsage();
+
+        vector<Digest> digests(data.size());
+        SHA256Batch::hashStrings(data, 0, data.size(), digests.data());
+
+        auto endTime = chrono::high_resolution_clock::now();
+        auto endMemory = getCurrentMemoryUsage();
+
+        result.executionTimeMicroseconds = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+        result.memoryUsageBytes = endMemory - startMemory;
+        result.additionalInfo = to_string(digests.size()) + " hashes computed";
+
+        return result;
+    }
+
     MeasurementResult measureTreeConstruction(const vector<string>& data, const vector<string>& ids)
     {
         MeasurementResult result;
@@ -121,6 +151,29 @@ public:
         return result;
     }
 
+    MeasurementResult measureParallelConstruction(const vector<string>& data, const vector<string>& ids, unsigned threads)
+    {
+        MeasurementResult result;
+        result.testName = "Flat Tree Construction (" + to_string(resolveThreadCount(threads)) + " threads)";
+        result.datasetSize = static_cast<int>(data.size());
+
+        auto startTime = chrono::high_resolution_clock::now();
+        auto startMemory = getCurrentMemoryUsage();
+
+        FlatMerkleTree tree;
+        tree.setThreadCount(threads);
+        tree.buildTreeFromReviews(data, ids);
+
+        auto endTime = chrono::high_resolution_clock::now();
+        auto endMemory = getCurrentMemoryUsage();
+
+        result.executionTimeMicroseconds = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+        result.memoryUsageBytes = endMemory - startMemory;
+        result.additionalInfo = "Root: " + tree.getRootHash().substr(0, 16) + "...";
+
+        return result;
+    }
+
     MeasurementResult measureProofGeneration(MerkleTree& tree, const vector<string>& reviewIds, int sampleSize = 100)
     {
         MeasurementResult result;
@@ -195,6 +248,197 @@ public:
         return result;
     }
 
+    //p99 proof latency under a skewed load, uncached walk vs ProofCache.
+    //ids are drawn so a small set of hot reviews gets most of the requests
+    MeasurementResult measureCachedProofLatency(const vector<string>& data, const vector<string>& ids,
+        int requestCount = 100000)
+    {
+        MeasurementResult result;
+        result.testName = "Cached Proof Latency (" + to_string(requestCount) + " skewed requests)";
+        result.datasetSize = static_cast<int>(data.size());
+        result.executionTimeMicroseconds = 0;
+        result.memoryUsageBytes = 0;
+        if (ids.empty()) return result;
+
+        FlatMerkleTree tree;
+        tree.buildTreeFromReviews(data, ids);
+        ProofCache cache(tree);
+
+        mt19937_64 random(42);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        vector<size_t> requests(requestCount);
+        for (size_t& request : requests)
+        {
+            request = min(ids.size() - 1, static_cast<size_t>(ids.size() * pow(uniform(random), 8.0)));
+        }
+
+        //nanoseconds per request at the 99th percentile
+        auto p99 = [&](auto generate)
+        {
+            vector<long long> latencies;
+            latencies.reserve(requests.size());
+            vector<ProofStep> proof;
+            for (size_t request : requests)
+            {
+                auto start = chrono::high_resolution_clock::now();
+                generate(ids[request], proof);
+                auto end = chrono::high_resolution_clock::now();
+                latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+            }
+            nth_element(latencies.begin(), latencies.begin() + latencies.size() * 99 / 100, latencies.end());
+            return latencies[latencies.size() * 99 / 100];
+        };
+
+        long long uncached = p99([&](const string& id, vector<ProofStep>& proof) { proof = tree.generateDigestProof(id); });
+
+        auto startMemory = getCurrentMemoryUsage();
+        long long cached = p99([&](const string& id, vector<ProofStep>& proof) { cache.getDigestProof(id, proof); });
+        auto endMemory = getCurrentMemoryUsage();
+
+        ProofCache::Stats stats = cache.getStats();
+        result.executionTimeMicroseconds = cached / 1000;
+        result.memoryUsageBytes = endMemory - startMemory;
+        result.additionalInfo = "p99 uncached " + to_string(uncached) + " ns, cached " + to_string(cached)
+            + " ns, hit rate " + to_string(static_cast<int>(cache.hitRate() * 100)) + "%, "
+            + to_string(stats.entries) + " entries";
+
+        return result;
+    }
+
+    //proofs per second served from pinned versions of a ConcurrentMerkleTree
+    //by 1 and by readerThreads threads while a writer keeps applying batches
+    MeasurementResult measureConcurrentProofServing(const vector<string>& data, const vector<string>& ids,
+        unsigned readerThreads = 0, int proofsPerThread = 100000)
+    {
+        MeasurementResult result;
+        readerThreads = resolveThreadCount(readerThreads);
+        result.testName = "Concurrent Proof Serving (" + to_string(readerThreads) + " readers, writer active)";
+        result.datasetSize = static_cast<int>(data.size());
+        result.executionTimeMicroseconds = 0;
+        result.memoryUsageBytes = 0;
+        if (ids.empty()) return result;
+
+        ConcurrentMerkleTree tree;
+        tree.buildTreeFromReviews(data, ids);
+
+        //proofs per second with threads readers, batches counts writer publishes
+        auto serve = [&](unsigned threads, long long& micros, int& batches)
+        {
+            atomic<bool> done(false);
+            batches = 0;
+            thread writer([&]()
+                {
+                    mt19937_64 random(7);
+                    while (!done)
+                    {
+                        vector<TreeUpdate> batch;
+                        for (int i = 0; i < 100; i++)
+                        {
+                            size_t pick = random() % ids.size();
+                            batch.push_back({ TreeUpdate::UPDATE, ids[pick], data[pick] });
+                        }
+                        tree.applyBatch(batch);
+                        batches++;
+                    }
+                });
+
+            auto start = chrono::high_resolution_clock::now();
+            vector<thread> readers;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                readers.emplace_back([&, t]()
+                    {
+                        ConcurrentMerkleTree::Reader reader(tree);
+                        vector<ProofStep> proof;
+                        size_t leaf = t;
+                        for (int i = 0; i < proofsPerThread; i++)
+                        {
+                            auto pinned = reader.pin();
+                            leaf = (leaf + 7919) % pinned->getLeafCount();
+                            pinned->generateLeafProof(leaf, proof);
+                        }
+                    });
+            }
+            for (auto& reader : readers) reader.join();
+            auto end = chrono::high_resolution_clock::now();
+
+            done = true;
+            writer.join();
+            micros = max(1LL, static_cast<long long>(chrono::duration_cast<chrono::microseconds>(end - start).count()));
+            return static_cast<long long>(threads) * proofsPerThread * 1000000 / micros;
+        };
+
+        long long singleMicros, multiMicros;
+        int singleBatches, multiBatches;
+        long long single = serve(1, singleMicros, singleBatches);
+        long long multi = serve(readerThreads, multiMicros, multiBatches);
+        tree.reclaim();
+
+        result.executionTimeMicroseconds = multiMicros;
+        result.additionalInfo = "1 reader " + to_string(single) + " proofs/s, " + to_string(readerThreads) + " readers "
+            + to_string(multi) + " proofs/s, " + to_string(multiBatches) + " batches published meanwhile";
+
+        return result;
+    }
+
+    //build, proof size, generation and verification cost of one tree arity
+    template<size_t Arity>
+    MeasurementResult measureTreeArity(const vector<string>& data, const vector<string>& ids, int proofCount)
+    {
+        MeasurementResult result;
+        result.testName = to_string(Arity) + "-ary Tree (build, proof size, verify)";
+        result.datasetSize = static_cast<int>(data.size());
+        result.executionTimeMicroseconds = 0;
+        result.memoryUsageBytes = 0;
+        if (ids.empty()) return result;
+
+        KaryMerkleTree<Arity> tree;
+        auto start = chrono::high_resolution_clock::now();
+        tree.buildTreeFromReviews(data, ids);
+        auto built = chrono::high_resolution_clock::now();
+
+        //proofs for spread out leaves, generated then verified
+        vector<vector<Digest>> proofs(proofCount);
+        vector<size_t> picks(proofCount);
+        for (int i = 0; i < proofCount; i++)
+        {
+            picks[i] = (static_cast<size_t>(i) * 7919) % ids.size();
+        }
+
+        auto generateStart = chrono::high_resolution_clock::now();
+        for (int i = 0; i < proofCount; i++) tree.generateProof(ids[picks[i]], proofs[i]);
+        auto generateEnd = chrono::high_resolution_clock::now();
+
+        int valid = 0;
+        Digest root = tree.getRootDigest();
+        for (int i = 0; i < proofCount; i++)
+        {
+            if (KaryMerkleTree<Arity>::verifyProof(data[picks[i]], proofs[i], root)) valid++;
+        }
+        auto verifyEnd = chrono::high_resolution_clock::now();
+
+        auto micros = [](chrono::high_resolution_clock::time_point a, chrono::high_resolution_clock::time_point b)
+            {
+                return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(b - a).count()) / 1000.0;
+            };
+
+        result.executionTimeMicroseconds = chrono::duration_cast<chrono::microseconds>(built - start).count();
+        result.memoryUsageBytes = tree.getMemoryUsage();
+        result.additionalInfo = "height " + to_string(tree.getHeight()) + ", proof " + to_string(tree.getProofBytes()) +
+            " bytes, generate " + to_string(micros(generateStart, generateEnd) / proofCount) + " us, verify " +
+            to_string(micros(generateEnd, verifyEnd) / proofCount) + " us per proof (" + to_string(valid) + "/" +
+            to_string(proofCount) + " valid)";
+        return result;
+    }
+
+    //the same dataset as a 2, 4, 8 and 16-ary tree
+    vector<MeasurementResult> measureArityTradeoffs(const vector<string>& data, const vector<string>& ids,
+        int proofCount = 10000)
+    {
+        return { measureTreeArity<2>(data, ids, proofCount), measureTreeArity<4>(data, ids, proofCount),
+            measureTreeArity<8>(data, ids, proofCount), measureTreeArity<16>(data, ids, proofCount) };
+    }
+
     vector<MeasurementResult> measureScalability(const vector<Review>& allReviews,
         const vector<int>& datasetSizes = { 100, 1000, 5000, 10000 })
     {
@@ -245,6 +489,8 @@ public:
         cout << "\n=== COMPREHENSIVE PERFORMANCE ANALYSIS ===" << endl;
 
         vector<string> reviewData, reviewIds;
+        reviewData.reserve(reviews.size());
+        reviewIds.reserve(reviews.size());
         for (const auto& review : reviews)
         {
             reviewData.push_back(review.convertToString());
@@ -258,11 +504,20 @@ public:
         hashingResult.print();
         allResults.push_back(hashingResult);
 
+        auto batchHashingResult = measureBatchHashingSpeed(reviewData);
+        batchHashingResult.print();
+        allResults.push_back(batchHashingResult);
+
         cout << "2. Tree Construction Performance:" << endl;
         auto constructionResult = measureTreeConstruction(reviewData, reviewIds);
         constructionResult.print();
         allResults.push_back(constructionResult);
 
+        cout << "2b. Parallel Flat Tree Construction:" << endl;
+        auto parallelResult = measureParallelConstruction(reviewData, reviewIds, 0);
+        parallelResult.print();
+        allResults.push_back(parallelResult);
+
         MerkleTree tree;
         tree.buildTreeFromReviews(reviewData, reviewIds);
 
@@ -271,6 +526,23 @@ public:
         proofGenResult.print();
         allResults.push_back(proofGenResult);
 
+        cout << "3b. Cached Proof Latency:" << endl;
+        auto cachedProofResult = measureCachedProofLatency(reviewData, reviewIds);
+        cachedProofResult.print();
+        allResults.push_back(cachedProofResult);
+
+        cout << "3c. Concurrent Proof Serving:" << endl;
+        auto concurrentResult = measureConcurrentProofServing(reviewData, reviewIds);
+        concurrentResult.print();
+        allResults.push_back(concurrentResult);
+
+        cout << "3d. Tree Arity Trade-offs:" << endl;
+        for (const auto& arityResult : measureArityTradeoffs(reviewData, reviewIds))
+        {
+            arityResult.print();
+            allResults.push_back(arityResult);
+        }
+
         cout << "4. Proof Verification Performance:" << endl;
         auto proofVerResult = measureProofVerification(tree, reviewData, reviewIds, 100);
         proofVerResult.print();
@@ -0,0 +1,177 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <numeric>
+#include "DataPreprocessor.h"
+#include "FlatMerkleTree.h"
+#include "MultiProof.h"
+
+using namespace std;
+
+//proof that a leaf range holds every review of one product. the leaves just
+//outside the range are included so the verifier can see they belong to other
+//products; with leaves sorted by (asin, reviewID) nothing can be left out.
+//an empty range proves the product has no reviews
+struct ProductRangeProof
+{
+    string asin;
+    size_t begin = 0;          //first leaf of the product
+    size_t end = 0;            //one past its last leaf
+    bool hasLeftNeighbour = false;
+    bool hasRightNeighbour = false;
+    vector<string> leafData;   //canonical data of leaves [begin - left, end + right)
+    MultiProof proof;
+
+    size_t reviewCount() const { return end - begin; }
+};
+
+// ========================
+// product ordered tree
+// ========================
+// FlatMerkleTree whose leaves are sorted by (asin, reviewID) instead of file
+// order, so the reviews of one product are a contiguous leaf range. one range
+// proof (a multiproof over the range and its two neighbours, about 2 log n
+// siblings) proves all of a product's reviews and that none are missing.
+// leaves are hashed with their position (MultiProofs::positionedLeaf) so a
+// proof cannot swap a neighbour with the review next to it. roots differ from
+// the file ordered trees over the same reviews.
+class ProductOrderedTree
+{
+private:
+    FlatMerkleTree tree;
+    vector<string> leafData;        //canonical data in leaf order
+    vector<string> productAsins;    //sorted distinct asins
+    vector<size_t> productStarts;   //first leaf of each product, plus leaf count
+
+public:
+    ProductOrderedTree(HashMode mode = HashMode::HEX_COMPAT) : tree(mode) {}
+
+    //sort reviews by (asin, reviewID) and build the tree over them
+    void buildFromReviews(const vector<Review>& reviews)
+    {
+        vector<size_t> order(reviews.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](size_t a, size_t b)
+            {
+                int byAsin = reviews[a].asin.compare(reviews[b].asin);
+                return byAsin != 0 ? byAsin < 0 : reviews[a].reviewID < reviews[b].reviewID;
+            });
+
+        leafData.assign(reviews.size(), string());
+        vector<string> reviewIds(reviews.size());
+        productAsins.clear();
+        productStarts.clear();
+
+        for (size_t leaf = 0; leaf < order.size(); leaf++)
+        {
+            const Review& review = reviews[order[leaf]];
+            leafData[leaf].reserve(review.canonicalSize());
+            review.appendCanonical(leafData[leaf]);
+            reviewIds[leaf] = review.getUniqueID();
+
+            if (productAsins.empty() || productAsins.back() != review.asin)
+            {
+                productAsins.push_back(review.asin);
+                productStarts.push_back(leaf);
+            }
+        }
+        productStarts.push_back(reviews.size());
+
+        vector<string> leaves(leafData.size());
+        for (size_t leaf = 0; leaf < leaves.size(); leaf++)
+        {
+            leaves[leaf] = MultiProofs::positionedLeaf(leaf, leafData[leaf]);
+        }
+
+        cout << "building product ordered tree over " << productAsins.size() << " products..." << endl;
+        tree.buildTreeFromReviews(leaves, reviewIds);
+    }
+
+    string getRootHash() const { return tree.getRootHash(); }
+    Digest getRootDigest() const { return tree.getRootDigest(); }
+    HashMode getHashMode() const { return tree.getHashMode(); }
+    size_t getLeafCount() const { return tree.getLeafCount(); }
+    size_t getProductCount() const { return productAsins.size(); }
+    const FlatMerkleTree& getTree() const { return tree; }
+
+    //leaf range of a product, empty (begin == end) at its sorted position if absent
+    void getProductRange(const string& asin, size_t& begin, size_t& end) const
+    {
+        auto it = lower_bound(productAsins.begin(), productAsins.end(), asin);
+        size_t product = static_cast<size_t>(it - productAsins.begin());
+        begin = productStarts.empty() ? 0 : productStarts[product];
+        end = (it != productAsins.end() && *it == asin) ? productStarts[product + 1] : begin;
+    }
+
+    //range proof over every review of asin, false if the tree is empty
+    bool generateProductProof(const string& asin, ProductRangeProof& result) const
+    {
+        result = ProductRangeProof();
+        result.asin = asin;
+        if (tree.getLeafCount() == 0) return false;
+
+        getProductRange(asin, result.begin, result.end);
+        result.hasLeftNeighbour = result.begin > 0;
+        result.hasRightNeighbour = result.end < tree.getLeafCount();
+
+        size_t first = result.begin - (result.hasLeftNeighbour ? 1 : 0);
+        size_t last = result.end + (result.hasRightNeighbour ? 1 : 0);
+
+        vector<string> reviewIds;
+        for (size_t leaf = first; leaf < last; leaf++)
+        {
+            result.leafData.push_back(leafData[leaf]);
+            reviewIds.push_back(string(tree.getLeafId(leaf)));
+        }
+
+        return MultiProofs::generate(tree, reviewIds, result.proof);
+    }
+
+    // check a range proof against a root: the leaves are contiguous, all of
+    // them carry asin in review id order, the neighbours (or the tree edges)
+    // bound the range, and the multiproof reproduces the root with every leaf
+    // at its claimed position
+    static bool verifyProductProof(const ProductRangeProof& result, const Digest& rootDigest,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        const MultiProof& proof = result.proof;
+        size_t left = result.hasLeftNeighbour ? 1 : 0;
+        size_t right = result.hasRightNeighbour ? 1 : 0;
+
+        if (result.begin > result.end || result.end > proof.leafCount) return false;
+        if (result.hasLeftNeighbour != (result.begin > 0)) return false;
+        if (result.hasRightNeighbour != (result.end < proof.leafCount)) return false;
+        if (result.leafData.size() != result.reviewCount() + left + right) return false;
+        if (proof.leafPositions.size() != result.leafData.size()) return false;
+
+        for (size_t i = 0; i < proof.leafPositions.size(); i++)
+        {
+            if (proof.leafPositions[i] != result.begin - left + i) return false;
+        }
+
+        string_view asin;
+        string_view previousId;
+        for (size_t i = left; i < left + result.reviewCount(); i++)
+        {
+            if (!Review::canonicalAsin(result.leafData[i], asin) || asin != result.asin) return false;
+            string_view reviewId = Review::canonicalReviewId(result.leafData[i]);
+            if (i > left && !(previousId < reviewId)) return false;
+            previousId = reviewId;
+        }
+
+        if (left == 1 && (!Review::canonicalAsin(result.leafData.front(), asin) || !(asin < string_view(result.asin)))) return false;
+        if (right == 1 && (!Review::canonicalAsin(result.leafData.back(), asin) || !(string_view(result.asin) < asin))) return false;
+
+        return MultiProofs::verifyPositioned(result.leafData, proof, rootDigest, mode);
+    }
+
+    static bool verifyProductProof(const ProductRangeProof& result, const string& rootHash,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        Digest rootDigest;
+        return digestFromHex(rootHash, rootDigest) && verifyProductProof(result, rootDigest, mode);
+    }
+};
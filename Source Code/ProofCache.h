@@ -0,0 +1,390 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Digest.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// proof cache
+// ========================
+// serves proofs for hot review ids of a FlatMerkleTree. every proof is split
+// at a fixed level: the steps below it are cached per review id in a fixed
+// size, 4-way set associative table (LRU within each set) sized from a byte
+// budget, the steps above it are read from one compact copy of the top levels
+// of the tree, which all proofs share. the id's fingerprint picks the set and
+// the id is stored in the entry, so a hit never touches the tree's id index:
+// one probe of four tags, then the entry and its siblings. a miss prefetches
+// all of its lower siblings before reading any of them. an id is only cached
+// on its second miss within a window (a one bit per slot doorkeeper), so the
+// long tail of one-off requests neither pays for an insert nor evicts hot
+// entries. ids longer than ID_BYTES are not cached.
+//
+// the cache never has to be told about changes. before each lookup it reads
+// the tree's change journal: a changed leaf drops only the cached entries in
+// its own subtree below the split level (the only ones whose lower steps can
+// contain a node on the changed path) and recopies the top nodes on that path.
+// a rebuild, a clear or a change in height starts the cache over.
+// not thread safe, and the tree must outlive the cache.
+class ProofCache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;       //replaced to make room
+        size_t invalidations = 0;   //dropped because their subtree changed
+        size_t entries = 0;
+        size_t tableBytes = 0;      //table and cached steps, at most the budget
+        size_t topBytes = 0;        //shared top levels, not part of the budget
+    };
+
+private:
+    static const size_t WAYS = 4;
+    static const size_t ID_BYTES = 48;
+
+    struct Way
+    {
+        uint64_t leaf;
+        uint64_t lastUse;
+        uint32_t generation;    //of the leaf's subtree when it was cached
+        uint32_t idLength;
+        char id[ID_BYTES];
+    };
+
+    const FlatMerkleTree* tree;
+    size_t budgetBytes;
+    size_t sharedLevels;
+
+    vector<uint64_t> tags;                 //id fingerprint per way, 0 = empty
+    vector<Way> ways;                      //setCount * WAYS
+    vector<Digest> lowerSiblings;          //splitLevel digests per way
+    vector<uint64_t> seenBits;             //doorkeeper, cleared when half full
+    size_t seenCount = 0;
+    size_t setCount = 0;
+    uint64_t useClock = 0;
+
+    vector<uint32_t> subtreeGenerations;   //one per subtree rooted at splitLevel
+    vector<vector<Digest>> topLevels;      //tree levels splitLevel .. height - 2
+
+    size_t height = 0;
+    size_t splitLevel = 0;
+    uint64_t syncedVersion = 0;
+    bool synced = false;
+    vector<size_t> changedLeaves;
+    Stats stats;
+
+    static void prefetch(const void* address)
+    {
+#ifdef SHA256_BATCH_X86
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
+    }
+
+    //copy nodes [begin, end) of a top level out of the tree
+    void copyTopNodes(size_t level, size_t begin, size_t end)
+    {
+        vector<Digest>& nodes = topLevels[level - splitLevel];
+        for (size_t index = begin; index < end; index++) nodes[index] = tree->getNode(level, index);
+    }
+
+    void resizeTopLevels()
+    {
+        stats.topBytes = 0;
+        for (size_t level = splitLevel; level + 1 < height; level++)
+        {
+            topLevels[level - splitLevel].resize(tree->getLevelSize(level));
+            stats.topBytes += tree->getLevelSize(level) * sizeof(Digest);
+        }
+    }
+
+    //size the table for the budget and the tree's current shape, drop every
+    //entry and recopy the top levels
+    void reset()
+    {
+        height = tree->getHeight();
+        splitLevel = (height > sharedLevels + 1) ? height - 1 - sharedLevels : 0;
+        topLevels.assign(height > splitLevel + 1 ? height - 1 - splitLevel : 0, vector<Digest>());
+        resizeTopLevels();
+        for (size_t level = splitLevel; level + 1 < height; level++)
+        {
+            copyTopNodes(level, 0, tree->getLevelSize(level));
+        }
+
+        //largest power of two number of sets within the budget, no more
+        //than needed to hold every leaf
+        size_t wayBytes = sizeof(uint64_t) + sizeof(Way) + splitLevel * sizeof(Digest) + 1;
+        size_t maxSets = (tree->getLeafCount() + WAYS - 1) / WAYS;
+        setCount = 0;
+        if (splitLevel > 0 && budgetBytes >= WAYS * wayBytes)
+        {
+            setCount = 1;
+            while (setCount < maxSets && 2 * setCount * WAYS * wayBytes <= budgetBytes) setCount *= 2;
+        }
+
+        tags.assign(setCount * WAYS, 0);
+        ways.assign(setCount * WAYS, Way());
+        lowerSiblings.assign(setCount * WAYS * splitLevel, Digest());
+        seenBits.assign(setCount * WAYS / 8 + 1, 0);
+        seenCount = 0;
+        subtreeGenerations.clear();
+        stats.entries = 0;
+        stats.tableBytes = ways.size() * wayBytes;
+    }
+
+    //catch up with changes made to the tree since the last lookup
+    void sync()
+    {
+        uint64_t version = tree->getVersion();
+        if (synced && version == syncedVersion) return;
+
+        if (!synced || tree->getHeight() != height || !tree->getChangedLeaves(syncedVersion, changedLeaves))
+        {
+            reset();
+        }
+        else
+        {
+            resizeTopLevels();
+
+            //many changes touch most of the top anyway, recopy it whole
+            size_t topNodes = stats.topBytes / sizeof(Digest);
+            bool recopyTop = changedLeaves.size() * topLevels.size() > topNodes;
+
+            for (size_t leaf : changedLeaves)
+            {
+                size_t subtree = leaf >> splitLevel;
+                if (subtree < subtreeGenerations.size()) subtreeGenerations[subtree]++;
+                if (recopyTop) continue;
+
+                for (size_t level = splitLevel; level + 1 < height; level++)
+                {
+                    size_t index = leaf >> level;
+                    if (index < topLevels[level - splitLevel].size()) copyTopNodes(level, index, index + 1);
+                }
+            }
+
+            if (recopyTop)
+            {
+                for (size_t level = splitLevel; level + 1 < height; level++)
+                {
+                    copyTopNodes(level, 0, tree->getLevelSize(level));
+                }
+            }
+        }
+
+        syncedVersion = version;
+        synced = true;
+    }
+
+    uint32_t generationOf(size_t leaf)
+    {
+        size_t subtree = leaf >> splitLevel;
+        if (subtree >= subtreeGenerations.size()) subtreeGenerations.resize(subtree + 1, 0);
+        return subtreeGenerations[subtree];
+    }
+
+    //read the siblings below splitLevel straight from the tree. all of them
+    //are prefetched first so the reads overlap
+    void walkLower(size_t leaf, vector<ProofStep>& out) const
+    {
+        size_t index = leaf;
+        for (size_t level = 0; level < splitLevel; level++, index /= 2)
+        {
+            size_t sibling = index ^ 1;
+            prefetch(&tree->getNode(level, sibling < tree->getLevelSize(level) ? sibling : index));
+        }
+
+        index = leaf;
+        for (size_t level = 0; level < splitLevel; level++, index /= 2)
+        {
+            size_t sibling = index ^ 1;
+            out[level].sibling = tree->getNode(level, sibling < tree->getLevelSize(level) ? sibling : index);
+        }
+    }
+
+    size_t firstWayOf(uint64_t tag) const { return (tag >> 1 & (setCount - 1)) * WAYS; }
+    size_t seenBitOf(uint64_t tag) const { return static_cast<size_t>(tag >> 24) % (seenBits.size() * 64); }
+
+    //cached siblings below splitLevel for reviewId, nullptr on a miss
+    const Digest* find(const string& reviewId, uint64_t tag, size_t& leaf)
+    {
+        if (setCount == 0) return nullptr;
+
+        size_t first = firstWayOf(tag);
+        for (size_t way = first; way < first + WAYS; way++)
+        {
+            if (tags[way] != tag) continue;
+
+            Way& entry = ways[way];
+            if (entry.idLength != reviewId.size() || memcmp(entry.id, reviewId.data(), reviewId.size()) != 0) continue;
+
+            if (entry.generation != generationOf(entry.leaf))
+            {
+                stats.invalidations++;
+                stats.entries--;
+                tags[way] = 0;
+                return nullptr;
+            }
+
+            stats.hits++;
+            entry.lastUse = ++useClock;
+            leaf = entry.leaf;
+            return &lowerSiblings[way * splitLevel];
+        }
+        return nullptr;
+    }
+
+    //store the walked siblings of a missed id in the least recently used way
+    //of its set
+    void insert(const string& reviewId, uint64_t tag, size_t leaf, const vector<ProofStep>& proof)
+    {
+        if (setCount == 0 || reviewId.size() > ID_BYTES) return;
+
+        //first miss only marks the id as seen
+        size_t bit = seenBitOf(tag);
+        uint64_t mask = 1ULL << (bit % 64);
+        if ((seenBits[bit / 64] & mask) == 0)
+        {
+            seenBits[bit / 64] |= mask;
+            if (++seenCount > seenBits.size() * 32)
+            {
+                fill(seenBits.begin(), seenBits.end(), 0);
+                seenCount = 0;
+            }
+            return;
+        }
+
+        size_t first = firstWayOf(tag);
+        size_t victim = first;
+        for (size_t way = first; way < first + WAYS; way++)
+        {
+            if (tags[way] == 0)
+            {
+                victim = way;
+                break;
+            }
+            if (ways[way].lastUse < ways[victim].lastUse) victim = way;
+        }
+
+        if (tags[victim] == 0) stats.entries++;
+        else stats.evictions++;
+
+        tags[victim] = tag;
+        Way& entry = ways[victim];
+        entry.leaf = leaf;
+        entry.lastUse = ++useClock;
+        entry.generation = generationOf(leaf);
+        entry.idLength = static_cast<uint32_t>(reviewId.size());
+        memcpy(entry.id, reviewId.data(), reviewId.size());
+        for (size_t level = 0; level < splitLevel; level++)
+        {
+            lowerSiblings[victim * splitLevel + level] = proof[level].sibling;
+        }
+    }
+
+    //append the shared steps above splitLevel for leaf
+    void appendTopSteps(size_t leaf, vector<ProofStep>& proof) const
+    {
+        size_t index = leaf >> splitLevel;
+        for (const vector<Digest>& nodes : topLevels)
+        {
+            ProofStep step;
+            step.siblingOnRight = (index % 2 == 0);
+            size_t sibling = step.siblingOnRight ? index + 1 : index - 1;
+            step.sibling = nodes[sibling < nodes.size() ? sibling : index];
+            proof.push_back(step);
+            index /= 2;
+        }
+    }
+
+public:
+    // budget bounds the per-review table; topLevelCount is how many levels
+    // below the root are kept in the shared copy (2^(topLevelCount+1) digests)
+    ProofCache(const FlatMerkleTree& source, size_t budget = 64 << 20, size_t topLevelCount = 16)
+        : tree(&source), budgetBytes(budget), sharedLevels(topLevelCount) {
+    }
+
+    // proof for reviewId as raw digests, leaf to root, identical to
+    // FlatMerkleTree::generateDigestProof. false if the id is unknown
+    bool getDigestProof(const string& reviewId, vector<ProofStep>& proof)
+    {
+        proof.clear();
+        sync();
+
+        uint64_t tag = LeafIndex::fingerprint(reviewId) | 1;
+        size_t leaf;
+        if (setCount > 0)
+        {
+            //a miss needs the doorkeeper too, start both loads together
+            prefetch(&tags[firstWayOf(tag)]);
+            prefetch(&seenBits[seenBitOf(tag) / 64]);
+        }
+        proof.reserve(height);
+        proof.resize(splitLevel);
+
+        const Digest* lower = find(reviewId, tag, leaf);
+        if (lower != nullptr)
+        {
+            for (size_t level = 0; level < splitLevel; level++) proof[level].sibling = lower[level];
+        }
+        else
+        {
+            if (!tree->findLeaf(reviewId, leaf))
+            {
+                proof.clear();
+                return false;
+            }
+            stats.misses++;
+            walkLower(leaf, proof);
+            insert(reviewId, tag, leaf, proof);
+        }
+
+        for (size_t level = 0; level < splitLevel; level++)
+        {
+            proof[level].siblingOnRight = ((leaf >> level) & 1) == 0;
+        }
+        appendTopSteps(leaf, proof);
+        return true;
+    }
+
+    // same in the MerkleTree string format, identical to FlatMerkleTree::generateProof
+    vector<string> getProof(const string& reviewId)
+    {
+        vector<string> proof;
+        vector<ProofStep> steps;
+        if (!getDigestProof(reviewId, steps)) return proof;
+
+        proof.reserve(2 * steps.size());
+        for (const ProofStep& step : steps)
+        {
+            proof.push_back(digestToHex(step.sibling));
+            proof.push_back(step.siblingOnRight ? "r" : "l");
+        }
+        return proof;
+    }
+
+    //change the budget, the table is rebuilt empty on the next lookup
+    void setBudget(size_t bytes)
+    {
+        budgetBytes = bytes;
+        synced = false;
+    }
+
+    //drop everything, the next lookup starts over
+    void clear() { synced = false; }
+
+    Stats getStats() const { return stats; }
+
+    double hitRate() const
+    {
+        size_t lookups = stats.hits + stats.misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(stats.hits) / lookups;
+    }
+};
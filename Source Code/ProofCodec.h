@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "Digest.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// binary proof format
+// ========================
+// packed form of a membership proof for storage and transfer. all integers
+// are little endian regardless of the machine, so the bytes are stable.
+//
+//   offset  size  field
+//   0       2     magic "MP"
+//   2       1     version (1)
+//   3       1     flags: bit 0 = RAW_DIGEST hash mode
+//   4       1     depth (number of siblings, at most 64)
+//   5       3     reserved, zero
+//   8       8     leaf index
+//   16      8     direction mask, bit i set = sibling i is on the right
+//   24      32*d  sibling digests, leaf to root
+//
+// a 23 level proof is 760 bytes in one buffer instead of 46 heap strings.
+// ProofView reads an encoded proof in place and verifying it allocates nothing.
+namespace ProofCodec
+{
+    const uint8_t MAGIC[2] = { 'M', 'P' };
+    const uint8_t VERSION = 1;
+    const size_t HEADER_SIZE = 24;
+    const size_t MAX_DEPTH = 64;
+
+    inline void writeUint64(uint8_t* out, uint64_t value)
+    {
+        for (int i = 0; i < 8; i++) out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    inline uint64_t readUint64(const uint8_t* in)
+    {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--) value = (value << 8) | in[i];
+        return value;
+    }
+
+    inline size_t encodedSize(size_t depth) { return HEADER_SIZE + depth * 32; }
+
+    //zero-copy view of an encoded proof, valid while the buffer lives
+    struct ProofView
+    {
+        const uint8_t* siblingData = nullptr;
+        size_t depth = 0;
+        uint64_t leafIndex = 0;
+        uint64_t directions = 0;
+        HashMode mode = HashMode::HEX_COMPAT;
+
+        bool siblingOnRight(size_t step) const { return ((directions >> step) & 1) != 0; }
+
+        void sibling(size_t step, Digest& out) const { memcpy(out.data(), siblingData + 32 * step, 32); }
+    };
+
+    //append the encoding of a digest proof to out, false if it is too deep
+    inline bool encode(const vector<ProofStep>& steps, uint64_t leafIndex, HashMode mode, vector<uint8_t>& out)
+    {
+        if (steps.size() > MAX_DEPTH) return false;
+
+        size_t start = out.size();
+        out.resize(start + encodedSize(steps.size()));
+        uint8_t* header = &out[start];
+
+        uint64_t directions = 0;
+        for (size_t i = 0; i < steps.size(); i++)
+        {
+            if (steps[i].siblingOnRight) directions |= (1ULL << i);
+            memcpy(header + HEADER_SIZE + 32 * i, steps[i].sibling.data(), 32);
+        }
+
+        header[0] = MAGIC[0];
+        header[1] = MAGIC[1];
+        header[2] = VERSION;
+        header[3] = (mode == HashMode::RAW_DIGEST) ? 1 : 0;
+        header[4] = static_cast<uint8_t>(steps.size());
+        header[5] = header[6] = header[7] = 0;
+        writeUint64(header + 8, leafIndex);
+        writeUint64(header + 16, directions);
+        return true;
+    }
+
+    //encode a MerkleTree style proof (hex sibling, "l"/"r" pairs). the leaf
+    //index follows from the directions: a left sibling means an odd index
+    inline bool encode(const vector<string>& proof, HashMode mode, vector<uint8_t>& out)
+    {
+        if (proof.size() % 2 != 0 || proof.size() / 2 > MAX_DEPTH) return false;
+
+        vector<ProofStep> steps(proof.size() / 2);
+        uint64_t leafIndex = 0;
+        for (size_t i = 0; i < steps.size(); i++)
+        {
+            if (!digestFromHex(proof[2 * i], steps[i].sibling)) return false;
+            steps[i].siblingOnRight = (proof[2 * i + 1] == "r");
+            if (!steps[i].siblingOnRight) leafIndex |= (1ULL << i);
+        }
+        return encode(steps, leafIndex, mode, out);
+    }
+
+    //encode the proof of a review in a flat tree, false if the id is unknown
+    inline bool encode(const FlatMerkleTree& tree, const string& reviewId, vector<uint8_t>& out)
+    {
+        size_t leaf;
+        if (!tree.findLeaf(reviewId, leaf)) return false;
+        return encode(tree.generateDigestProof(reviewId), leaf, tree.getHashMode(), out);
+    }
+
+    //check the header and length of an encoded proof and map it into view
+    inline bool parse(const uint8_t* data, size_t size, ProofView& view)
+    {
+        if (size < HEADER_SIZE) return false;
+        if (data[0] != MAGIC[0] || data[1] != MAGIC[1] || data[2] != VERSION) return false;
+        if ((data[3] & ~1) != 0 || data[5] != 0 || data[6] != 0 || data[7] != 0) return false;
+
+        size_t depth = data[4];
+        if (depth > MAX_DEPTH || size != encodedSize(depth)) return false;
+
+        view.mode = (data[3] & 1) ? HashMode::RAW_DIGEST : HashMode::HEX_COMPAT;
+        view.depth = depth;
+        view.leafIndex = readUint64(data + 8);
+        view.directions = readUint64(data + 16);
+        view.siblingData = data + HEADER_SIZE;
+
+        //directions must agree with the leaf index: a node at an odd position
+        //has its sibling on the left, at an even one on the right (itself for
+        //the last node of an odd sized level)
+        for (size_t i = 0; i < depth; i++)
+        {
+            bool oddPosition = ((view.leafIndex >> i) & 1) != 0;
+            if (oddPosition && view.siblingOnRight(i)) return false;
+            if (!oddPosition && !view.siblingOnRight(i)) return false;
+        }
+        return depth == MAX_DEPTH || (view.leafIndex >> depth) == 0;
+    }
+
+    inline bool parse(const vector<uint8_t>& encoded, ProofView& view)
+    {
+        return parse(encoded.data(), encoded.size(), view);
+    }
+
+    // verify a parsed proof, no heap allocation
+    inline bool verify(const ProofView& view, const string& reviewData, const Digest& rootDigest)
+    {
+        if (view.depth == 0) return false;
+
+        SHA256 hasher;
+        Digest current;
+        Digest sibling;
+        hashToDigest(hasher, reviewData.data(), reviewData.size(), current);
+
+        for (size_t step = 0; step < view.depth; step++)
+        {
+            view.sibling(step, sibling);
+            combineDigests(hasher, current, sibling, view.mode, current);
+        }
+
+        return current == rootDigest;
+    }
+
+    // parse and verify an encoded proof in one call
+    inline bool verify(const uint8_t* data, size_t size, const string& reviewData, const Digest& rootDigest)
+    {
+        ProofView view;
+        return parse(data, size, view) && verify(view, reviewData, rootDigest);
+    }
+
+    //back to the MerkleTree string format
+    inline void decode(const ProofView& view, vector<string>& proof)
+    {
+        proof.clear();
+        proof.reserve(2 * view.depth);
+        Digest sibling;
+        for (size_t step = 0; step < view.depth; step++)
+        {
+            view.sibling(step, sibling);
+            proof.push_back(digestToHex(sibling));
+            proof.push_back(view.siblingOnRight(step) ? "r" : "l");
+        }
+    }
+}
@@ -0,0 +1,641 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include "Digest.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SHA256_BATCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//gcc/clang need the instruction set enabled per function, msvc does not
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SHA256_TARGET(isa)
+#else
+#define SHA256_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+using namespace std;
+
+// ========================
+// batched sha-256
+// ========================
+// hashes many independent messages at once. the AVX2 and AVX-512 kernels run
+// 8 / 16 messages in parallel, one per 32-bit SIMD lane, and refill a lane as
+// soon as its message finishes so mixed lengths keep every lane busy. SHA-NI
+// hashes one message at a time but with the dedicated instructions. the best
+// kernel the cpu supports is picked at runtime, scalar code is the fallback.
+class SHA256Batch
+{
+public:
+    enum class Kernel
+    {
+        AUTO,
+        SCALAR,
+        SHA_NI,
+        AVX2,
+        AVX512
+    };
+
+private:
+    typedef void (*LaneCompressFn)(uint32_t* state, const uint8_t* const* blocks);
+
+    //state of one message being fed block by block into a lane
+    struct LaneCursor
+    {
+        const uint8_t* data;
+        size_t fullBlocks;
+        size_t totalBlocks;
+        size_t block;
+        size_t message;
+        uint8_t tail[128];
+    };
+
+    static const uint32_t* roundConstants()
+    {
+        alignas(16) static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+        return K;
+    }
+
+    static const uint32_t* initialState()
+    {
+        static const uint32_t IV[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        return IV;
+    }
+
+    static uint32_t loadBigEndian(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    static uint32_t rotateRight(uint32_t x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    //set up padding for a message, the last one or two blocks live in tail
+    static void startMessage(LaneCursor& cursor, const uint8_t* data, size_t length, size_t message)
+    {
+        size_t remaining = length % 64;
+        size_t tailBlocks = (remaining + 9 <= 64) ? 1 : 2;
+
+        cursor.data = data;
+        cursor.fullBlocks = length / 64;
+        cursor.totalBlocks = cursor.fullBlocks + tailBlocks;
+        cursor.block = 0;
+        cursor.message = message;
+
+        memset(cursor.tail, 0, sizeof(cursor.tail));
+        if (remaining > 0) memcpy(cursor.tail, data + 64 * cursor.fullBlocks, remaining);
+        cursor.tail[remaining] = 0x80;
+
+        uint64_t bits = static_cast<uint64_t>(length) * 8;
+        uint8_t* end = cursor.tail + 64 * tailBlocks;
+        for (int i = 1; i <= 8; i++)
+        {
+            end[-i] = static_cast<uint8_t>(bits >> (8 * (i - 1)));
+        }
+    }
+
+    static const uint8_t* currentBlock(const LaneCursor& cursor)
+    {
+        return cursor.block < cursor.fullBlocks
+            ? cursor.data + 64 * cursor.block
+            : cursor.tail + 64 * (cursor.block - cursor.fullBlocks);
+    }
+
+    static void storeDigest(const uint32_t* state, size_t stride, Digest& out)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            uint32_t word = state[i * stride];
+            out[4 * i] = static_cast<uint8_t>(word >> 24);
+            out[4 * i + 1] = static_cast<uint8_t>(word >> 16);
+            out[4 * i + 2] = static_cast<uint8_t>(word >> 8);
+            out[4 * i + 3] = static_cast<uint8_t>(word);
+        }
+    }
+
+    // ------------------------
+    // scalar kernel
+    // ------------------------
+    static void compressScalar(uint32_t* state, const uint8_t* block)
+    {
+        const uint32_t* K = roundConstants();
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; i++) w[i] = loadBigEndian(block + 4 * i);
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t S1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + S1 + ch + K[i] + w[i];
+            uint32_t S0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = S0 + maj;
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+#ifdef SHA256_BATCH_X86
+    // ------------------------
+    // SHA-NI kernel (one message, hardware rounds)
+    // ------------------------
+    SHA256_TARGET("sha,sse4.1,ssse3")
+    static void compressShaNi(uint32_t* state, const uint8_t* block)
+    {
+        const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        const uint32_t* K = roundConstants();
+
+        __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+        __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+        tmp = _mm_shuffle_epi32(tmp, 0xB1);
+        state1 = _mm_shuffle_epi32(state1, 0x1B);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i msgs[4];
+
+        for (int g = 0; g < 16; g++)
+        {
+            if (g < 4)
+            {
+                msgs[g] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * g)), MASK);
+            }
+
+            __m128i current = msgs[g & 3];
+            __m128i msg = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(K + 4 * g)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+            if (g >= 3 && g <= 14)
+            {
+                __m128i& next = msgs[(g + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, msgs[(g + 3) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+            if (g >= 1 && g <= 12)
+            {
+                msgs[(g + 3) & 3] = _mm_sha256msg1_epu32(msgs[(g + 3) & 3], current);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B);
+        state1 = _mm_shuffle_epi32(state1, 0xB1);
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+        state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+    }
+
+    // ------------------------
+    // AVX2 kernel, 8 lanes. state is word-major: state[word * 8 + lane]
+    // ------------------------
+    SHA256_TARGET("avx2")
+    static __m256i rotr256(__m256i x, int n)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    SHA256_TARGET("avx2")
+    static void compressAvx2(uint32_t* state, const uint8_t* const* blocks)
+    {
+        const uint32_t* K = roundConstants();
+        alignas(32) uint32_t words[16][8];
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            for (int t = 0; t < 16; t++) words[t][lane] = loadBigEndian(blocks[lane] + 4 * t);
+        }
+
+        __m256i w[16];
+        for (int t = 0; t < 16; t++) w[t] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[t]));
+
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 0));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 8));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 16));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 24));
+        __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 32));
+        __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 40));
+        __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 48));
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 56));
+        __m256i a0 = a, b0 = b, c0 = c, d0 = d, e0 = e, f0 = f, g0 = g, h0 = h;
+
+        for (int i = 0; i < 64; i++)
+        {
+            if (i >= 16)
+            {
+                __m256i w15 = w[(i - 15) & 15];
+                __m256i w2 = w[(i - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr256(w15, 7), rotr256(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr256(w2, 17), rotr256(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+            }
+
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr256(e, 6), rotr256(e, 11)), rotr256(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, w[i & 15]));
+            t1 = _mm256_add_epi32(t1, _mm256_set1_epi32(static_cast<int>(K[i])));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr256(a, 2), rotr256(a, 13)), rotr256(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(S0, maj);
+
+            h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 0), _mm256_add_epi32(a, a0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 8), _mm256_add_epi32(b, b0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 16), _mm256_add_epi32(c, c0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 24), _mm256_add_epi32(d, d0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 32), _mm256_add_epi32(e, e0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 40), _mm256_add_epi32(f, f0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 48), _mm256_add_epi32(g, g0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + 56), _mm256_add_epi32(h, h0));
+    }
+
+    // ------------------------
+    // AVX-512 kernel, 16 lanes. state[word * 16 + lane]
+    // ------------------------
+#if defined(__GNUC__) && !defined(__clang__)
+    //gcc 12 flags the intentionally undefined passthrough inside its own intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    SHA256_TARGET("avx512f")
+    static void compressAvx512(uint32_t* state, const uint8_t* const* blocks)
+    {
+        const uint32_t* K = roundConstants();
+        alignas(64) uint32_t words[16][16];
+
+        for (int lane = 0; lane < 16; lane++)
+        {
+            for (int t = 0; t < 16; t++) words[t][lane] = loadBigEndian(blocks[lane] + 4 * t);
+        }
+
+        __m512i w[16];
+        for (int t = 0; t < 16; t++) w[t] = _mm512_load_si512(words[t]);
+
+        __m512i a = _mm512_loadu_si512(state + 0);
+        __m512i b = _mm512_loadu_si512(state + 16);
+        __m512i c = _mm512_loadu_si512(state + 32);
+        __m512i d = _mm512_loadu_si512(state + 48);
+        __m512i e = _mm512_loadu_si512(state + 64);
+        __m512i f = _mm512_loadu_si512(state + 80);
+        __m512i g = _mm512_loadu_si512(state + 96);
+        __m512i h = _mm512_loadu_si512(state + 112);
+        __m512i a0 = a, b0 = b, c0 = c, d0 = d, e0 = e, f0 = f, g0 = g, h0 = h;
+
+        for (int i = 0; i < 64; i++)
+        {
+            if (i >= 16)
+            {
+                __m512i w15 = w[(i - 15) & 15];
+                __m512i w2 = w[(i - 2) & 15];
+                __m512i s0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18)), _mm512_srli_epi32(w15, 3));
+                __m512i s1 = _mm512_xor_si512(_mm512_xor_si512(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19)), _mm512_srli_epi32(w2, 10));
+                w[i & 15] = _mm512_add_epi32(_mm512_add_epi32(w[i & 15], s0), _mm512_add_epi32(w[(i - 7) & 15], s1));
+            }
+
+            __m512i S1 = _mm512_xor_si512(_mm512_xor_si512(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11)), _mm512_ror_epi32(e, 25));
+            __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, S1), _mm512_add_epi32(ch, w[i & 15]));
+            t1 = _mm512_add_epi32(t1, _mm512_set1_epi32(static_cast<int>(K[i])));
+            __m512i S0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13)), _mm512_ror_epi32(a, 22));
+            __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+            __m512i t2 = _mm512_add_epi32(S0, maj);
+
+            h = g; g = f; f = e; e = _mm512_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm512_add_epi32(t1, t2);
+        }
+
+        _mm512_storeu_si512(state + 0, _mm512_add_epi32(a, a0));
+        _mm512_storeu_si512(state + 16, _mm512_add_epi32(b, b0));
+        _mm512_storeu_si512(state + 32, _mm512_add_epi32(c, c0));
+        _mm512_storeu_si512(state + 48, _mm512_add_epi32(d, d0));
+        _mm512_storeu_si512(state + 64, _mm512_add_epi32(e, e0));
+        _mm512_storeu_si512(state + 80, _mm512_add_epi32(f, f0));
+        _mm512_storeu_si512(state + 96, _mm512_add_epi32(g, g0));
+        _mm512_storeu_si512(state + 112, _mm512_add_epi32(h, h0));
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    // ------------------------
+    // cpu feature detection
+    // ------------------------
+    static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+    {
+#if defined(_MSC_VER)
+        int out[4];
+        __cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; i++) regs[i] = static_cast<uint32_t>(out[i]);
+#else
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+        __get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+    }
+
+    //which register state the os saves on context switch
+    static uint64_t enabledXState()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+#endif
+
+    // ------------------------
+    // drivers
+    // ------------------------
+
+    //feed messages through a multi-lane kernel, refilling lanes as they finish
+    static void hashLanes(size_t lanes, LaneCompressFn compress,
+        const uint8_t* const* messages, const size_t* lengths, Digest* out, size_t count)
+    {
+        static const uint8_t idleBlock[64] = {};
+        const size_t idle = static_cast<size_t>(-1);
+
+        LaneCursor cursors[16];
+        uint32_t state[8 * 16];
+        const uint8_t* blocks[16];
+        const uint32_t* IV = initialState();
+
+        size_t next = 0;
+        size_t active = 0;
+
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            cursors[lane].message = idle;
+            if (next < count)
+            {
+                startMessage(cursors[lane], messages[next], lengths[next], next);
+                for (int i = 0; i < 8; i++) state[i * lanes + lane] = IV[i];
+                next++;
+                active++;
+            }
+        }
+
+        while (active > 0)
+        {
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                blocks[lane] = (cursors[lane].message == idle) ? idleBlock : currentBlock(cursors[lane]);
+            }
+
+            compress(state, blocks);
+
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                LaneCursor& cursor = cursors[lane];
+                if (cursor.message == idle || ++cursor.block < cursor.totalBlocks) continue;
+
+                storeDigest(state + lane, lanes, out[cursor.message]);
+
+                if (next < count)
+                {
+                    startMessage(cursor, messages[next], lengths[next], next);
+                    for (int i = 0; i < 8; i++) state[i * lanes + lane] = IV[i];
+                    next++;
+                }
+                else
+                {
+                    cursor.message = idle;
+                    active--;
+                }
+            }
+        }
+    }
+
+    //one message at a time with a single-block kernel
+    static void hashSequential(void (*compress)(uint32_t*, const uint8_t*),
+        const uint8_t* const* messages, const size_t* lengths, Digest* out, size_t count)
+    {
+        LaneCursor cursor;
+        uint32_t state[8];
+
+        for (size_t m = 0; m < count; m++)
+        {
+            startMessage(cursor, messages[m], lengths[m], m);
+            memcpy(state, initialState(), sizeof(state));
+
+            for (; cursor.block < cursor.totalBlocks; cursor.block++)
+            {
+                compress(state, currentBlock(cursor));
+            }
+
+            storeDigest(state, 1, out[m]);
+        }
+    }
+
+    //cpuid/xgetbv check behind isSupported
+    static bool detectSupport(Kernel kernel)
+    {
+        if (kernel == Kernel::AUTO || kernel == Kernel::SCALAR) return true;
+
+#ifdef SHA256_BATCH_X86
+        uint32_t leaf1[4], leaf7[4];
+        cpuid(0, 0, leaf1);
+        if (leaf1[0] < 7) return false;
+        cpuid(1, 0, leaf1);
+        cpuid(7, 0, leaf7);
+
+        bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+        uint64_t xstate = osxsave ? enabledXState() : 0;
+        bool avxState = (xstate & 0x6) == 0x6;
+        bool avx512State = avxState && (xstate & 0xE0) == 0xE0;
+
+        switch (kernel)
+        {
+        case Kernel::SHA_NI:
+            return (leaf7[1] & (1u << 29)) && (leaf1[2] & (1u << 19)) && (leaf1[2] & (1u << 9));
+        case Kernel::AVX2:
+            return avxState && (leaf7[1] & (1u << 5));
+        case Kernel::AVX512:
+            return avx512State && (leaf7[1] & (1u << 16));
+        default:
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+public:
+    //true if this cpu and os can run the kernel. detected once per kernel,
+    //hashMessages asks on every call
+    static bool isSupported(Kernel kernel)
+    {
+        static const bool supported[] = {
+            detectSupport(Kernel::AUTO), detectSupport(Kernel::SCALAR), detectSupport(Kernel::SHA_NI),
+            detectSupport(Kernel::AVX2), detectSupport(Kernel::AVX512)
+        };
+        return supported[static_cast<int>(kernel)];
+    }
+
+    //widest kernel available, detected once
+    static Kernel bestKernel()
+    {
+        static const Kernel best = []()
+            {
+                if (isSupported(Kernel::AVX512)) return Kernel::AVX512;
+                if (isSupported(Kernel::SHA_NI)) return Kernel::SHA_NI;
+                if (isSupported(Kernel::AVX2)) return Kernel::AVX2;
+                return Kernel::SCALAR;
+            }();
+        return best;
+    }
+
+    static const char* kernelName(Kernel kernel)
+    {
+        switch (kernel == Kernel::AUTO ? bestKernel() : kernel)
+        {
+        case Kernel::SHA_NI: return "SHA-NI";
+        case Kernel::AVX2: return "AVX2 x8";
+        case Kernel::AVX512: return "AVX-512 x16";
+        default: return "scalar";
+        }
+    }
+
+    //hash count messages into out[0..count)
+    static void hashMessages(const uint8_t* const* messages, const size_t* lengths,
+        Digest* out, size_t count, Kernel kernel = Kernel::AUTO)
+    {
+        if (kernel == Kernel::AUTO) kernel = bestKernel();
+        if (!isSupported(kernel)) kernel = Kernel::SCALAR;
+
+#ifdef SHA256_BATCH_X86
+        //a lone message does not fill the lanes, hash it directly
+        if (count == 1 && (kernel == Kernel::AVX2 || kernel == Kernel::AVX512))
+        {
+            kernel = isSupported(Kernel::SHA_NI) ? Kernel::SHA_NI : Kernel::SCALAR;
+        }
+
+        switch (kernel)
+        {
+        case Kernel::SHA_NI:
+            hashSequential(compressShaNi, messages, lengths, out, count);
+            return;
+        case Kernel::AVX2:
+            hashLanes(8, compressAvx2, messages, lengths, out, count);
+            return;
+        case Kernel::AVX512:
+            hashLanes(16, compressAvx512, messages, lengths, out, count);
+            return;
+        default:
+            break;
+        }
+#endif
+        hashSequential(compressScalar, messages, lengths, out, count);
+    }
+
+    //hash data[begin..end) into out[0..end-begin)
+    static void hashStrings(const vector<string>& data, size_t begin, size_t end,
+        Digest* out, Kernel kernel = Kernel::AUTO)
+    {
+        const size_t group = 64;
+        const uint8_t* messages[group];
+        size_t lengths[group];
+
+        for (size_t i = begin; i < end; i += group)
+        {
+            size_t n = min(group, end - i);
+            for (size_t j = 0; j < n; j++)
+            {
+                messages[j] = reinterpret_cast<const uint8_t*>(data[i + j].data());
+                lengths[j] = data[i + j].size();
+            }
+            hashMessages(messages, lengths, out + (i - begin), n, kernel);
+        }
+    }
+
+    //parents [begin, end) of one tree level, odd last child paired with itself.
+    //every message is the same size (64 raw or 128 hex bytes), the best case
+    //for lane parallel hashing
+    static void combineLevel(const vector<Digest>& children, size_t begin, size_t end,
+        HashMode mode, Digest* out, Kernel kernel = Kernel::AUTO)
+    {
+        const size_t group = 64;
+        uint8_t buffers[group][128];
+        const uint8_t* messages[group];
+        size_t lengths[group];
+        size_t messageSize = (mode == HashMode::RAW_DIGEST) ? 64 : 128;
+
+        for (size_t i = begin; i < end; i += group)
+        {
+            size_t n = min(group, end - i);
+            for (size_t j = 0; j < n; j++)
+            {
+                size_t left = 2 * (i + j);
+                size_t right = (left + 1 < children.size()) ? left + 1 : left;
+                writePair(children[left], children[right], mode, buffers[j]);
+                messages[j] = buffers[j];
+                lengths[j] = messageSize;
+            }
+            hashMessages(messages, lengths, out + (i - begin), n, kernel);
+        }
+    }
+
+    //lay out the combine input for two children in sorted order
+    static void writePair(const Digest& a, const Digest& b, HashMode mode, uint8_t* buffer)
+    {
+        const Digest& first = digestLess(b, a) ? b : a;
+        const Digest& second = (&first == &a) ? b : a;
+
+        if (mode == HashMode::RAW_DIGEST)
+        {
+            memcpy(buffer, first.data(), 32);
+            memcpy(buffer + 32, second.data(), 32);
+        }
+        else
+        {
+            writeDigestHex(first, reinterpret_cast<char*>(buffer));
+            writeDigestHex(second, reinterpret_cast<char*>(buffer) + 64);
+        }
+    }
+};
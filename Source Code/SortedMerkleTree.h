@@ -0,0 +1,143 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <numeric>
+#include "DataPreprocessor.h"
+#include "FlatMerkleTree.h"
+#include "MultiProof.h"
+
+using namespace std;
+
+//evidence that a review id is not in a sorted tree: the one or two adjacent
+//leaves whose ids bracket it. at the ends of the tree only the first or last
+//leaf is needed
+struct NonMembershipProof
+{
+    string reviewId;
+    bool hasLower = false;     //leaf with the largest id below reviewId
+    bool hasUpper = false;     //leaf with the smallest id above reviewId
+    vector<string> leafData;   //canonical data of the bracketing leaves, lower first
+    MultiProof proof;
+};
+
+// ========================
+// sorted merkle tree
+// ========================
+// FlatMerkleTree whose leaves are sorted by review id. a present review is
+// proven with a normal inclusion proof; an absent one by proving the two
+// neighbouring leaves its id would sit between. the verifier reads the ids
+// from the leaf data itself, so the answer "never in the published dataset"
+// needs only the root, never the dataset. leaves are hashed with their
+// position (MultiProofs::positionedLeaf), otherwise a proof could move the
+// lower neighbour into the slot of the review it hides. roots differ from file
+// ordered trees.
+class SortedMerkleTree
+{
+private:
+    FlatMerkleTree tree;
+    vector<string> leafData; //canonical data in leaf order
+
+public:
+    SortedMerkleTree(HashMode mode = HashMode::HEX_COMPAT) : tree(mode) {}
+
+    //sort reviews by id and build the tree over them
+    void buildFromReviews(const vector<Review>& reviews)
+    {
+        vector<size_t> order(reviews.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) { return reviews[a].reviewID < reviews[b].reviewID; });
+
+        leafData.assign(reviews.size(), string());
+        vector<string> reviewIds(reviews.size());
+        for (size_t leaf = 0; leaf < order.size(); leaf++)
+        {
+            const Review& review = reviews[order[leaf]];
+            leafData[leaf].reserve(review.canonicalSize());
+            review.appendCanonical(leafData[leaf]);
+            reviewIds[leaf] = review.getUniqueID();
+        }
+
+        vector<string> leaves(leafData.size());
+        for (size_t leaf = 0; leaf < leaves.size(); leaf++)
+        {
+            leaves[leaf] = MultiProofs::positionedLeaf(leaf, leafData[leaf]);
+        }
+
+        cout << "building id sorted tree..." << endl;
+        tree.buildTreeFromReviews(leaves, reviewIds);
+    }
+
+    string getRootHash() const { return tree.getRootHash(); }
+    Digest getRootDigest() const { return tree.getRootDigest(); }
+    HashMode getHashMode() const { return tree.getHashMode(); }
+    size_t getLeafCount() const { return tree.getLeafCount(); }
+    bool contains(const string& reviewId) const { return tree.contains(reviewId); }
+    const FlatMerkleTree& getTree() const { return tree; }
+
+    // inclusion proof for a present review, same format as MerkleTree. the
+    // leaf it proves is MultiProofs::positionedLeaf(position, review data),
+    // position from getTree().findLeaf
+    vector<string> generateProof(const string& reviewId) const { return tree.generateProof(reviewId); }
+
+    // proof that reviewId is absent. false if it is present or the tree is empty
+    bool generateNonMembershipProof(const string& reviewId, NonMembershipProof& result) const
+    {
+        result = NonMembershipProof();
+        result.reviewId = reviewId;
+        if (leafData.empty() || tree.contains(reviewId)) return false;
+
+        //first leaf whose id is above reviewId
+        size_t upper = static_cast<size_t>(partition_point(leafData.begin(), leafData.end(),
+            [&](const string& data) { return Review::canonicalReviewId(data) < string_view(reviewId); }) - leafData.begin());
+
+        result.hasLower = upper > 0;
+        result.hasUpper = upper < leafData.size();
+
+        vector<string> reviewIds;
+        for (size_t leaf = upper - (result.hasLower ? 1 : 0); leaf < upper + (result.hasUpper ? 1 : 0); leaf++)
+        {
+            result.leafData.push_back(leafData[leaf]);
+            reviewIds.push_back(string(tree.getLeafId(leaf)));
+        }
+
+        return MultiProofs::generate(tree, reviewIds, result.proof);
+    }
+
+    // check an absence proof against a root: the bracketing leaves are
+    // adjacent (or the first/last leaf), their ids are strictly below and
+    // above reviewId, and they are in the tree at those positions
+    static bool verifyNonMembershipProof(const NonMembershipProof& result, const Digest& rootDigest,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        const MultiProof& proof = result.proof;
+        size_t expected = (result.hasLower ? 1 : 0) + (result.hasUpper ? 1 : 0);
+        if (expected == 0 || result.leafData.size() != expected || proof.leafPositions.size() != expected) return false;
+
+        string_view reviewId(result.reviewId);
+        if (result.hasLower)
+        {
+            string_view lower = Review::canonicalReviewId(result.leafData.front());
+            if (lower.empty() || !(lower < reviewId)) return false;
+            if (!result.hasUpper && proof.leafPositions[0] + 1 != proof.leafCount) return false;
+        }
+        if (result.hasUpper)
+        {
+            string_view upper = Review::canonicalReviewId(result.leafData.back());
+            if (upper.empty() || !(reviewId < upper)) return false;
+            if (!result.hasLower && proof.leafPositions[0] != 0) return false;
+        }
+        if (expected == 2 && proof.leafPositions[1] != proof.leafPositions[0] + 1) return false;
+
+        return MultiProofs::verifyPositioned(result.leafData, proof, rootDigest, mode);
+    }
+
+    static bool verifyNonMembershipProof(const NonMembershipProof& result, const string& rootHash,
+        HashMode mode = HashMode::HEX_COMPAT)
+    {
+        Digest rootDigest;
+        return digestFromHex(rootHash, rootDigest) && verifyNonMembershipProof(result, rootDigest, mode);
+    }
+};
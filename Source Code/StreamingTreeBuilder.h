@@ -0,0 +1,229 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "DataPreprocessor.h"
+#include "FlatMerkleTree.h"
+#include "MappedFile.h"
+#include "JsonLineScanner.h"
+#include "SHA256Batch.h"
+#include "ParallelUtils.h"
+
+using namespace std;
+
+// ========================
+// streaming tree builder
+// ========================
+// builds a FlatMerkleTree straight from a json-lines file without keeping the
+// reviews around. records flow parse -> canonical string -> leaf hash -> tree
+// in batches of batchSize: while one batch is hashed on worker threads the
+// next one is parsed, and once a batch is hashed only its 32-byte digests and
+// ids are kept. duplicate removal, maxRecords and record order are the same as
+// DataPreprocessor::loadFromJSON so the root matches the load-then-build path.
+class StreamingTreeBuilder
+{
+private:
+    //one batch in flight: canonical strings, ids and their hashes. the
+    //canonical buffers are kept between batches and only the first
+    //reviewIds.size() of them are in use
+    struct Batch
+    {
+        vector<string> reviewData;
+        vector<string> reviewIds;
+        unordered_set<string_view> idSet; //views into reviewIds, which never reallocates
+        vector<Digest> digests;
+
+        void reset(size_t capacity)
+        {
+            reviewIds.clear();
+            idSet.clear();
+            reviewIds.reserve(capacity);
+        }
+
+        //next canonical buffer, emptied but keeping its capacity
+        string& nextData()
+        {
+            if (reviewData.size() <= reviewIds.size()) reviewData.emplace_back();
+            string& buffer = reviewData[reviewIds.size()];
+            buffer.clear();
+            return buffer;
+        }
+    };
+
+    MappedFile file;
+    size_t batchSize;
+    unsigned threadCount;
+    bool keepOffsets;
+    vector<uint64_t> sourceOffsets;
+    int recordCount;
+    int duplicatesRemoved;
+
+    //hash every canonical string of the batch across threads
+    void hashBatch(Batch& batch) const
+    {
+        batch.digests.resize(batch.reviewIds.size());
+        parallelFor(batch.reviewIds.size(), threadCount, [&](size_t begin, size_t end)
+            {
+                SHA256Batch::hashStrings(batch.reviewData, begin, end, &batch.digests[begin]);
+            }, 256);
+    }
+
+public:
+    StreamingTreeBuilder(size_t batch = 65536, unsigned threads = 0)
+        : batchSize(batch > 0 ? batch : 1), threadCount(threads), keepOffsets(false),
+        recordCount(0), duplicatesRemoved(0) {
+    }
+
+    //remember the byte offset of every leaf's source line (8 bytes per leaf)
+    void setKeepSourceOffsets(bool keep) { keepOffsets = keep; }
+
+    //stream filename into tree, false if the file cannot be opened
+    bool build(const string& filename, int maxRecords, FlatMerkleTree& tree)
+    {
+        if (!file.open(filename))
+        {
+            cout << "Could not open file " << filename << endl;
+            return false;
+        }
+
+        tree.clear();
+        sourceOffsets.clear();
+        recordCount = 0;
+        duplicatesRemoved = 0;
+
+        bool overlap = resolveThreadCount(threadCount) > 1;
+        cout << "Streaming reviews from " << filename << " in batches of " << batchSize << endl;
+        auto start = chrono::high_resolution_clock::now();
+
+        Batch batches[2];
+        Batch* parsing = &batches[0];
+        Batch* hashing = &batches[1];
+        parsing->reset(batchSize);
+        hashing->reset(batchSize);
+        thread worker;
+        bool hashingPending = false;
+
+        JsonLineScanner scanner;
+        vector<Review> scratch;
+        string errorMessage;
+
+        const char* cursor = file.data();
+        const char* fileEnd = file.data() + file.size();
+        bool stop = false;
+
+        while (!stop)
+        {
+            //parse up to batchSize accepted records
+            while (cursor < fileEnd && parsing->reviewIds.size() < batchSize)
+            {
+                const char* lineStart = cursor;
+                const char* newline = static_cast<const char*>(memchr(cursor, '\n', fileEnd - cursor));
+                const char* lineEnd = newline ? newline : fileEnd;
+                cursor = newline ? newline + 1 : fileEnd;
+
+                scratch.clear();
+                DataPreprocessor::LineStatus status = DataPreprocessor::parseReviewLine(
+                    string_view(lineStart, static_cast<size_t>(lineEnd - lineStart)), scanner, scratch, errorMessage);
+                if (status == DataPreprocessor::LineStatus::PARSE_ERROR)
+                {
+                    cout << "Error parsing JSON line: " << errorMessage << endl;
+                    continue;
+                }
+                if (status != DataPreprocessor::LineStatus::ACCEPTED) continue;
+
+                //first one wins: earlier batches are in the tree or still hashing
+                const Review& review = scratch.back();
+                if (tree.contains(review.reviewID) ||
+                    (hashingPending && hashing->idSet.count(review.reviewID) > 0) ||
+                    parsing->idSet.count(review.reviewID) > 0)
+                {
+                    duplicatesRemoved++;
+                    continue;
+                }
+
+                review.appendCanonical(parsing->nextData());
+                parsing->reviewIds.push_back(review.reviewID);
+                parsing->idSet.insert(parsing->reviewIds.back());
+                if (keepOffsets) sourceOffsets.push_back(static_cast<uint64_t>(lineStart - file.data()));
+                recordCount++;
+
+                if (recordCount % 100000 == 0)
+                {
+                    cout << "Streamed " << recordCount << " reviews..." << endl;
+                }
+
+                if (maxRecords > 0 && recordCount >= maxRecords)
+                {
+                    stop = true;
+                    break;
+                }
+            }
+            if (cursor >= fileEnd) stop = true;
+
+            //hand the finished batch to the tree, then start hashing the new one
+            if (hashingPending)
+            {
+                if (worker.joinable()) worker.join();
+                tree.appendLeaves(hashing->digests, hashing->reviewIds);
+                hashing->reset(batchSize);
+                hashingPending = false;
+            }
+
+            swap(parsing, hashing);
+            if (!hashing->reviewIds.empty())
+            {
+                hashingPending = true;
+                if (overlap && !stop) worker = thread([this, hashing]() { hashBatch(*hashing); });
+                else hashBatch(*hashing);
+            }
+        }
+
+        if (hashingPending)
+        {
+            if (worker.joinable()) worker.join();
+            tree.appendLeaves(hashing->digests, hashing->reviewIds);
+        }
+
+        tree.finishLeaves();
+
+        auto end = chrono::high_resolution_clock::now();
+        auto totalTime = chrono::duration_cast<chrono::milliseconds>(end - start);
+
+        if (duplicatesRemoved > 0)
+        {
+            cout << "Removed " << duplicatesRemoved << " duplicate reviews" << endl;
+        }
+        cout << "Streamed " << recordCount << " reviews into the tree in " << totalTime.count() << " ms" << endl;
+        return true;
+    }
+
+    //canonical string of a leaf re-read from the source file (needs offsets)
+    bool readLeafData(size_t leafIndex, string& reviewData)
+    {
+        if (leafIndex >= sourceOffsets.size() || file.data() == nullptr) return false;
+
+        const char* lineStart = file.data() + sourceOffsets[leafIndex];
+        const char* fileEnd = file.data() + file.size();
+        const char* newline = static_cast<const char*>(memchr(lineStart, '\n', fileEnd - lineStart));
+        string_view line(lineStart, static_cast<size_t>((newline ? newline : fileEnd) - lineStart));
+
+        JsonLineScanner scanner;
+        vector<Review> parsed;
+        string errorMessage;
+        if (DataPreprocessor::parseReviewLine(line, scanner, parsed, errorMessage) != DataPreprocessor::LineStatus::ACCEPTED)
+            return false;
+
+        reviewData.clear();
+        parsed.back().appendCanonical(reviewData);
+        return true;
+    }
+
+    const vector<uint64_t>& getSourceOffsets() const { return sourceOffsets; }
+    int getRecordCount() const { return recordCount; }
+    int getDuplicatesRemoved() const { return duplicatesRemoved; }
+};
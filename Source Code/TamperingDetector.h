@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <ctime>
 #include "MerkleTree.h"
+#include "TreeDiff.h"
 
 using namespace std;
 
@@ -187,6 +188,7 @@ public:
 
         cout << "Scanning for modified reviews..." << endl;
 
+        string reviewData; //reused for every review
         for (const auto& review : reviews)
         {
             ReviewTamperResult result;
@@ -200,7 +202,8 @@ public:
                 continue;
             }
 
-            string reviewData = review.convertToString();
+            reviewData.clear();
+            review.appendCanonical(reviewData);
             vector<string> proof = newTree.generateProof(review.getUniqueID());
 
             if (proof.empty())
@@ -229,6 +232,30 @@ public:
         return results;
     }
 
+    //find the changed reviews by diffing the original tree against newTree,
+    //only subtrees with different hashes are visited
+    vector<ReviewTamperResult> localizeTampering(const MerkleTree& newTree)
+    {
+        vector<ReviewTamperResult> results;
+
+        TreeDiffResult diff = TreeDiff::diff(*originalTree, newTree);
+        cout << "Localized " << diff.changes.size() << " changed review(s) comparing "
+            << diff.nodesCompared << " nodes" << endl;
+
+        for (const LeafChange& change : diff.changes)
+        {
+            ReviewTamperResult result;
+            result.reviewId = change.reviewId;
+            result.tampered = true;
+            if (change.type == LeafChange::MODIFIED) result.status = "MODIFIED_REVIEW_DETECTED";
+            else if (change.type == LeafChange::INSERTED) result.status = "NEW_REVIEW_DETECTED";
+            else result.status = "DELETED_REVIEW_DETECTED";
+            results.push_back(result);
+        }
+
+        return results;
+    }
+
     void storeOriginalRoot(const string& datasetName, const string& rootHash)
     {
         originalRoots[datasetName] = rootHash;
@@ -293,7 +320,7 @@ public:
         report.newReviewCount = static_cast<int>(newReviews.size());
 
         report.rootComparison = detectByRootComparison(newTree.getRootHash());
-        report.modifiedReviews = detectModifiedReviews(newReviews, newTree);
+        report.modifiedReviews = localizeTampering(newTree);
 
         report.tamperedReviewCount = count_if(report.modifiedReviews.begin(),
             report.modifiedReviews.end(),
@@ -312,10 +339,13 @@ public:
                 " reviews deleted\n";
         }
 
-        if (report.tamperedReviewCount > 0)
+        int modifiedCount = static_cast<int>(count_if(report.modifiedReviews.begin(),
+            report.modifiedReviews.end(),
+            [](const ReviewTamperResult& r) { return r.status == "MODIFIED_REVIEW_DETECTED"; }));
+        if (modifiedCount > 0)
         {
             report.analysis += "MODIFICATIONS_DETECTED: " +
-                to_string(report.tamperedReviewCount) + " reviews modified\n";
+                to_string(modifiedCount) + " reviews modified\n";
         }
 
         if (report.rootComparison.tamperingDetected)
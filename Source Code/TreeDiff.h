@@ -0,0 +1,280 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+#include "MerkleTree.h"
+#include "FlatMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// tree diff
+// ========================
+// finds the leaves that differ between two trees by walking both from the top
+// and only descending into nodes whose hashes differ. node (level, i) covers
+// the same leaf positions in both trees, so k changed leaves cost about
+// k * log(n) node comparisons instead of rehashing or proving every review.
+// differing positions are then classified by review id:
+//   MODIFIED  same id in both trees, different leaf hash
+//   INSERTED  id only in the new tree
+//   DELETED   id only in the old tree
+// a review that only moved to another position with the same hash is not
+// reported. the walk assumes the buildTreeFromReviews/appendLeaves (or
+// applyBatch) layout, where leaf positions follow input order. an insertion
+// or deletion in the middle shifts every later leaf, so those positions all
+// differ and are compared by id: still exact, but no longer logarithmic.
+// pointer trees grown with addReview lack that layout and are compared by id
+// at every position.
+struct LeafChange
+{
+    enum Type
+    {
+        MODIFIED,
+        INSERTED,
+        DELETED
+    };
+
+    Type type;
+    string reviewId;
+    size_t oldPosition; //npos if the review is not in the old tree
+    size_t newPosition; //npos if the review is not in the new tree
+};
+
+struct TreeDiffResult
+{
+    vector<LeafChange> changes;
+    size_t nodesCompared = 0;
+    int modified = 0;
+    int inserted = 0;
+    int deleted = 0;
+
+    bool identical() const { return changes.empty(); }
+};
+
+class TreeDiff
+{
+private:
+    //node count of a level: every level halves the one below rounding up
+    static size_t levelSizeFor(size_t leafCount, size_t level)
+    {
+        size_t size = leafCount;
+        for (size_t l = 0; l < level; l++) size = (size + 1) / 2;
+        return size;
+    }
+
+    static size_t levelCountFor(size_t leafCount)
+    {
+        if (leafCount == 0) return 0;
+        size_t count = 1;
+        for (size_t size = leafCount; size > 1; size = (size + 1) / 2) count++;
+        return count;
+    }
+
+    //leaf access for the two tree types
+    struct FlatView
+    {
+        const FlatMerkleTree& tree;
+
+        size_t leafCount() const { return tree.getLeafCount(); }
+        string_view idAt(size_t leaf) const { return tree.getLeafId(leaf); }
+        bool find(const string& id, size_t& leaf) const { return tree.findLeaf(id, leaf); }
+        bool sameLeaf(size_t leaf, const FlatView& other, size_t otherLeaf) const
+        {
+            return tree.getNode(0, leaf) == other.tree.getNode(0, otherLeaf);
+        }
+    };
+
+    struct PointerView
+    {
+        const MerkleTree& tree;
+
+        size_t leafCount() const { return tree.leafNodes.size(); }
+        string_view idAt(size_t leaf) const { return tree.leafIndex.idAt(leaf); }
+        bool find(const string& id, size_t& leaf) const { return tree.leafIndex.find(id, leaf); }
+        bool sameLeaf(size_t leaf, const PointerView& other, size_t otherLeaf) const
+        {
+            return tree.leafNodes[leaf]->hash == other.tree.leafNodes[otherLeaf]->hash;
+        }
+    };
+
+    static void addChange(TreeDiffResult& result, LeafChange::Type type, string_view id,
+        size_t oldPosition, size_t newPosition)
+    {
+        result.changes.push_back({ type, string(id), oldPosition, newPosition });
+        if (type == LeafChange::MODIFIED) result.modified++;
+        else if (type == LeafChange::INSERTED) result.inserted++;
+        else result.deleted++;
+    }
+
+    //turn differing leaf positions (sorted) into per review changes
+    template <class View>
+    static void classify(const View& before, const View& after, const vector<size_t>& positions, TreeDiffResult& result)
+    {
+        for (size_t position : positions)
+        {
+            bool inBefore = position < before.leafCount();
+            bool inAfter = position < after.leafCount();
+            string_view oldId = inBefore ? before.idAt(position) : string_view();
+            string_view newId = inAfter ? after.idAt(position) : string_view();
+
+            if (inBefore)
+            {
+                size_t moved;
+                if (!after.find(string(oldId), moved))
+                {
+                    addChange(result, LeafChange::DELETED, oldId, position, string::npos);
+                }
+                else if (!before.sameLeaf(position, after, moved))
+                {
+                    addChange(result, LeafChange::MODIFIED, oldId, position, moved);
+                }
+            }
+
+            if (inAfter && !(inBefore && newId == oldId))
+            {
+                size_t moved;
+                if (!before.find(string(newId), moved))
+                {
+                    addChange(result, LeafChange::INSERTED, newId, string::npos, position);
+                }
+            }
+        }
+    }
+
+    //positions past the smaller tree exist in only one of them
+    static void appendTail(size_t before, size_t after, vector<size_t>& positions)
+    {
+        for (size_t position = min(before, after); position < max(before, after); position++)
+        {
+            positions.push_back(position);
+        }
+    }
+
+    //a node of a tree built by buildTreeFromReviews: level 0 holds the leaf
+    //at that position, every node above has both children
+    static bool inShape(const MerkleNode* node, size_t level, size_t index, const MerkleTree& tree)
+    {
+        if (!node) return false;
+        if (level == 0) return index < tree.leafNodes.size() && node == tree.leafNodes[index].get();
+        return node->left && node->right;
+    }
+
+    //walk two pointer trees from (level, index) down to the differing leaves.
+    //false if either tree does not have the layout the walk assumes
+    static bool descend(const MerkleNode* a, const MerkleNode* b, size_t level, size_t index,
+        const MerkleTree& treeA, const MerkleTree& treeB, vector<size_t>& positions, size_t& compared)
+    {
+        if (!inShape(a, level, index, treeA) || !inShape(b, level, index, treeB)) return false;
+
+        compared++;
+        if (a->hash == b->hash) return true;
+
+        if (level == 0)
+        {
+            positions.push_back(index);
+            return true;
+        }
+
+        //a duplicated odd node has no real right child, skip it
+        size_t childLimit = min(levelSizeFor(treeA.leafNodes.size(), level - 1),
+            levelSizeFor(treeB.leafNodes.size(), level - 1));
+        if (2 * index < childLimit &&
+            !descend(a->left.get(), b->left.get(), level - 1, 2 * index, treeA, treeB, positions, compared))
+        {
+            return false;
+        }
+        if (2 * index + 1 < childLimit &&
+            !descend(a->right.get(), b->right.get(), level - 1, 2 * index + 1, treeA, treeB, positions, compared))
+        {
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // leaf changes from before to after, both flat trees must use the same hash mode
+    static TreeDiffResult diff(const FlatMerkleTree& before, const FlatMerkleTree& after)
+    {
+        if (before.getHashMode() != after.getHashMode())
+        {
+            throw invalid_argument("cannot diff trees with different hash modes");
+        }
+
+        TreeDiffResult result;
+        vector<size_t> positions;
+        size_t leavesBefore = before.getLeafCount();
+        size_t leavesAfter = after.getLeafCount();
+
+        if (leavesBefore > 0 && leavesAfter > 0)
+        {
+            //start at the highest level both trees have. below it, node i of a
+            //level covers the same leaves in both trees
+            size_t top = min(before.getHeight(), after.getHeight()) - 1;
+            vector<pair<size_t, size_t>> pending; //(level, index)
+            size_t common = min(before.getLevelSize(top), after.getLevelSize(top));
+            for (size_t i = common; i > 0; i--) pending.push_back({ top, i - 1 });
+
+            while (!pending.empty())
+            {
+                size_t level = pending.back().first;
+                size_t index = pending.back().second;
+                pending.pop_back();
+
+                result.nodesCompared++;
+                if (before.getNode(level, index) == after.getNode(level, index)) continue;
+
+                if (level == 0)
+                {
+                    positions.push_back(index);
+                    continue;
+                }
+
+                size_t childLimit = min(before.getLevelSize(level - 1), after.getLevelSize(level - 1));
+                if (2 * index + 1 < childLimit) pending.push_back({ level - 1, 2 * index + 1 });
+                if (2 * index < childLimit) pending.push_back({ level - 1, 2 * index });
+            }
+        }
+
+        appendTail(leavesBefore, leavesAfter, positions);
+        classify(FlatView{ before }, FlatView{ after }, positions, result);
+        return result;
+    }
+
+    // same for pointer trees. trees grown with addReview have leaves at other
+    // depths, those are compared by id over every position instead
+    static TreeDiffResult diff(const MerkleTree& before, const MerkleTree& after)
+    {
+        TreeDiffResult result;
+        vector<size_t> positions;
+        size_t leavesBefore = before.leafNodes.size();
+        size_t leavesAfter = after.leafNodes.size();
+
+        if (before.root && after.root)
+        {
+            //the taller tree's first node at the shorter tree's root level is
+            //reached by going left; the rest of that level is tail leaves
+            size_t heightBefore = levelCountFor(leavesBefore);
+            size_t heightAfter = levelCountFor(leavesAfter);
+            size_t top = min(heightBefore, heightAfter) - 1;
+
+            const MerkleNode* a = before.root.get();
+            const MerkleNode* b = after.root.get();
+            for (size_t level = heightBefore - 1; level > top && a; level--) a = a->left.get();
+            for (size_t level = heightAfter - 1; level > top && b; level--) b = b->left.get();
+
+            if (!descend(a, b, top, 0, before, after, positions, result.nodesCompared))
+            {
+                positions.clear();
+                appendTail(0, max(leavesBefore, leavesAfter), positions);
+                classify(PointerView{ before }, PointerView{ after }, positions, result);
+                return result;
+            }
+        }
+
+        appendTail(leavesBefore, leavesAfter, positions);
+        classify(PointerView{ before }, PointerView{ after }, positions, result);
+        return result;
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+// ========================
+// tree snapshot file format
+// ========================
+// binary image of a FlatMerkleTree so it can be reopened with one mmap instead
+// of re-reading json and rehashing. all integers are native byte order, the
+// endian marker rejects files written on a machine with the other order.
+//
+//   header (64 bytes)
+//   levels      every level's digests, leaves first, 32 bytes each
+//   slots       2^indexSlotBits uint64 LeafIndex table slots (version 2+)
+//   idOffsets   leafCount + 1 uint64 offsets into the id arena (leaf order)
+//   idArena     review id bytes, concatenated
+//
+// the checksum covers everything after the header. version 1 files have no
+// slots and their index is rebuilt on load.
+namespace TreeSnapshot
+{
+    const char MAGIC[8] = { 'M', 'R', 'K', 'L', 'S', 'N', 'A', 'P' };
+    const uint32_t VERSION = 2;
+    const uint32_t ENDIAN_MARKER = 0x01020304;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t endianMarker;
+        uint32_t hashMode;
+        uint32_t indexSlotBits; //0 = no persisted index table
+        uint64_t leafCount;
+        uint64_t levelCount;
+        uint64_t nodeCount;     //digests over all levels
+        uint64_t idArenaBytes;
+        uint64_t checksum;
+    };
+    static_assert(sizeof(Header) == 64, "snapshot header must stay 64 bytes");
+
+    //node count of a tree with leafCount leaves, every level halves rounding up
+    inline uint64_t countNodes(uint64_t leafCount, uint64_t& levelCount)
+    {
+        levelCount = 0;
+        uint64_t nodes = 0;
+        for (uint64_t size = leafCount; size > 0; size = (size == 1) ? 0 : (size + 1) / 2)
+        {
+            nodes += size;
+            levelCount++;
+        }
+        return nodes;
+    }
+
+    //64-bit checksum over bytes. four independent multiply-rotate lanes keep it
+    //fast enough to check a multi-gigabyte file at load. detects corruption,
+    //it is not a cryptographic hash
+    class Checksum
+    {
+    private:
+        uint64_t lanes[4];
+        uint64_t totalBytes;
+        unsigned char pending[32];
+        size_t pendingBytes;
+
+        static uint64_t rotate(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        static uint64_t mix(uint64_t lane, uint64_t word)
+        {
+            lane += word * 0xC2B2AE3D27D4EB4FULL;
+            return rotate(lane, 31) * 0x9E3779B185EBCA87ULL;
+        }
+
+        void block(const unsigned char* data)
+        {
+            uint64_t words[4];
+            memcpy(words, data, 32);
+            for (int i = 0; i < 4; i++) lanes[i] = mix(lanes[i], words[i]);
+        }
+
+    public:
+        Checksum() : totalBytes(0), pendingBytes(0)
+        {
+            lanes[0] = 0x243F6A8885A308D3ULL;
+            lanes[1] = 0x13198A2E03707344ULL;
+            lanes[2] = 0xA4093822299F31D0ULL;
+            lanes[3] = 0x082EFA98EC4E6C89ULL;
+        }
+
+        void add(const void* data, size_t length)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            totalBytes += length;
+
+            if (pendingBytes > 0)
+            {
+                size_t take = min(length, 32 - pendingBytes);
+                memcpy(pending + pendingBytes, bytes, take);
+                pendingBytes += take;
+                bytes += take;
+                length -= take;
+                if (pendingBytes < 32) return;
+                block(pending);
+                pendingBytes = 0;
+            }
+
+            for (; length >= 32; bytes += 32, length -= 32) block(bytes);
+
+            memcpy(pending, bytes, length);
+            pendingBytes = length;
+        }
+
+        uint64_t finish() const
+        {
+            uint64_t result = totalBytes * 0x9E3779B185EBCA87ULL;
+            for (int i = 0; i < 4; i++) result = mix(result, lanes[i]);
+            for (size_t i = 0; i < pendingBytes; i++) result = mix(result, pending[i]);
+            result ^= result >> 29;
+            result *= 0xBF58476D1CE4E5B9ULL;
+            return result ^ (result >> 32);
+        }
+    };
+}
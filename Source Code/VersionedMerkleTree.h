@@ -0,0 +1,209 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <ctime>
+#include <algorithm>
+#include <unordered_set>
+#include "ConcurrentMerkleTree.h"
+
+using namespace std;
+
+// ========================
+// versioned merkle tree
+// ========================
+// keeps past versions of a ConcurrentMerkleTree so proofs can be generated
+// against any retained historical root ("was this review in the dataset as
+// of date X"). every build or batch commits one version tagged with a
+// timestamp. versions are persistent: a batch only clones the blocks on its
+// dirty paths, so a retained version costs its block pointer tables plus at
+// most k * log(n) blocks for k changes instead of a full copy.
+// collectGarbage drops versions superseded before a cutoff, keeping the one
+// that was current at the cutoff so it can still be answered. the current
+// version can also be read lock free through getTree() and a
+// ConcurrentMerkleTree::Reader.
+class VersionedMerkleTree
+{
+public:
+    struct VersionInfo
+    {
+        uint64_t version;
+        time_t committedAt;
+        string rootHash;
+        size_t leafCount;
+    };
+
+private:
+    struct RetainedVersion
+    {
+        time_t committedAt;
+        shared_ptr<const TreeVersion> tree;
+    };
+
+    ConcurrentMerkleTree tree;
+    vector<RetainedVersion> history;     //oldest first, committedAt never decreases
+    long long retentionSeconds;          //0 = keep everything
+    mutex commitMutex;                   //one update and its commit at a time
+    mutable mutex historyMutex;
+
+    void commit(time_t committedAt)
+    {
+        lock_guard<mutex> lock(historyMutex);
+        if (!history.empty()) committedAt = max(committedAt, history.back().committedAt);
+        history.push_back({ committedAt, tree.getCurrentVersion() });
+
+        if (retentionSeconds > 0) collectLocked(committedAt - retentionSeconds);
+    }
+
+    size_t collectLocked(time_t cutoff)
+    {
+        //versions whose successor was committed at or before the cutoff
+        size_t superseded = 0;
+        while (superseded + 1 < history.size() && history[superseded + 1].committedAt <= cutoff) superseded++;
+        history.erase(history.begin(), history.begin() + superseded);
+        return superseded;
+    }
+
+    const RetainedVersion* findLocked(uint64_t version) const
+    {
+        auto it = lower_bound(history.begin(), history.end(), version,
+            [](const RetainedVersion& retained, uint64_t value) { return retained.tree->getVersion() < value; });
+        return (it != history.end() && it->tree->getVersion() == version) ? &*it : nullptr;
+    }
+
+public:
+    VersionedMerkleTree(HashMode mode = HashMode::HEX_COMPAT)
+        : tree(mode), retentionSeconds(0) {
+    }
+
+    //drop versions superseded more than seconds before each new commit, 0 = never
+    void setRetentionWindow(long long seconds) { retentionSeconds = seconds; }
+
+    void setThreadCount(unsigned threads) { tree.setThreadCount(threads); }
+
+    //the live tree, for lock free readers of the current version
+    ConcurrentMerkleTree& getTree() { return tree; }
+
+    // ========================
+    // commits
+    // ========================
+
+    void buildTreeFromReviews(const vector<string>& reviewData, const vector<string>& reviewIds,
+        time_t committedAt = time(nullptr))
+    {
+        lock_guard<mutex> lock(commitMutex);
+        tree.buildTreeFromReviews(reviewData, reviewIds);
+        commit(committedAt);
+    }
+
+    BatchResult applyBatch(const vector<TreeUpdate>& updates, time_t committedAt = time(nullptr))
+    {
+        lock_guard<mutex> lock(commitMutex);
+        BatchResult result = tree.applyBatch(updates);
+        commit(committedAt);
+        return result;
+    }
+
+    void addReview(const string& reviewData, const string& reviewId, time_t committedAt = time(nullptr))
+    {
+        BatchResult result = applyBatch({ { TreeUpdate::INSERT, reviewId, reviewData } }, committedAt);
+        if (result.rejected > 0)
+        {
+            throw invalid_argument("Review ID already exists: " + reviewId);
+        }
+    }
+
+    // ========================
+    // historical queries
+    // ========================
+
+    //a retained version by number, null if unknown or collected
+    shared_ptr<const TreeVersion> getVersion(uint64_t version) const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        const RetainedVersion* retained = findLocked(version);
+        return retained ? retained->tree : nullptr;
+    }
+
+    //the version that was current at time at, null if none is retained
+    shared_ptr<const TreeVersion> getVersionAsOf(time_t at) const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        auto it = upper_bound(history.begin(), history.end(), at,
+            [](time_t value, const RetainedVersion& retained) { return value < retained.committedAt; });
+        if (it == history.begin()) return nullptr;
+        return prev(it)->tree;
+    }
+
+    shared_ptr<const TreeVersion> getLatestVersion() const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        return history.empty() ? nullptr : history.back().tree;
+    }
+
+    //root of a retained version, empty if unknown
+    string getRootHash(uint64_t version) const
+    {
+        auto retained = getVersion(version);
+        return retained ? retained->getRootHash() : "";
+    }
+
+    //proof against the root of a retained version (FlatMerkleTree format),
+    //empty if the version or the review is unknown
+    vector<string> generateProofAt(uint64_t version, const string& reviewId) const
+    {
+        auto retained = getVersion(version);
+        return retained ? retained->generateProof(reviewId) : vector<string>();
+    }
+
+    //proof against the root that was current at time at
+    vector<string> generateProofAsOf(time_t at, const string& reviewId, string& rootHash) const
+    {
+        auto retained = getVersionAsOf(at);
+        rootHash = retained ? retained->getRootHash() : "";
+        return retained ? retained->generateProof(reviewId) : vector<string>();
+    }
+
+    //retained versions, oldest first
+    vector<VersionInfo> listVersions() const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        vector<VersionInfo> versions;
+        for (const RetainedVersion& retained : history)
+        {
+            versions.push_back({ retained.tree->getVersion(), retained.committedAt,
+                retained.tree->getRootHash(), retained.tree->getLeafCount() });
+        }
+        return versions;
+    }
+
+    size_t getVersionCount() const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        return history.size();
+    }
+
+    //drop versions superseded at or before cutoff, returns how many went.
+    //their blocks are freed once no other version or reader shares them
+    size_t collectGarbage(time_t cutoff)
+    {
+        size_t dropped;
+        {
+            lock_guard<mutex> lock(historyMutex);
+            dropped = collectLocked(cutoff);
+        }
+        tree.reclaim();
+        return dropped;
+    }
+
+    //bytes held by all retained versions, shared blocks counted once
+    size_t getMemoryUsage() const
+    {
+        lock_guard<mutex> lock(historyMutex);
+        unordered_set<const void*> counted;
+        size_t bytes = 0;
+        for (const RetainedVersion& retained : history) bytes += retained.tree->getMemoryUsage(counted);
+        return bytes;
+    }
+};
@@ -6,6 +6,22 @@
 #include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ExistenceProver.h"
 #include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\PerformanceMeasurer.h"
 #include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\TamperingDetector.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\FlatMerkleTree.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\StreamingTreeBuilder.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\LeafIndex.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\MerkleMountainRange.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\TreeDiff.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\MultiProof.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ProductOrderedTree.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\SortedMerkleTree.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ProofCodec.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\BatchVerifier.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ProofCache.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ConcurrentMerkleTree.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\VersionedMerkleTree.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\MerkleForest.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\ExternalTreeBuilder.h"
+#include "C:\Users\zinsi\source\repos\merkle_algo\merkle_algo\KaryMerkleTree.h"
 
 // for tests
 #include <filesystem>
@@ -312,3 +328,1395 @@ TEST_F(MerkleTreeTest, AddNewReviewPartialRebuild) {
     EXPECT_NE(oldRoot, newRoot);
     EXPECT_TRUE(tree.contains(newReview.getUniqueID()));
 }
+
+// Test 16: Flat tree matches the pointer tree
+TEST_F(MerkleTreeTest, FlatTreeMatchesPointerTree) {
+    FlatMerkleTree flatTree;
+    flatTree.buildTreeFromReviews(reviewData, reviewIds);
+
+    EXPECT_EQ(tree.getRootHash(), flatTree.getRootHash());
+    EXPECT_EQ(tree.getLeafCount(), flatTree.getLeafCount());
+
+    for (size_t i = 0; i < reviewIds.size(); i++) {
+        vector<string> proof = flatTree.generateProof(reviewIds[i]);
+        EXPECT_EQ(tree.generateProof(reviewIds[i]), proof);
+        EXPECT_TRUE(MerkleTree::verifyProof(reviewData[i], proof, flatTree.getRootHash()));
+        EXPECT_TRUE(FlatMerkleTree::verifyProof(reviewData[i], proof, flatTree.getRootHash()));
+    }
+    EXPECT_FALSE(FlatMerkleTree::verifyProof("tampered", flatTree.generateProof(reviewIds[0]), flatTree.getRootHash()));
+}
+
+// Test 17: Appending to the flat tree equals a full rebuild
+TEST_F(MerkleTreeTest, FlatTreeAddReviewMatchesRebuild) {
+    FlatMerkleTree appended;
+    vector<string> data, ids;
+
+    for (int i = 0; i < 9; i++) {
+        data.push_back("review data " + to_string(i));
+        ids.push_back("ID_" + to_string(i));
+        appended.addReview(data.back(), ids.back());
+
+        FlatMerkleTree rebuilt;
+        rebuilt.buildTreeFromReviews(data, ids);
+        EXPECT_EQ(rebuilt.getRootHash(), appended.getRootHash());
+    }
+
+    EXPECT_TRUE(appended.contains("ID_8"));
+    EXPECT_THROW(appended.addReview("again", "ID_8"), invalid_argument);
+}
+
+// Test 18: Raw digest mode proofs
+TEST_F(MerkleTreeTest, RawDigestModeProofs) {
+    FlatMerkleTree hexTree;
+    FlatMerkleTree rawTree(HashMode::RAW_DIGEST);
+    hexTree.buildTreeFromReviews(reviewData, reviewIds);
+    rawTree.buildTreeFromReviews(reviewData, reviewIds);
+
+    EXPECT_NE(hexTree.getRootHash(), rawTree.getRootHash());
+    EXPECT_EQ(rawTree.getRootHash(), digestToHex(rawTree.getRootDigest()));
+
+    for (size_t i = 0; i < reviewIds.size(); i++) {
+        vector<ProofStep> proof = rawTree.generateDigestProof(reviewIds[i]);
+        EXPECT_TRUE(FlatMerkleTree::verifyDigestProof(reviewData[i], proof, rawTree.getRootDigest(), HashMode::RAW_DIGEST));
+        EXPECT_FALSE(FlatMerkleTree::verifyDigestProof(reviewData[i], proof, rawTree.getRootDigest(), HashMode::HEX_COMPAT));
+        EXPECT_TRUE(FlatMerkleTree::verifyProof(reviewData[i], rawTree.generateProof(reviewIds[i]),
+            rawTree.getRootHash(), HashMode::RAW_DIGEST));
+    }
+
+    vector<ProofStep> hexProof = hexTree.generateDigestProof(reviewIds[1]);
+    EXPECT_TRUE(FlatMerkleTree::verifyDigestProof(reviewData[1], hexProof, hexTree.getRootDigest()));
+}
+
+// Test 19: Parallel build gives the same root as sequential
+TEST_F(MerkleTreeTest, ParallelBuildMatchesSequential) {
+    vector<string> data, ids;
+    for (int i = 0; i < 5000; i++) {
+        data.push_back("parallel review " + to_string(i));
+        ids.push_back("PAR_" + to_string(i));
+    }
+
+    for (HashMode mode : { HashMode::HEX_COMPAT, HashMode::RAW_DIGEST }) {
+        FlatMerkleTree sequential(mode), parallel(mode);
+        sequential.buildTreeFromReviews(data, ids);
+        parallel.setThreadCount(4);
+        parallel.buildTreeFromReviews(data, ids);
+
+        EXPECT_EQ(sequential.getRootHash(), parallel.getRootHash());
+        EXPECT_EQ(sequential.generateProof("PAR_4321"), parallel.generateProof("PAR_4321"));
+    }
+}
+
+// Test 20: Every batch sha-256 kernel matches the reference hasher
+TEST_F(MerkleTreeTest, BatchHashKernelsMatchReference) {
+    SHA256 reference;
+    vector<string> messages;
+    for (size_t len : { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 300 }) {
+        messages.push_back(string(len, 'x'));
+    }
+    messages.insert(messages.end(), reviewData.begin(), reviewData.end());
+
+    for (auto kernel : { SHA256Batch::Kernel::SCALAR, SHA256Batch::Kernel::SHA_NI,
+                         SHA256Batch::Kernel::AVX2, SHA256Batch::Kernel::AVX512 }) {
+        if (!SHA256Batch::isSupported(kernel)) continue;
+
+        vector<Digest> digests(messages.size());
+        SHA256Batch::hashStrings(messages, 0, messages.size(), digests.data(), kernel);
+        for (size_t i = 0; i < messages.size(); i++) {
+            EXPECT_EQ(reference(messages[i]), digestToHex(digests[i])) << SHA256Batch::kernelName(kernel);
+        }
+    }
+}
+
+// Test 21: Batch proof verification
+TEST_F(MerkleTreeTest, BatchDigestProofVerification) {
+    FlatMerkleTree flatTree(HashMode::RAW_DIGEST);
+    flatTree.buildTreeFromReviews(reviewData, reviewIds);
+
+    vector<vector<ProofStep>> proofs;
+    for (const auto& id : reviewIds) {
+        proofs.push_back(flatTree.generateDigestProof(id));
+    }
+    vector<string> data = reviewData;
+    data[1] += " [TAMPERED]";
+
+    vector<bool> results = FlatMerkleTree::verifyDigestProofs(data, proofs, flatTree.getRootDigest(), HashMode::RAW_DIGEST);
+    ASSERT_EQ(results.size(), data.size());
+    EXPECT_TRUE(results[0]);
+    EXPECT_FALSE(results[1]);
+    EXPECT_TRUE(results[2]);
+}
+
+// Test 22: Memory mapped loader matches the json loader
+TEST_F(MerkleTreeTest, MappedLoaderMatchesJsonLoader) {
+    string filename = "data/test_mapped.json";
+    {
+        ofstream file(filename, ios::binary);
+        file << R"({"reviewerID": "M1", "asin": "P1", "reviewText": "  Escaped \"text\" \u00e9\ud83d\ude00\n ", "summary": "a\/b", "overall": 4.5, "unixReviewTime": 1382659200, "style": {"Size:": [1, null]}})" << "\n";
+        file << R"({"reviewerID": "M2", "asin": "P2", "reviewText": "duplicate", "overall": 3, "unixReviewTime": "1000"})" << "\r\n";
+        file << R"({"reviewerID": "M2", "asin": "P2", "reviewText": "duplicate", "overall": 3, "unixReviewTime": "1000"})" << "\n";
+        file << "\n";
+        file << R"({"reviewerID": "M3", "asin": "P3", "reviewText": "   ", "overall": 5})" << "\n";
+        file << R"({"reviewerID": "M4", "asin": 42, "reviewText": "numeric asin"})" << "\n";
+        file << R"({"reviewerID": "M5", "asin": "P5", "reviewText": "broken",})" << "\n";
+        file << R"({"reviewerID": "M6", "asin": "P6", "reviewText": "first", "reviewText": "last key wins", "overall": "5"})";
+    }
+
+    DataPreprocessor jsonLoader;
+    DataPreprocessor mappedLoader;
+    ASSERT_TRUE(jsonLoader.loadFromJSON(filename, 0));
+    ASSERT_TRUE(mappedLoader.loadFromJSONMapped(filename, 0));
+
+    const auto& expected = jsonLoader.getReviews();
+    const auto& actual = mappedLoader.getReviews();
+    ASSERT_EQ(expected.size(), actual.size());
+    EXPECT_EQ(expected.size(), 3);
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i].reviewID, actual[i].reviewID);
+        EXPECT_EQ(expected[i].convertToString(), actual[i].convertToString());
+    }
+
+    DataPreprocessor limited;
+    ASSERT_TRUE(limited.loadFromJSONMapped(filename, 1));
+    EXPECT_EQ(limited.getReviews().size(), 1);
+    EXPECT_FALSE(mappedLoader.loadFromJSONMapped("data/missing_file.json", 0));
+
+    fs::remove(filename);
+}
+
+// Test 23: Parallel chunked loader keeps sequential order, dedup and cutoff
+TEST_F(MerkleTreeTest, ParallelLoaderMatchesSequential) {
+    string filename = "data/test_parallel.json";
+    {
+        ofstream file(filename);
+        for (int i = 0; i < 60; i++) {
+            int id = (i % 7 == 3) ? i - 1 : i; //some duplicates of the previous line
+            file << "{\"reviewerID\": \"R" << id << "\", \"asin\": \"P" << (id % 5) << "\", \"reviewText\": \"text " << id
+                 << "\", \"summary\": \"s\", \"overall\": " << (id % 5 + 1) << ".0, \"unixReviewTime\": " << (1000 + id) << "}\n";
+            if (i % 11 == 0) file << "{not json}\n";
+        }
+    }
+
+    for (int maxRecords : { 0, 25 }) {
+        DataPreprocessor sequential;
+        ASSERT_TRUE(sequential.loadFromJSON(filename, maxRecords));
+
+        for (unsigned threads : { 1u, 4u }) {
+            DataPreprocessor parallel;
+            ASSERT_TRUE(parallel.loadFromJSONParallel(filename, maxRecords, threads, 300)); //small chunks to force many of them
+            ASSERT_EQ(sequential.getReviews().size(), parallel.getReviews().size());
+            for (size_t i = 0; i < sequential.getReviews().size(); i++) {
+                EXPECT_EQ(sequential.getReviews()[i].convertToString(), parallel.getReviews()[i].convertToString());
+            }
+        }
+    }
+
+    fs::remove(filename);
+}
+
+// Test 24: Streaming build matches load-then-build and re-reads leaf data
+TEST_F(MerkleTreeTest, StreamingBuildMatchesLoadedTree) {
+    string filename = "data/test_streaming.json";
+    {
+        ofstream file(filename);
+        for (int i = 0; i < 40; i++) {
+            int id = (i % 9 == 5) ? i - 3 : i; //duplicates across batch boundaries
+            file << "{\"reviewerID\": \"S" << id << "\", \"asin\": \"P" << (id % 4) << "\", \"reviewText\": \"stream " << id
+                 << "\", \"summary\": \"s\", \"overall\": 4.0, \"unixReviewTime\": " << (2000 + id) << "}\n";
+            if (i == 17) file << "{\"reviewerID\": \"bad\"\n";
+        }
+    }
+
+    for (int maxRecords : { 0, 21 }) {
+        DataPreprocessor loader;
+        ASSERT_TRUE(loader.loadFromJSON(filename, maxRecords));
+        vector<string> data, ids;
+        for (const auto& review : loader.getReviews()) {
+            data.push_back(review.convertToString());
+            ids.push_back(review.getUniqueID());
+        }
+        MerkleTree loadedTree;
+        loadedTree.buildTreeFromReviews(data, ids);
+
+        for (unsigned threads : { 1u, 3u }) {
+            StreamingTreeBuilder builder(4, threads);
+            builder.setKeepSourceOffsets(true);
+            FlatMerkleTree streamed;
+            ASSERT_TRUE(builder.build(filename, maxRecords, streamed));
+            EXPECT_EQ(streamed.getLeafCount(), data.size());
+            EXPECT_EQ(streamed.getRootHash(), loadedTree.getRootHash());
+
+            //leaf data comes back from the file and verifies against the root
+            string leafData;
+            ASSERT_TRUE(builder.readLeafData(5, leafData));
+            EXPECT_EQ(leafData, data[5]);
+            EXPECT_TRUE(FlatMerkleTree::verifyProof(leafData, streamed.generateProof(ids[5]), streamed.getRootHash()));
+        }
+    }
+
+    fs::remove(filename);
+}
+
+// Test 25: Canonical serializer is byte identical to the ostringstream layout
+TEST_F(MerkleTreeTest, CanonicalSerializationMatchesStreamLayout) {
+    string buffer;
+    for (double rating : { 0.0, 1.0, 4.5, 3.25, 0.1, 2.0 / 3.0, 1234567.0, 1e-7, -0.0 }) {
+        Review review("A1", "B000", "some text", "summary", rating, "1382659200");
+
+        ostringstream oss;
+        oss << "reviewID: " << review.reviewID << "\n"
+            << "asin: " << review.asin << "\n"
+            << "reviewerID: " << review.reviewerID << "\n"
+            << "reviewText: " << review.reviewText << "\n"
+            << "summary: " << review.summary << "\n"
+            << "overall: " << review.overall << "\n"
+            << "unixReviewTime: " << review.unixReviewTime;
+
+        buffer.clear();
+        review.appendCanonical(buffer);
+        EXPECT_EQ(buffer, oss.str());
+        EXPECT_EQ(review.convertToString(), oss.str());
+        EXPECT_LE(buffer.size(), review.canonicalSize());
+    }
+}
+
+// Test 26: Snapshot save and mmap reload
+TEST_F(MerkleTreeTest, SnapshotRoundTrip) {
+    string filename = "data/test_tree.snapshot";
+
+    for (HashMode mode : { HashMode::HEX_COMPAT, HashMode::RAW_DIGEST }) {
+        FlatMerkleTree original(mode);
+        original.buildTreeFromReviews(reviewData, reviewIds);
+        ASSERT_TRUE(original.saveSnapshot(filename));
+
+        FlatMerkleTree loaded;
+        ASSERT_TRUE(loaded.loadSnapshot(filename));
+        EXPECT_TRUE(loaded.isSnapshotMapped());
+        EXPECT_EQ(loaded.getHashMode(), mode);
+        EXPECT_EQ(loaded.getRootHash(), original.getRootHash());
+        EXPECT_EQ(loaded.getLeafCount(), original.getLeafCount());
+        EXPECT_EQ(loaded.getHeight(), original.getHeight());
+        for (size_t i = 0; i < reviewIds.size(); i++) {
+            EXPECT_TRUE(loaded.contains(reviewIds[i]));
+            EXPECT_EQ(loaded.generateProof(reviewIds[i]), original.generateProof(reviewIds[i]));
+        }
+
+        //modifying a loaded tree copies it out of the mapping first
+        original.addReview("snapshot extra", "extra_id");
+        loaded.addReview("snapshot extra", "extra_id");
+        EXPECT_FALSE(loaded.isSnapshotMapped());
+        EXPECT_EQ(loaded.getRootHash(), original.getRootHash());
+    }
+
+    //a flipped byte is caught by the checksum and the tree is left untouched
+    {
+        fstream file(filename, ios::in | ios::out | ios::binary);
+        file.seekp(100);
+        char byte = 0;
+        file.read(&byte, 1);
+        file.seekp(100);
+        byte ^= 0x01;
+        file.write(&byte, 1);
+    }
+    FlatMerkleTree corrupted;
+    corrupted.buildTreeFromReviews(reviewData, reviewIds);
+    string rootBefore = corrupted.getRootHash();
+    EXPECT_FALSE(corrupted.loadSnapshot(filename));
+    EXPECT_EQ(corrupted.getRootHash(), rootBefore);
+    EXPECT_FALSE(corrupted.loadSnapshot("data/missing.snapshot"));
+
+    fs::remove(filename);
+}
+
+// Test 27: Compact leaf index lookups, growth and swap erase
+TEST_F(MerkleTreeTest, CompactLeafIndex) {
+    LeafIndex index;
+    vector<string> ids;
+    for (int i = 0; i < 5000; i++) {
+        ids.push_back("A" + to_string(i * 7919 % 5000) + "_B000" + to_string(i % 13) + "_" + to_string(1382659200 + i));
+        ASSERT_TRUE(index.append(ids.back()));
+    }
+    EXPECT_FALSE(index.append(ids[42])); //already taken
+    EXPECT_EQ(index.size(), ids.size());
+
+    size_t leaf = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        ASSERT_TRUE(index.find(ids[i], leaf));
+        EXPECT_EQ(leaf, i);
+        EXPECT_EQ(index.idAt(i), ids[i]);
+    }
+    EXPECT_FALSE(index.contains("missing_id"));
+
+    //erasing a leaf moves the last id into its place
+    index.eraseLeaf(10);
+    EXPECT_FALSE(index.contains(ids[10]));
+    ASSERT_TRUE(index.find(ids.back(), leaf));
+    EXPECT_EQ(leaf, 10);
+    EXPECT_EQ(index.size(), ids.size() - 1);
+    for (size_t i = 0; i < 2000; i++) index.eraseLeaf(0);
+    EXPECT_EQ(index.size(), ids.size() - 2001);
+    for (size_t i = 0; i < index.size(); i++) {
+        ASSERT_TRUE(index.find(string(index.idAt(i)), leaf));
+        EXPECT_EQ(leaf, i);
+    }
+
+    //both trees still resolve ids through the index
+    MerkleTree tree;
+    tree.buildTreeFromReviews(reviewData, reviewIds);
+    for (const auto& id : reviewIds) EXPECT_TRUE(tree.contains(id));
+    EXPECT_FALSE(tree.contains("missing_id"));
+    EXPECT_EQ(tree.getLeafCount(), reviewIds.size());
+}
+
+// Test 28: Batched updates match a rebuild of the same leaves
+TEST_F(MerkleTreeTest, ApplyBatchMatchesRebuild) {
+    vector<string> ids, data;
+    for (int i = 0; i < 300; i++) {
+        ids.push_back("batch_" + to_string(i));
+        data.push_back("review body " + to_string(i));
+    }
+
+    for (HashMode mode : { HashMode::HEX_COMPAT, HashMode::RAW_DIGEST }) {
+        FlatMerkleTree tree(mode);
+        tree.buildTreeFromReviews(data, ids);
+        vector<string> mirrorIds = ids, mirrorData = data;
+
+        vector<TreeUpdate> batch;
+        for (int i = 0; i < 40; i++) batch.push_back({ TreeUpdate::INSERT, "new_" + to_string(i), "new body " + to_string(i) });
+        for (int i = 0; i < 30; i++) batch.push_back({ TreeUpdate::UPDATE, "batch_" + to_string(i * 7), "changed " + to_string(i) });
+        for (int i = 0; i < 25; i++) batch.push_back({ TreeUpdate::REMOVE, "batch_" + to_string(i * 11 + 3), "" });
+        batch.push_back({ TreeUpdate::INSERT, "batch_1", "duplicate id" });
+        batch.push_back({ TreeUpdate::REMOVE, "not_there", "" });
+
+        //same changes on plain vectors, removals swap in the last leaf
+        for (const auto& update : batch) {
+            auto it = find(mirrorIds.begin(), mirrorIds.end(), update.reviewId);
+            size_t pos = it - mirrorIds.begin();
+            if (update.type == TreeUpdate::INSERT && it == mirrorIds.end()) {
+                mirrorIds.push_back(update.reviewId);
+                mirrorData.push_back(update.reviewData);
+            }
+            else if (update.type == TreeUpdate::UPDATE && it != mirrorIds.end()) {
+                mirrorData[pos] = update.reviewData;
+            }
+            else if (update.type == TreeUpdate::REMOVE && it != mirrorIds.end()) {
+                mirrorIds[pos] = mirrorIds.back();
+                mirrorData[pos] = mirrorData.back();
+                mirrorIds.pop_back();
+                mirrorData.pop_back();
+            }
+        }
+
+        BatchResult result = tree.applyBatch(batch);
+        EXPECT_EQ(result.inserted, 40);
+        EXPECT_EQ(result.updated, 30);
+        EXPECT_EQ(result.removed, 25);
+        EXPECT_EQ(result.rejected, 2);
+        EXPECT_LT(result.hashesComputed, mirrorIds.size() * 2); //less than a rebuild
+
+        FlatMerkleTree rebuilt(mode);
+        rebuilt.buildTreeFromReviews(mirrorData, mirrorIds);
+        EXPECT_EQ(tree.getRootHash(), rebuilt.getRootHash());
+        EXPECT_EQ(tree.getLeafCount(), mirrorIds.size());
+        EXPECT_FALSE(tree.contains("batch_3"));
+        EXPECT_TRUE(FlatMerkleTree::verifyProof(mirrorData.back(), tree.generateProof(mirrorIds.back()), tree.getRootHash(), mode));
+
+        //shrinking down to one leaf and then to nothing
+        vector<TreeUpdate> removeAll;
+        for (size_t i = 1; i < mirrorIds.size(); i++) removeAll.push_back({ TreeUpdate::REMOVE, mirrorIds[i], "" });
+        tree.applyBatch(removeAll);
+        FlatMerkleTree single(mode);
+        single.buildTreeFromReviews({ mirrorData[0] }, { mirrorIds[0] });
+        EXPECT_EQ(tree.getRootHash(), single.getRootHash());
+        tree.applyBatch({ { TreeUpdate::REMOVE, mirrorIds[0], "" } });
+        EXPECT_EQ(tree.getLeafCount(), 0);
+        EXPECT_EQ(tree.getRootHash(), "");
+    }
+}
+
+// Test 29: Existence proof index updates one review at a time
+TEST_F(MerkleTreeTest, ExistenceProofIncrementalIndex) {
+    vector<Review> reviews = testReviews;
+    ASSERT_GE(reviews.size(), 2);
+
+    ExistenceProof prover(&tree);
+    prover.indexReviews(reviews);
+    size_t indexed = prover.getTotalIndexedReviews();
+
+    Review added("NEWREVIEWER", reviews[0].asin, "fresh text", "fresh", 5.0, "1700000000");
+    tree.addReview(added.convertToString(), added.getUniqueID());
+    prover.indexReview(added);
+    EXPECT_EQ(prover.getTotalIndexedReviews(), indexed + 1);
+    EXPECT_EQ(prover.generateReviewProof(added.getUniqueID()).status, "PROOF_GENERATED");
+    EXPECT_TRUE(prover.generateReviewProof(added.getUniqueID()).verified);
+
+    prover.removeReview(added);
+    EXPECT_FALSE(prover.reviewExists(added.getUniqueID()));
+    vector<string> productIds = prover.getProductReviews(reviews[0].asin);
+    EXPECT_EQ(find(productIds.begin(), productIds.end(), added.getUniqueID()), productIds.end());
+}
+
+// Test 30: Mountain range appends keep old leaves provable
+TEST_F(MerkleTreeTest, MountainRangeAppendOnly) {
+    vector<string> data, ids;
+    for (int i = 0; i < 37; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+
+    //one at a time and in batches give the same roots
+    MerkleMountainRange single, batched;
+    for (size_t i = 0; i < data.size(); i++) {
+        ASSERT_TRUE(single.append(data[i], ids[i]));
+    }
+    MerkleMountainRange::Checkpoint first = batched.appendBatch(
+        vector<string>(data.begin(), data.begin() + 13), vector<string>(ids.begin(), ids.begin() + 13));
+    batched.appendBatch(vector<string>(data.begin() + 13, data.end()), vector<string>(ids.begin() + 13, ids.end()));
+    EXPECT_EQ(single.getRootHash(), batched.getRootHash());
+    EXPECT_EQ(batched.getCheckpoints().size(), 2);
+    EXPECT_FALSE(single.append(data[0], ids[0]));
+
+    //rfc 6962 root of two leaves
+    SHA256 hasher;
+    Digest left = MerkleMountainRange::hashLeaf(data[0]);
+    Digest right = MerkleMountainRange::hashLeaf(data[1]);
+    uint8_t node[65] = { 0x01 };
+    memcpy(node + 1, left.data(), 32);
+    memcpy(node + 33, right.data(), 32);
+    Digest expected;
+    hashToDigest(hasher, node, sizeof(node), expected);
+    EXPECT_EQ(single.getRootDigest(2), expected);
+
+    //every leaf proves against every tree size that contains it
+    for (size_t treeSize = 1; treeSize <= data.size(); treeSize++) {
+        Digest root = single.getRootDigest(treeSize);
+        for (size_t leaf = 0; leaf < treeSize; leaf++) {
+            vector<Digest> proof = single.generateProof(leaf, treeSize);
+            EXPECT_TRUE(MerkleMountainRange::verifyProof(data[leaf], leaf, treeSize, proof, root));
+        }
+    }
+
+    //a leaf from the first batch still proves against the first published root
+    vector<Digest> oldProof = batched.generateProof(5, first.treeSize);
+    EXPECT_TRUE(MerkleMountainRange::verifyProof(data[5], 5, first.treeSize, oldProof, first.root));
+    EXPECT_FALSE(MerkleMountainRange::verifyProof(data[6], 5, first.treeSize, oldProof, first.root));
+    EXPECT_EQ(first.root, batched.getRootDigest(13));
+}
+
+// Test 31: Consistency proofs show an older log is a prefix of a newer one
+TEST_F(MerkleTreeTest, ConsistencyProofs) {
+    MerkleMountainRange log;
+    vector<string> data;
+    for (int i = 0; i < 33; i++) {
+        data.push_back("review " + to_string(i));
+        log.append(data.back(), "R" + to_string(i));
+    }
+
+    for (size_t newSize = 1; newSize <= data.size(); newSize++) {
+        Digest newRoot = log.getRootDigest(newSize);
+        for (size_t oldSize = 1; oldSize <= newSize; oldSize++) {
+            vector<Digest> proof = log.generateConsistencyProof(oldSize, newSize);
+            Digest oldRoot = log.getRootDigest(oldSize);
+            EXPECT_TRUE(MerkleMountainRange::verifyConsistency(oldSize, newSize, oldRoot, newRoot, proof));
+            EXPECT_LE(proof.size(), 2 * 6);
+
+            if (!proof.empty()) {
+                vector<Digest> tampered = proof;
+                tampered[0][0] ^= 1;
+                EXPECT_FALSE(MerkleMountainRange::verifyConsistency(oldSize, newSize, oldRoot, newRoot, tampered));
+            }
+        }
+    }
+
+    //a rewritten history is rejected
+    MerkleMountainRange rewritten;
+    for (int i = 0; i < 33; i++) {
+        rewritten.append(i == 3 ? string("edited review") : data[i], "R" + to_string(i));
+    }
+    vector<Digest> proof = rewritten.generateConsistencyProof(10, 33);
+    EXPECT_FALSE(MerkleMountainRange::verifyConsistency(10, 33, log.getRootDigest(10), rewritten.getRootDigest(), proof));
+
+    IntegrityVerifier verifier;
+    verifier.storeRootHash("log", digestToHex(log.getRootDigest(20)));
+    string status = verifier.detectAppendOnlyUpdate("log", 20, 33, log.getRootHash(), log.generateConsistencyProof(20));
+    EXPECT_EQ(status.find("APPEND_ONLY_VERIFIED"), 0);
+    status = verifier.detectAppendOnlyUpdate("log", 20, 33, rewritten.getRootHash(), rewritten.generateConsistencyProof(20));
+    EXPECT_EQ(status.find("NOT_APPEND_ONLY"), 0);
+
+    //the size published with a log root is kept next to it
+    EXPECT_EQ(verifier.detectAppendOnlyUpdate("log", 33, log.getRootHash(), log.generateConsistencyProof(20)).find("UNKNOWN"), 0);
+    verifier.storeLogRoot("log", digestToHex(log.getRootDigest(20)), 20);
+    EXPECT_EQ(verifier.getStoredSize("log"), 20u);
+    status = verifier.detectAppendOnlyUpdate("log", 33, log.getRootHash(), log.generateConsistencyProof(20));
+    EXPECT_EQ(status.find("APPEND_ONLY_VERIFIED"), 0);
+    status = verifier.detectAppendOnlyUpdate("log", 33, rewritten.getRootHash(), rewritten.generateConsistencyProof(20));
+    EXPECT_EQ(status.find("NOT_APPEND_ONLY"), 0);
+}
+
+// Test 32: Tree diff localizes modified, inserted and deleted reviews
+TEST_F(MerkleTreeTest, TreeDiffLocalizesChanges) {
+    vector<string> data, ids;
+    for (int i = 0; i < 1000; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+
+    FlatMerkleTree before, after;
+    before.buildTreeFromReviews(data, ids);
+    after.buildTreeFromReviews(data, ids);
+    EXPECT_TRUE(TreeDiff::diff(before, after).identical());
+
+    vector<TreeUpdate> updates = {
+        { TreeUpdate::UPDATE, "R17", "changed 17" },
+        { TreeUpdate::UPDATE, "R500", "changed 500" },
+        { TreeUpdate::REMOVE, "R250", "" },
+        { TreeUpdate::INSERT, "NEW1", "new review" },
+    };
+    after.applyBatch(updates);
+
+    TreeDiffResult diff = TreeDiff::diff(before, after);
+    EXPECT_EQ(diff.modified, 2);
+    EXPECT_EQ(diff.deleted, 1);
+    EXPECT_EQ(diff.inserted, 1);
+    EXPECT_LT(diff.nodesCompared, 200);
+    for (const LeafChange& change : diff.changes) {
+        if (change.type == LeafChange::DELETED) {
+            EXPECT_EQ(change.reviewId, "R250");
+        }
+        if (change.type == LeafChange::INSERTED) {
+            EXPECT_EQ(change.reviewId, "NEW1");
+        }
+        if (change.type == LeafChange::MODIFIED) {
+            EXPECT_TRUE(change.reviewId == "R17" || change.reviewId == "R500");
+        }
+    }
+
+    //pointer trees, with a deletion that shifts every later leaf
+    MerkleTree original, tampered;
+    original.buildTreeFromReviews(data, ids);
+    vector<string> tamperedData = data, tamperedIds = ids;
+    tamperedData[3] = "changed 3";
+    tamperedData.erase(tamperedData.begin() + 600);
+    tamperedIds.erase(tamperedIds.begin() + 600);
+    tampered.buildTreeFromReviews(tamperedData, tamperedIds);
+
+    diff = TreeDiff::diff(original, tampered);
+    ASSERT_EQ(diff.changes.size(), 2);
+    EXPECT_EQ(diff.changes[0].type, LeafChange::MODIFIED);
+    EXPECT_EQ(diff.changes[0].reviewId, "R3");
+    EXPECT_EQ(diff.changes[1].type, LeafChange::DELETED);
+    EXPECT_EQ(diff.changes[1].reviewId, "R600");
+
+    //the tamper detector reports the same through the diff
+    TamperDetector detector(&tree, testReviews);
+    vector<Review> modified = testReviews;
+    modified[1].reviewText = "MODIFIED TEXT";
+    vector<string> modifiedData, modifiedIds;
+    for (const auto& review : modified) {
+        modifiedData.push_back(review.convertToString());
+        modifiedIds.push_back(review.getUniqueID());
+    }
+    MerkleTree modifiedTree;
+    modifiedTree.buildTreeFromReviews(modifiedData, modifiedIds);
+    vector<ReviewTamperResult> results = detector.localizeTampering(modifiedTree);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].reviewId, testReviews[1].getUniqueID());
+    EXPECT_EQ(results[0].status, "MODIFIED_REVIEW_DETECTED");
+}
+
+// Test 33: Multiproofs prove many reviews with shared siblings once
+TEST_F(MerkleTreeTest, MultiproofSharedSiblings) {
+    vector<string> data, ids;
+    for (int i = 0; i < 1001; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    MerkleTree pointerTree;
+    pointerTree.buildTreeFromReviews(data, ids);
+    FlatMerkleTree flatTree;
+    flatTree.buildTreeFromReviews(data, ids);
+
+    //a contiguous block, scattered leaves, the odd last leaf and a repeat
+    vector<size_t> picks;
+    for (size_t i = 200; i < 264; i++) picks.push_back(i);
+    picks.push_back(7);
+    picks.push_back(999);
+    picks.push_back(1000);
+    picks.push_back(7);
+
+    vector<string> provenIds, provenData;
+    for (size_t p : picks) {
+        provenIds.push_back(ids[p]);
+        provenData.push_back(data[p]);
+    }
+
+    MultiProof pointerProof, flatProof;
+    ASSERT_TRUE(MultiProofs::generate(pointerTree, provenIds, pointerProof));
+    ASSERT_TRUE(MultiProofs::generate(flatTree, provenIds, flatProof));
+    EXPECT_EQ(pointerProof.siblings, flatProof.siblings);
+    EXPECT_TRUE(MultiProofs::verify(provenData, pointerProof, pointerTree.getRootHash()));
+    EXPECT_LT(pointerProof.siblings.size() * 5, MultiProofs::individualProofDigests(pointerProof));
+
+    //wrong data, a dropped sibling or an extra one all fail
+    vector<string> wrongData = provenData;
+    wrongData[10] = "forged";
+    EXPECT_FALSE(MultiProofs::verify(wrongData, pointerProof, pointerTree.getRootHash()));
+    MultiProof shortProof = pointerProof;
+    shortProof.siblings.pop_back();
+    EXPECT_FALSE(MultiProofs::verify(provenData, shortProof, pointerTree.getRootHash()));
+    MultiProof longProof = pointerProof;
+    longProof.siblings.push_back(longProof.siblings[0]);
+    EXPECT_FALSE(MultiProofs::verify(provenData, longProof, pointerTree.getRootHash()));
+
+    //raw digest trees verify in their own mode
+    FlatMerkleTree rawTree(HashMode::RAW_DIGEST);
+    rawTree.buildTreeFromReviews(data, ids);
+    MultiProof rawProof;
+    ASSERT_TRUE(MultiProofs::generate(rawTree, provenIds, rawProof));
+    EXPECT_TRUE(MultiProofs::verify(provenData, rawProof, rawTree.getRootDigest(), HashMode::RAW_DIGEST));
+
+    //product level multiproof through the existence prover
+    ExistenceProof prover(&tree);
+    prover.indexReviews(testReviews);
+    MultiProofResult result = prover.generateProductMultiproof("P1");
+    EXPECT_EQ(result.status, "PROOF_GENERATED");
+    EXPECT_EQ(result.reviewIds.size(), 2);
+    EXPECT_TRUE(result.verified);
+}
+
+// Test 34: Product ordered tree proves all reviews of a product at once
+TEST_F(MerkleTreeTest, ProductRangeProofs) {
+    vector<Review> reviews;
+    for (int i = 0; i < 300; i++) {
+        string asin = "P" + to_string(i % 17);
+        reviews.push_back(Review("U" + to_string(i), asin, "text " + to_string(i), "s", 1.0 + i % 5, to_string(1000 + i)));
+    }
+
+    ProductOrderedTree productTree;
+    productTree.buildFromReviews(reviews);
+    EXPECT_EQ(productTree.getProductCount(), 17);
+
+    for (int p = 0; p < 17; p++) {
+        ProductRangeProof proof;
+        ASSERT_TRUE(productTree.generateProductProof("P" + to_string(p), proof));
+        EXPECT_GE(proof.reviewCount(), 17);
+        EXPECT_TRUE(ProductOrderedTree::verifyProductProof(proof, productTree.getRootHash()));
+    }
+
+    //leaving a review out of the range is caught
+    ProductRangeProof proof;
+    ASSERT_TRUE(productTree.generateProductProof("P5", proof));
+    ProductRangeProof omitted = proof;
+    omitted.end--;
+    omitted.leafData.erase(omitted.leafData.end() - 2);
+    omitted.proof.leafPositions.pop_back();
+    omitted.hasRightNeighbour = true;
+    EXPECT_FALSE(ProductOrderedTree::verifyProductProof(omitted, productTree.getRootHash()));
+
+    //claiming the range for another product fails
+    ProductRangeProof renamed = proof;
+    renamed.asin = "P6";
+    EXPECT_FALSE(ProductOrderedTree::verifyProductProof(renamed, productTree.getRootHash()));
+
+    //an absent product gets an empty range bounded by its neighbours
+    ProductRangeProof absent;
+    ASSERT_TRUE(productTree.generateProductProof("P55", absent));
+    EXPECT_EQ(absent.reviewCount(), 0);
+    EXPECT_TRUE(ProductOrderedTree::verifyProductProof(absent, productTree.getRootHash()));
+
+    //swapping the left neighbour into the slot of its sibling, the product's
+    //first review, and shipping that review's leaf as a sibling hides it
+    int forgeries = 0;
+    for (int p = 0; p < 17; p++) {
+        ProductRangeProof honest;
+        ASSERT_TRUE(productTree.generateProductProof("P" + to_string(p), honest));
+        if (honest.begin % 2 == 0 || honest.reviewCount() < 2) continue;
+
+        ProductRangeProof forged = honest;
+        forged.begin++;
+        forged.leafData.erase(forged.leafData.begin() + 1);
+        forged.proof.leafPositions.erase(forged.proof.leafPositions.begin());
+        forged.proof.siblings.insert(forged.proof.siblings.begin(), productTree.getTree().getNode(0, honest.begin));
+        EXPECT_FALSE(ProductOrderedTree::verifyProductProof(forged, productTree.getRootHash()));
+        forgeries++;
+    }
+    EXPECT_GT(forgeries, 0);
+}
+
+// Test 35: Sorted tree proves a review id was never in the dataset
+TEST_F(MerkleTreeTest, NonMembershipProofs) {
+    vector<Review> reviews;
+    for (int i = 0; i < 200; i++) {
+        reviews.push_back(Review("U" + to_string(i * 3), "P" + to_string(i % 7), "text", "s", 4.0, "1000"));
+    }
+
+    SortedMerkleTree sorted;
+    sorted.buildFromReviews(reviews);
+    string root = sorted.getRootHash();
+
+    //present reviews have inclusion proofs and no absence proof
+    NonMembershipProof proof;
+    EXPECT_FALSE(sorted.generateNonMembershipProof(reviews[10].reviewID, proof));
+    size_t position;
+    ASSERT_TRUE(sorted.getTree().findLeaf(reviews[10].reviewID, position));
+    EXPECT_TRUE(MerkleTree::verifyProof(MultiProofs::positionedLeaf(position, reviews[10].convertToString()),
+        sorted.generateProof(reviews[10].reviewID), root));
+    EXPECT_FALSE(MerkleTree::verifyProof(MultiProofs::positionedLeaf(position ^ 1, reviews[10].convertToString()),
+        sorted.generateProof(reviews[10].reviewID), root));
+
+    //missing ids in the middle and past both ends
+    for (string missing : { string("U1_P1_1000"), string("A"), string("ZZZ") }) {
+        ASSERT_TRUE(sorted.generateNonMembershipProof(missing, proof));
+        EXPECT_TRUE(SortedMerkleTree::verifyNonMembershipProof(proof, root));
+    }
+
+    //a proof for one id does not prove another, present id
+    ASSERT_TRUE(sorted.generateNonMembershipProof("U1_P1_1000", proof));
+    NonMembershipProof reused = proof;
+    reused.reviewId = reviews[0].reviewID;
+    EXPECT_FALSE(SortedMerkleTree::verifyNonMembershipProof(reused, root));
+
+    //skipping a leaf between the neighbours is rejected
+    NonMembershipProof gap = proof;
+    gap.proof.leafPositions[1]++;
+    EXPECT_FALSE(SortedMerkleTree::verifyNonMembershipProof(gap, root));
+
+    //forged bracket: b at even leaf i, hidden c at i + 1, d at i + 2. claiming
+    //b at i + 1 with c's leaf as its sibling made b and d look adjacent
+    vector<Review> byId = reviews;
+    sort(byId.begin(), byId.end(), [](const Review& x, const Review& y) { return x.reviewID < y.reviewID; });
+    const Review& hidden = byId[11];
+    NonMembershipProof bracket;
+    bracket.reviewId = hidden.reviewID;
+    bracket.hasLower = bracket.hasUpper = true;
+    bracket.leafData = { byId[10].convertToString(), byId[12].convertToString() };
+    ASSERT_TRUE(MultiProofs::generate(sorted.getTree(), { hidden.getUniqueID(), byId[12].getUniqueID() }, bracket.proof));
+    EXPECT_EQ(bracket.proof.leafPositions[0], 11u);
+    bracket.proof.siblings[0] = sorted.getTree().getNode(0, 11);
+    EXPECT_FALSE(SortedMerkleTree::verifyNonMembershipProof(bracket, root));
+
+    //the existence prover attaches the evidence to REVIEW_NOT_FOUND
+    SortedMerkleTree fixtureSorted;
+    fixtureSorted.buildFromReviews(testReviews);
+    ExistenceProof prover(&tree);
+    prover.indexReviews(testReviews);
+    prover.attachSortedTree(&fixtureSorted);
+    ProofResult result = prover.generateReviewProof("NON_EXISTENT_REVIEW_12345");
+    EXPECT_EQ(result.status, "REVIEW_NOT_FOUND");
+    EXPECT_TRUE(result.absenceProven);
+}
+
+// Test 36: Binary proof encoding round trips and verifies in place
+TEST_F(MerkleTreeTest, BinaryProofCodec) {
+    vector<string> data, ids;
+    for (int i = 0; i < 777; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    MerkleTree pointerTree;
+    pointerTree.buildTreeFromReviews(data, ids);
+    FlatMerkleTree flatTree;
+    flatTree.buildTreeFromReviews(data, ids);
+    Digest root = flatTree.getRootDigest();
+
+    for (size_t i : { size_t(0), size_t(1), size_t(500), size_t(776) }) {
+        vector<string> proof = pointerTree.generateProof(ids[i]);
+        vector<uint8_t> fromStrings, fromTree;
+        ASSERT_TRUE(ProofCodec::encode(proof, HashMode::HEX_COMPAT, fromStrings));
+        ASSERT_TRUE(ProofCodec::encode(flatTree, ids[i], fromTree));
+        EXPECT_EQ(fromStrings, fromTree);
+        EXPECT_EQ(fromTree.size(), ProofCodec::encodedSize(proof.size() / 2));
+
+        ProofCodec::ProofView view;
+        ASSERT_TRUE(ProofCodec::parse(fromTree, view));
+        EXPECT_EQ(view.leafIndex, i);
+        EXPECT_TRUE(ProofCodec::verify(view, data[i], root));
+        EXPECT_FALSE(ProofCodec::verify(view, data[i] + "x", root));
+
+        vector<string> decoded;
+        ProofCodec::decode(view, decoded);
+        EXPECT_EQ(decoded, proof);
+    }
+
+    //fixed little endian layout
+    vector<uint8_t> encoded;
+    ASSERT_TRUE(ProofCodec::encode(flatTree, ids[5], encoded));
+    EXPECT_EQ(encoded[0], 'M');
+    EXPECT_EQ(encoded[1], 'P');
+    EXPECT_EQ(encoded[2], ProofCodec::VERSION);
+    EXPECT_EQ(encoded[4], flatTree.getHeight() - 1);
+    EXPECT_EQ(encoded[8], 5);
+
+    //truncated, wrong version and inconsistent directions are rejected
+    ProofCodec::ProofView view;
+    EXPECT_FALSE(ProofCodec::parse(encoded.data(), encoded.size() - 1, view));
+    vector<uint8_t> corrupt = encoded;
+    corrupt[2] = 99;
+    EXPECT_FALSE(ProofCodec::parse(corrupt, view));
+    corrupt = encoded;
+    corrupt[16] ^= 1;
+    EXPECT_FALSE(ProofCodec::parse(corrupt, view));
+}
+
+// Test 37: Batch verifier checks mixed proofs against several roots
+TEST_F(MerkleTreeTest, BatchVerifierMixedProofs) {
+    vector<string> data, ids;
+    for (int i = 0; i < 3000; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    FlatMerkleTree bigTree;
+    bigTree.buildTreeFromReviews(data, ids);
+    MerkleTree smallTree;
+    smallTree.buildTreeFromReviews(vector<string>(data.begin(), data.begin() + 5), vector<string>(ids.begin(), ids.begin() + 5));
+
+    BatchVerifier verifier(HashMode::HEX_COMPAT, 4);
+    size_t bigRoot = verifier.addRoot(bigTree.getRootHash());
+    size_t smallRoot = verifier.addRoot(smallTree.getRootHash());
+    EXPECT_EQ(verifier.addRoot(bigTree.getRootDigest()), bigRoot);
+
+    vector<uint8_t> expected;
+    for (size_t i = 0; i < data.size(); i++) {
+        bool corrupt = (i % 97 == 0);
+        string leaf = corrupt ? data[i] + "!" : data[i];
+        if (i % 3 == 0) {
+            verifier.add(leaf, bigTree.generateProof(ids[i]), bigRoot);
+        }
+        else if (i % 3 == 1) {
+            verifier.add(leaf, bigTree.generateDigestProof(ids[i]), bigRoot);
+        }
+        else {
+            vector<uint8_t> encoded;
+            ProofCodec::encode(bigTree, ids[i], encoded);
+            ProofCodec::ProofView view;
+            ASSERT_TRUE(ProofCodec::parse(encoded, view));
+            verifier.add(leaf, view, bigRoot);
+        }
+        expected.push_back(corrupt ? 0 : 1);
+    }
+
+    //proofs of the small tree against its own and the wrong root
+    verifier.add(data[2], smallTree.generateProof(ids[2]), smallRoot);
+    expected.push_back(1);
+    verifier.add(data[2], smallTree.generateProof(ids[2]), bigRoot);
+    expected.push_back(0);
+
+    //malformed proof and unknown root fail without affecting the rest
+    verifier.add(data[0], vector<string>{ "nothex", "r" }, bigRoot);
+    expected.push_back(0);
+    verifier.add(data[0], bigTree.generateProof(ids[0]), 42);
+    expected.push_back(0);
+
+    vector<uint8_t> results = verifier.verifyAll();
+    EXPECT_EQ(results, expected);
+
+    //same answers as one proof at a time
+    for (size_t i = 0; i < 300; i += 3) {
+        string leaf = (i % 97 == 0) ? data[i] + "!" : data[i];
+        EXPECT_EQ(results[i] == 1, FlatMerkleTree::verifyProof(leaf, bigTree.generateProof(ids[i]), bigTree.getRootHash()));
+    }
+}
+
+// Test 38: Proof cache matches the tree and drops only entries under changed leaves
+TEST_F(MerkleTreeTest, ProofCacheInvalidation) {
+    vector<string> data, ids;
+    for (int i = 0; i < 5000; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    FlatMerkleTree tree;
+    tree.buildTreeFromReviews(data, ids);
+    ProofCache cache(tree, 1 << 20, 4);
+
+    //hot ids spread over the tree, cached on their second miss and hit afterwards
+    vector<ProofStep> proof;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 5000; i += 100) {
+            ASSERT_TRUE(cache.getDigestProof(ids[i], proof));
+            EXPECT_TRUE(FlatMerkleTree::verifyDigestProof(data[i], proof, tree.getRootDigest()));
+        }
+    }
+    EXPECT_GE(cache.getStats().hits, 50u);
+    EXPECT_EQ(cache.getStats().hits + cache.getStats().misses, 150u);
+    EXPECT_EQ(cache.getProof(ids[7]), tree.generateProof(ids[7]));
+    EXPECT_FALSE(cache.getDigestProof("missing", proof));
+
+    //changing leaf 0 invalidates its subtree only, every proof still matches
+    size_t hitsBefore = cache.getStats().hits;
+    tree.applyBatch({ { TreeUpdate::UPDATE, ids[0], "changed" } });
+    for (int i = 0; i < 5000; i += 100) {
+        ASSERT_TRUE(cache.getDigestProof(ids[i], proof));
+        string leafData = (i == 0) ? "changed" : data[i];
+        EXPECT_TRUE(FlatMerkleTree::verifyDigestProof(leafData, proof, tree.getRootDigest()));
+    }
+    ProofCache::Stats stats = cache.getStats();
+    EXPECT_GT(stats.invalidations, 0u);
+    EXPECT_LT(stats.invalidations, 50u);
+    EXPECT_GT(stats.hits - hitsBefore, 0u);
+
+    //appends and removals move leaves, cached proofs follow them
+    tree.addReview("new review", "NEW");
+    tree.applyBatch({ { TreeUpdate::REMOVE, ids[1000], "" } });
+    for (int i = 0; i < 5000; i += 100) {
+        if (i == 1000) {
+            EXPECT_FALSE(cache.getDigestProof(ids[i], proof));
+            continue;
+        }
+        ASSERT_TRUE(cache.getDigestProof(ids[i], proof));
+        string leafData = (i == 0) ? "changed" : data[i];
+        EXPECT_TRUE(FlatMerkleTree::verifyDigestProof(leafData, proof, tree.getRootDigest()));
+    }
+    ASSERT_TRUE(cache.getDigestProof("NEW", proof));
+    EXPECT_TRUE(FlatMerkleTree::verifyDigestProof("new review", proof, tree.getRootDigest()));
+
+    //a rebuild starts the cache over
+    tree.buildTreeFromReviews(data, ids);
+    EXPECT_EQ(cache.getProof(ids[3]), tree.generateProof(ids[3]));
+    EXPECT_EQ(cache.getStats().entries, 0u);
+}
+
+// Test 39: Readers serve consistent proofs from pinned versions while a writer updates
+TEST_F(MerkleTreeTest, ConcurrentTreeSnapshotReads) {
+    vector<string> data, ids;
+    for (int i = 0; i < 3000; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    ConcurrentMerkleTree tree;
+    tree.buildTreeFromReviews(data, ids);
+    FlatMerkleTree reference;
+    reference.buildTreeFromReviews(data, ids);
+    ASSERT_EQ(tree.getCurrentVersion()->getRootHash(), reference.getRootHash());
+
+    //a pinned version keeps its root and proofs across an update
+    {
+        ConcurrentMerkleTree::Reader reader(tree);
+        auto pinned = reader.pin();
+        string oldRoot = pinned->getRootHash();
+        tree.applyBatch({ { TreeUpdate::UPDATE, ids[5], "changed" } });
+        EXPECT_EQ(pinned->getRootHash(), oldRoot);
+        EXPECT_TRUE(FlatMerkleTree::verifyProof(data[5], pinned->generateProof(ids[5]), oldRoot));
+        EXPECT_NE(tree.getCurrentVersion()->getRootHash(), oldRoot);
+        EXPECT_GT(tree.getRetiredCount(), 0u);
+    }
+    EXPECT_EQ(tree.reclaim(), 0u);
+    reference.applyBatch({ { TreeUpdate::UPDATE, ids[5], "changed" } });
+
+    //every proof a reader gets must verify against the root of the same pin
+    atomic<bool> done(false);
+    atomic<int> failures(0), served(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            ConcurrentMerkleTree::Reader reader(tree);
+            vector<ProofStep> proof;
+            for (int i = t; !done || i < t + 200; i += 7) {
+                auto pinned = reader.pin();
+                size_t leaf = i % pinned->getLeafCount();
+                pinned->generateLeafProof(leaf, proof);
+                if (proof.size() + 1 != pinned->getHeight()) failures++;
+                Digest current = pinned->getNode(0, leaf);
+                SHA256 hasher;
+                for (const ProofStep& step : proof) combineDigests(hasher, current, step.sibling, pinned->getHashMode(), current);
+                if (current != pinned->getRootDigest()) failures++;
+                served++;
+            }
+            });
+    }
+
+    //inserts, updates and removals reshape the tree while readers run
+    for (int round = 0; round < 40; round++) {
+        vector<TreeUpdate> batch = {
+            { TreeUpdate::INSERT, "N" + to_string(round), "new " + to_string(round) },
+            { TreeUpdate::UPDATE, ids[round * 50], "update " + to_string(round) },
+            { TreeUpdate::REMOVE, ids[round * 50 + 1], "" },
+            { TreeUpdate::INSERT, ids[2], "rejected" } };
+        tree.applyBatch(batch);
+        reference.applyBatch(batch);
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_GT(served.load(), 0);
+    auto latest = tree.getCurrentVersion();
+    EXPECT_EQ(latest->getRootHash(), reference.getRootHash());
+    EXPECT_EQ(latest->getLeafCount(), reference.getLeafCount());
+    EXPECT_EQ(latest->generateProof(ids[100]), reference.generateProof(ids[100]));
+    EXPECT_FALSE(latest->contains(ids[1]));
+    EXPECT_THROW(tree.addReview("dup", ids[3]), invalid_argument);
+    EXPECT_EQ(tree.reclaim(), 0u);
+}
+
+// Test 40: Proofs against historical roots, structural sharing and garbage collection
+TEST_F(MerkleTreeTest, VersionedTreeHistoricalProofs) {
+    vector<string> data, ids;
+    for (int i = 0; i < 20000; i++) {
+        data.push_back("review " + to_string(i));
+        ids.push_back("R" + to_string(i));
+    }
+    VersionedMerkleTree tree;
+    tree.buildTreeFromReviews(data, ids, 1000);
+    string firstRoot = tree.getLatestVersion()->getRootHash();
+
+    //one small batch per "day"
+    for (int day = 1; day <= 10; day++) {
+        tree.applyBatch({ { TreeUpdate::UPDATE, ids[day], "edited on day " + to_string(day) },
+            { TreeUpdate::INSERT, "D" + to_string(day), "added on day " + to_string(day) } }, 1000 + day * 100);
+    }
+    ASSERT_EQ(tree.getVersionCount(), 11u);
+
+    //R3 as it was before day 3 and after, each against the root of its time
+    string root;
+    vector<string> proof = tree.generateProofAsOf(1250, ids[3], root);
+    EXPECT_TRUE(FlatMerkleTree::verifyProof(data[3], proof, root));
+    EXPECT_FALSE(FlatMerkleTree::verifyProof("edited on day 3", proof, root));
+    proof = tree.generateProofAsOf(1300, ids[3], root);
+    EXPECT_TRUE(FlatMerkleTree::verifyProof("edited on day 3", proof, root));
+    EXPECT_TRUE(tree.generateProofAsOf(1250, "D5", root).empty());
+    EXPECT_EQ(tree.getVersionAsOf(999), nullptr);
+    EXPECT_EQ(tree.getVersionAsOf(1099)->getRootHash(), firstRoot);
+
+    //the same data built from scratch gives the same historical root
+    FlatMerkleTree rebuilt;
+    vector<string> dayFourData = data, dayFourIds = ids;
+    for (int day = 1; day <= 4; day++) {
+        dayFourData[day] = "edited on day " + to_string(day);
+    }
+    for (int day = 1; day <= 4; day++) {
+        dayFourData.push_back("added on day " + to_string(day));
+        dayFourIds.push_back("D" + to_string(day));
+    }
+    rebuilt.buildTreeFromReviews(dayFourData, dayFourIds);
+    EXPECT_EQ(tree.getVersionAsOf(1450)->getRootHash(), rebuilt.getRootHash());
+    auto dayFour = tree.getVersionAsOf(1450);
+    EXPECT_EQ(tree.generateProofAt(dayFour->getVersion(), "D2"), rebuilt.generateProof("D2"));
+
+    //eleven versions share blocks, far less than eleven full copies
+    unordered_set<const void*> counted;
+    size_t oneVersion = tree.getLatestVersion()->getMemoryUsage(counted);
+    EXPECT_LT(tree.getMemoryUsage(), 3 * oneVersion);
+
+    //the version current at the cutoff survives, older ones go
+    EXPECT_EQ(tree.collectGarbage(1550), 5u);
+    EXPECT_EQ(tree.getVersionAsOf(1400), nullptr);
+    EXPECT_TRUE(FlatMerkleTree::verifyProof(data[9], tree.generateProofAsOf(1550, ids[9], root), root));
+    EXPECT_EQ(tree.getRootHash(dayFour->getVersion()), "");
+
+    //a 200 second window keeps the day 10 version, current at 2300
+    tree.setRetentionWindow(200);
+    tree.addReview("late review", "LATE", 2500);
+    EXPECT_EQ(tree.getVersionCount(), 2u);
+    EXPECT_EQ(tree.listVersions().front().committedAt, 2000);
+    EXPECT_THROW(tree.addReview("again", "LATE", 2600), invalid_argument);
+
+    //integrity verifier keeps the root history too
+    IntegrityVerifier verifier;
+    verifier.storeRootHash("Electronics", firstRoot, 1000);
+    verifier.storeRootHash("Electronics", tree.getLatestVersion()->getRootHash(), 2500);
+    EXPECT_EQ(verifier.getRootAsOf("Electronics", 1700), firstRoot);
+    EXPECT_EQ(verifier.getRootAsOf("Electronics", 999), "");
+    EXPECT_EQ(verifier.getRootAsOf("Electronics", 3000), tree.getLatestVersion()->getRootHash());
+}
+
+// Test 41: Forest of category shards with two stage proofs and per shard rebuilds
+TEST_F(MerkleTreeTest, MerkleForestShardProofs) {
+    vector<string> names = { "Electronics", "Automotive", "Toys" };
+    vector<vector<string>> data(3), ids(3);
+    for (int shard = 0; shard < 3; shard++) {
+        for (int i = 0; i < 1000 + shard * 337; i++) {
+            data[shard].push_back(names[shard] + " review " + to_string(i));
+            ids[shard].push_back(names[shard].substr(0, 1) + to_string(i));
+        }
+    }
+    MerkleForest forest;
+    forest.setThreadCount(3);
+    forest.buildShards(names, data, ids);
+    ASSERT_EQ(forest.getShardCount(), 3u);
+    EXPECT_EQ(forest.getLeafCount(), 1000u + 1337u + 1674u);
+
+    //each shard matches a tree built on its own
+    FlatMerkleTree toys;
+    toys.buildTreeFromReviews(data[2], ids[2]);
+    EXPECT_EQ(forest.getShard("Toys")->getRootHash(), toys.getRootHash());
+
+    MerkleForest::ForestProof proof;
+    ASSERT_TRUE(forest.generateProof("A17", proof));
+    EXPECT_EQ(proof.shardName, "Automotive");
+    EXPECT_TRUE(MerkleForest::verifyProof(data[1][17], proof, forest.getRootDigest()));
+    EXPECT_FALSE(MerkleForest::verifyProof(data[1][18], proof, forest.getRootDigest()));
+    EXPECT_FALSE(forest.generateProof("Toys", "A17", proof));
+    EXPECT_FALSE(forest.generateProof("missing", proof));
+
+    //claiming the review belongs to another shard breaks the top stage
+    ASSERT_TRUE(forest.generateProof("Automotive", "A17", proof));
+    proof.shardName = "Electronics";
+    EXPECT_FALSE(MerkleForest::verifyProof(data[1][17], proof, forest.getRootDigest()));
+
+    //updating one shard leaves the other shard trees alone
+    string electronicsRoot = forest.getShard("Electronics")->getRootHash();
+    string oldForestRoot = forest.getRootHash();
+    forest.applyBatch("Toys", { { TreeUpdate::UPDATE, "T5", "edited toy review" } });
+    EXPECT_EQ(forest.getShard("Electronics")->getRootHash(), electronicsRoot);
+    EXPECT_NE(forest.getRootHash(), oldForestRoot);
+    ASSERT_TRUE(forest.generateProof("T5", proof));
+    EXPECT_TRUE(MerkleForest::verifyProof("edited toy review", proof, forest.getRootDigest()));
+    ASSERT_TRUE(forest.generateProof("E3", proof));
+    EXPECT_TRUE(MerkleForest::verifyProof(data[0][3], proof, forest.getRootDigest()));
+
+    //rebuilding a shard with its original data restores the old root
+    forest.buildShard("Toys", data[2], ids[2]);
+    EXPECT_EQ(forest.getRootHash(), oldForestRoot);
+
+    //a batch for an unknown shard is rejected instead of creating the shard,
+    //and a build naming a shard twice is refused before anything is built
+    BatchResult rejected = forest.applyBatch("Garden", { { TreeUpdate::INSERT, "G1", "garden review" } });
+    EXPECT_EQ(rejected.rejected, 1);
+    EXPECT_EQ(forest.getShard("Garden"), nullptr);
+    EXPECT_EQ(forest.getShardCount(), 3u);
+    EXPECT_THROW(forest.buildShards({ "Toys", "Garden", "Toys" }, { data[2], data[0], data[1] }, { ids[2], ids[0], ids[1] }),
+        invalid_argument);
+    EXPECT_EQ(forest.getShard("Garden"), nullptr);
+    EXPECT_EQ(forest.getRootHash(), oldForestRoot);
+
+    //hash of ASIN partitioning keeps every review and each product in one shard
+    vector<string> allData, allIds, asins;
+    for (int i = 0; i < 2000; i++) {
+        allData.push_back("review " + to_string(i));
+        allIds.push_back("R" + to_string(i));
+        asins.push_back("B" + to_string(i % 150));
+    }
+    MerkleForest byAsin;
+    byAsin.buildByAsin(allData, allIds, asins, 4);
+    EXPECT_EQ(byAsin.getLeafCount(), 2000u);
+    size_t shard = MerkleForest::shardForAsin("B7", 4);
+    EXPECT_TRUE(byAsin.getShard("asin-" + to_string(shard))->contains("R157"));
+    ASSERT_TRUE(byAsin.generateProof("R157", proof));
+    EXPECT_TRUE(MerkleForest::verifyProof(allData[157], proof, byAsin.getRootDigest()));
+}
+
+// Test 42: Out-of-core build writes a snapshot matching the in-memory build
+TEST_F(MerkleTreeTest, ExternalBuildMatchesStreamingBuild) {
+    vector<string> parts = { "data/test_external_a.json", "data/test_external_b.json" };
+    string combined = "data/test_external_all.json";
+    string snapshot = "data/test_external.snapshot";
+    {
+        ofstream all(combined);
+        for (int part = 0; part < 2; part++) {
+            ofstream file(parts[part]);
+            for (int i = part * 150; i < (part + 1) * 150; i++) {
+                int id = (i % 11 == 7) ? i / 3 : i; //duplicates within and across files
+                string line = "{\"reviewerID\": \"X" + to_string(id) + "\", \"asin\": \"P" + to_string(id % 5) +
+                    "\", \"reviewText\": \"external " + to_string(i) + "\", \"summary\": \"s\", \"overall\": 3.0, \"unixReviewTime\": " +
+                    to_string(3000 + id) + "}\n";
+                file << line;
+                all << line;
+                if (i == 40) file << "{\"reviewerID\": \"bad\"\n";
+            }
+        }
+    }
+
+    for (int maxRecords : { 0, 101 }) {
+        StreamingTreeBuilder streaming(16, 1);
+        FlatMerkleTree expected;
+        ASSERT_TRUE(streaming.build(combined, maxRecords, expected));
+
+        for (unsigned threads : { 1u, 3u }) {
+            //a tiny budget forces many sorted runs and many chunks per level
+            ExternalTreeBuilder builder(8, threads);
+            builder.setMemoryBudget(1024);
+            ASSERT_TRUE(builder.build(parts, snapshot, maxRecords));
+            EXPECT_EQ(builder.getLeafCount(), expected.getLeafCount());
+            EXPECT_GT(streaming.getDuplicatesRemoved(), 0);
+            EXPECT_EQ(builder.getDuplicatesRemoved(), static_cast<uint64_t>(streaming.getDuplicatesRemoved()));
+            EXPECT_FALSE(fs::exists(snapshot + ".leaves.spill"));
+
+            FlatMerkleTree loaded;
+            ASSERT_TRUE(loaded.loadSnapshot(snapshot));
+            EXPECT_EQ(loaded.getRootHash(), expected.getRootHash());
+            for (size_t leaf = 0; leaf < expected.getLeafCount(); leaf += 7) {
+                string id(expected.getLeafId(leaf));
+                EXPECT_EQ(loaded.generateProof(id), expected.generateProof(id));
+            }
+        }
+    }
+
+    //raw digest mode goes through the same passes
+    ExternalTreeBuilder raw(32, 2, HashMode::RAW_DIGEST);
+    ASSERT_TRUE(raw.build(combined, snapshot));
+    DataPreprocessor loader;
+    ASSERT_TRUE(loader.loadFromJSON(combined, 0));
+    vector<string> data, ids;
+    for (const auto& review : loader.getReviews()) {
+        data.push_back(review.convertToString());
+        ids.push_back(review.getUniqueID());
+    }
+    FlatMerkleTree rawTree(HashMode::RAW_DIGEST);
+    rawTree.buildTreeFromReviews(data, ids);
+    FlatMerkleTree rawLoaded;
+    ASSERT_TRUE(rawLoaded.loadSnapshot(snapshot));
+    EXPECT_EQ(rawLoaded.getHashMode(), HashMode::RAW_DIGEST);
+    EXPECT_EQ(rawLoaded.getRootHash(), rawTree.getRootHash());
+    EXPECT_TRUE(FlatMerkleTree::verifyProof(data[33], rawLoaded.generateProof(ids[33]), rawLoaded.getRootHash(), HashMode::RAW_DIGEST));
+
+    EXPECT_FALSE(raw.build("data/missing_external.json", snapshot));
+    for (const string& part : parts) fs::remove(part);
+    fs::remove(combined);
+    fs::remove(snapshot);
+}
+
+// Test 43: k-ary trees prove every leaf and the binary one matches FlatMerkleTree
+TEST_F(MerkleTreeTest, KaryTreeArities) {
+    for (HashMode mode : { HashMode::HEX_COMPAT, HashMode::RAW_DIGEST }) {
+        for (size_t count : { 2u, 5u, 17u, 1000u }) {
+            vector<string> data, ids;
+            for (size_t i = 0; i < count; i++) {
+                data.push_back("kary review " + to_string(i));
+                ids.push_back("K" + to_string(i));
+            }
+
+            FlatMerkleTree flat(mode);
+            flat.buildTreeFromReviews(data, ids);
+            KaryMerkleTree<2> binary(mode);
+            binary.buildTreeFromReviews(data, ids);
+            EXPECT_EQ(binary.getRootHash(), flat.getRootHash());
+            EXPECT_EQ(binary.getHeight(), flat.getHeight());
+
+            auto check = [&](auto& tree, size_t arity) {
+                typedef typename remove_reference<decltype(tree)>::type Tree;
+                tree.setThreadCount(3);
+                tree.buildTreeFromReviews(data, ids);
+                EXPECT_EQ(tree.getLeafCount(), count);
+
+                //height is ceil(log_arity(count)) + 1
+                size_t height = 1;
+                for (size_t size = count; size > 1; size = (size + arity - 1) / arity) height++;
+                EXPECT_EQ(tree.getHeight(), height);
+
+                vector<Digest> proof;
+                for (size_t i = 0; i < count; i++) {
+                    ASSERT_TRUE(tree.generateProof(ids[i], proof));
+                    EXPECT_EQ(proof.size() * sizeof(Digest), tree.getProofBytes());
+                    EXPECT_TRUE(Tree::verifyProof(data[i], proof, tree.getRootDigest(), mode));
+                }
+                ASSERT_TRUE(tree.generateProof(ids[count - 1], proof));
+                EXPECT_FALSE(Tree::verifyProof(data[0], proof, tree.getRootDigest(), mode));
+                proof.pop_back();
+                EXPECT_FALSE(Tree::verifyProof(data[count - 1], proof, tree.getRootDigest(), mode));
+                EXPECT_FALSE(tree.generateProof("missing", proof));
+
+                //an updated leaf only rehashes its path and matches a rebuild
+                vector<string> edited = data;
+                edited[count / 2] = "edited kary review";
+                ASSERT_TRUE(tree.updateReview(ids[count / 2], edited[count / 2]));
+                Tree rebuilt(mode);
+                rebuilt.buildTreeFromReviews(edited, ids);
+                EXPECT_EQ(tree.getRootHash(), rebuilt.getRootHash());
+                ASSERT_TRUE(tree.generateProof(ids[count / 2], proof));
+                EXPECT_TRUE(Tree::verifyProof(edited[count / 2], proof, tree.getRootDigest(), mode));
+                EXPECT_FALSE(tree.updateReview("missing", "x"));
+            };
+
+            KaryMerkleTree<2> tree2(mode);
+            KaryMerkleTree<4> tree4(mode);
+            KaryMerkleTree<8> tree8(mode);
+            KaryMerkleTree<16> tree16(mode);
+            check(tree2, 2);
+            check(tree4, 4);
+            check(tree8, 8);
+            check(tree16, 16);
+            if (count > 16) {
+                EXPECT_LT(tree16.getHeight(), tree4.getHeight());
+                EXPECT_NE(tree4.getRootHash(), tree2.getRootHash());
+            }
+        }
+    }
+}
+
+// Test 44: Fast loaders skip a byte order mark, reject overflowing numbers and accept deep nesting like nlohmann
+TEST_F(MerkleTreeTest, LoadersMatchJsonOnBomAndNumberOverflow) {
+    string filename = "data/test_bom.json";
+    {
+        ofstream file(filename, ios::binary);
+        file << "\xEF\xBB\xBF" << R"({"reviewerID": "B1", "asin": "P1", "reviewText": "after bom", "overall": 4.0, "unixReviewTime": 100})" << "\n";
+        file << R"({"reviewerID": "B2", "asin": "P2", "reviewText": "huge rating", "overall": 1e400, "unixReviewTime": 101})" << "\n";
+        file << R"({"reviewerID": "B3", "asin": "P3", "reviewText": "huge elsewhere", "overall": 2.0, "helpful": -1e999, "unixReviewTime": 102})" << "\n";
+        file << R"({"reviewerID": "B4", "asin": "P4", "reviewText": "tiny rating", "overall": 1e-400, "unixReviewTime": 103})" << "\n";
+        file << R"({"reviewerID": "B5", "asin": "P5", "reviewText": "long integer", "overall": 3, "unixReviewTime": 104, "votes": 123456789012345678901234567890})" << "\n";
+        file << "\xEF\xBB\xBF" << "\n";
+        file << " \xEF\xBB\xBF" << R"({"reviewerID": "B6", "asin": "P6", "reviewText": "bom not first", "unixReviewTime": 105})" << "\n";
+        file << R"({"reviewerID": "B7", "asin": "P7", "reviewText": "last", "overall": 5.0, "unixReviewTime": 106})" << "\n";
+        string deep = string(2000, '[') + R"({"a": [1, {"b": null}]})" + string(2000, ']');
+        file << R"({"reviewerID": "B8", "asin": "P8", "reviewText": "deep", "unixReviewTime": 107, "extra": )" << deep << "}\n";
+        file << R"({"reviewerID": "B9", "asin": "P9", "reviewText": "unclosed", "unixReviewTime": 108, "extra": )"
+            << deep.substr(0, deep.size() - 1) << "}\n";
+    }
+
+    DataPreprocessor jsonLoader;
+    ASSERT_TRUE(jsonLoader.loadFromJSON(filename, 0));
+    vector<string> expected, expectedIds;
+    for (const auto& review : jsonLoader.getReviews()) {
+        expected.push_back(review.convertToString());
+        expectedIds.push_back(review.getUniqueID());
+    }
+    EXPECT_EQ(expected.size(), 5); //B1, B4, B5, B7, B8
+
+    DataPreprocessor mappedLoader, parallelLoader;
+    ASSERT_TRUE(mappedLoader.loadFromJSONMapped(filename, 0));
+    ASSERT_TRUE(parallelLoader.loadFromJSONParallel(filename, 0, 2, 64));
+    for (const DataPreprocessor* loader : { &mappedLoader, &parallelLoader }) {
+        ASSERT_EQ(loader->getReviews().size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(loader->getReviews()[i].convertToString(), expected[i]);
+        }
+    }
+
+    FlatMerkleTree loadedTree;
+    loadedTree.buildTreeFromReviews(expected, expectedIds);
+    StreamingTreeBuilder builder(2, 1);
+    FlatMerkleTree streamed;
+    ASSERT_TRUE(builder.build(filename, 0, streamed));
+    EXPECT_EQ(streamed.getRootHash(), loadedTree.getRootHash());
+
+    fs::remove(filename);
+}
+
+// Test 45: Tree diff compares pointer trees grown with addReview by id
+TEST_F(MerkleTreeTest, TreeDiffAddReviewGrownTrees) {
+    for (int initial : { 4, 8 }) {
+        int added = initial == 4 ? 1 : 3;
+        vector<string> data, ids;
+        for (int i = 0; i < initial; i++) {
+            data.push_back("review " + to_string(i));
+            ids.push_back("R" + to_string(i));
+        }
+
+        MerkleTree built, grown;
+        built.buildTreeFromReviews(data, ids);
+        grown.buildTreeFromReviews(data, ids);
+        for (int i = 0; i < added; i++) {
+            grown.addReview("added " + to_string(i), "A" + to_string(i));
+        }
+
+        TreeDiffResult diff = TreeDiff::diff(built, grown);
+        EXPECT_EQ(diff.inserted, added);
+        EXPECT_EQ(diff.modified, 0);
+        EXPECT_EQ(diff.deleted, 0);
+        for (const LeafChange& change : diff.changes) {
+            EXPECT_EQ(change.reviewId[0], 'A');
+        }
+
+        //both directions, and against a grown tree with a modified review
+        diff = TreeDiff::diff(grown, built);
+        EXPECT_EQ(diff.deleted, added);
+
+        data[1] = "changed 1";
+        MerkleTree changed;
+        changed.buildTreeFromReviews(data, ids);
+        changed.addReview("added 0", "A0");
+        diff = TreeDiff::diff(grown, changed);
+        EXPECT_EQ(diff.modified, 1);
+        EXPECT_EQ(diff.deleted, added - 1);
+        EXPECT_EQ(diff.inserted, 0);
+        EXPECT_TRUE(TreeDiff::diff(grown, grown).identical());
+    }
+}